@@ -0,0 +1,157 @@
+#include "alloccheck.h"
+#include "world.h"
+#include "tile.h"
+#include "player.h"
+#include "simulation.h"
+#include <new>
+#include <cstdlib>
+
+std::atomic<Uint64> heapAllocations(0);
+
+#ifdef ALLOC_CHECK
+// Replacements for the global allocation functions, the array and nothrow forms call these by default
+void* operator new(size_t size)
+{
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	void* memory = std::malloc(size == 0 ? 1 : size);
+	if (memory == NULL) throw std::bad_alloc();
+	return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+#endif
+
+int runAllocCheck(const std::string& mapPath, int argc, char** args, int first)
+{
+#ifndef ALLOC_CHECK
+	std::cout << "Allocations are only counted in builds with ALLOC_CHECK defined, such as the Debug configurations" << std::endl;
+	return 1;
+#endif
+	int warmupFrames = 4000;
+	int frames = 4000;
+	Uint32 seed = 1;
+	Strategy strat = Strategy::balanced;
+	for (int i = first; i < argc; i++)
+	{
+		std::string arg = args[i];
+		if (i + 1 >= argc)
+		{
+			std::cout << "Missing value for " << arg << std::endl;
+			return 1;
+		}
+		std::string value = args[++i];
+		if (arg == "--warmup") warmupFrames = std::max(0, std::stoi(value));
+		else if (arg == "--frames") frames = std::max(1, std::stoi(value));
+		else if (arg == "--seed") seed = std::stoul(value);
+		else if (arg == "--strategy")
+		{
+			if (!parseStrategy(value, strat))
+			{
+				std::cout << "Unknown strategy " << value << std::endl;
+				return 1;
+			}
+		}
+		else
+		{
+			std::cout << "Unknown allocation check option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, 1, 1, 32, SDL_PIXELFORMAT_RGB888);
+	world w;
+	w.surface_ = surface;
+	w.verbose_ = false;
+	w.rng_.seed(seed);
+	std::vector<tile*> starts;
+	if (!loadWorldMap(w, mapPath) || !pickStartTiles(w, 2, starts))
+	{
+		std::cout << "No room for two players on " << mapPath << std::endl;
+		SDL_FreeSurface(surface);
+		return 1;
+	}
+	addPlayer(w, false, starts[0]->y_, starts[0]->x_)->strat_ = strat;
+	addPlayer(w, false, starts[1]->y_, starts[1]->x_)->strat_ = strat;
+
+	simTimers timers(0);
+	Uint64 now = 0;
+	int frame = 0;
+	for (; frame < warmupFrames && w.players_.size() > 1; frame++)
+	{
+		now += headlessFrameMs;
+		stepWorld(w, timers.poll(now));
+	}
+
+	// The checked frames are played twice from the same position. The first run grows every scratch buffer and pool
+	// to what these frames need, the second is the one counted.
+	world position;
+	cloneWorld(w, position);
+	position.rng_ = w.rng_;
+	world sim;
+	sim.verbose_ = false;
+	int startFrame = frame;
+	Uint64 warmChecksum = 0;
+	int steadyFrames = 0;
+	int allocatingFrames = 0;
+	Uint64 steadyAllocations = 0;
+	int populationFrames = 0;
+	Uint64 populationAllocations = 0;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		cloneWorld(position, sim);
+		sim.rng_ = position.rng_;
+		simTimers passTimers = timers;
+		Uint64 passNow = now;
+		frame = startFrame;
+		for (int checked = 0; checked < frames && sim.players_.size() > 1; checked++, frame++)
+		{
+			passNow += headlessFrameMs;
+			tickFlags flags = passTimers.poll(passNow);
+			size_t units = sim.units_.size();
+			size_t factories = sim.factories_.size();
+			size_t players = sim.players_.size();
+			int nextUnitId = sim.nextUnitId_;
+			Uint64 before = heapAllocations.load(std::memory_order_relaxed);
+			stepWorld(sim, flags);
+			Uint64 allocations = heapAllocations.load(std::memory_order_relaxed) - before;
+			if (pass == 0) continue;
+			if (sim.units_.size() != units || sim.factories_.size() != factories || sim.players_.size() != players || sim.nextUnitId_ != nextUnitId)
+			{
+				populationFrames++;
+				populationAllocations += allocations;
+				continue;
+			}
+			steadyFrames++;
+			steadyAllocations += allocations;
+			if (allocations == 0) continue;
+			if (allocatingFrames < 10) std::cout << "Frame " << frame << " allocated " << allocations << " times" << std::endl;
+			allocatingFrames++;
+		}
+		if (pass == 0) warmChecksum = worldChecksum(sim);
+	}
+
+	std::cout << steadyFrames << " steady frames, " << allocatingFrames << " of them allocated (" << steadyAllocations << " allocations)" << std::endl;
+	std::cout << populationFrames << " frames with units or factories created or destroyed, " << populationAllocations << " allocations" << std::endl;
+	if (sim.players_.size() < 2) std::cout << "Match ended at frame " << frame << std::endl;
+	bool repeated = worldChecksum(sim) == warmChecksum;
+	if (!repeated) std::cout << "The two runs of the checked frames ended differently" << std::endl;
+	clearWorld(sim);
+	clearWorld(position);
+	clearWorld(w);
+	SDL_FreeSurface(surface);
+	if (allocatingFrames > 0 || !repeated)
+	{
+		std::cout << "Allocation check failed" << std::endl;
+		return 1;
+	}
+	std::cout << "Allocation check passed" << std::endl;
+	return 0;
+}
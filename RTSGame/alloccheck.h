@@ -0,0 +1,14 @@
+#pragma once
+#include "main.h"
+#include <atomic>
+
+// Number of operator new calls made by the whole program so far, counted by the replacement operators in alloccheck.cpp.
+// Those are only compiled in with ALLOC_CHECK defined (the Debug configurations), so a shipping build's allocations
+// don't pay for an atomic increment each. Without it the count stays 0.
+extern std::atomic<Uint64> heapAllocations;
+
+// --alloc-check <map> [--warmup frames --frames n --seed s --strategy name], needs a build with ALLOC_CHECK defined
+// Plays two AI players headless and counts heap allocations in every frame after the warmup, on a second run of the
+// same frames so buffers have already grown to what they need. Frames where units or factories appear or disappear
+// are reported apart, every other frame has to allocate nothing or the check fails.
+int runAllocCheck(const std::string& mapPath, int argc, char** args, int first);
@@ -0,0 +1,44 @@
+#pragma once
+#include "main.h"
+
+/* Unit archetypes
+Everything that depends only on a unit's type, in one table indexed by unit::type_, instead of a switch in every
+place that needs to know. Players keep their units bucketed by type as well (player::ofType_), so a loop that is only
+about fighters or miners never looks at the rest.
+*/
+enum unitTypeId
+{
+	unitMain, // the commander a player starts with, builds the first factory
+	unitFighter,
+	unitBuilder,
+	unitMiner,
+	unitTypeCount
+};
+
+// Strokes drawn in green over a unit's team colored square
+enum unitGlyph
+{
+	glyphVerticalBar = 1,
+	glyphHorizontalBar = 2,
+	glyphSquare = 4
+};
+
+struct unitArchetype
+{
+	int health_; // at spawn
+	bool attacks_; // hits every adjacent enemy unit and factory each frame
+	bool mines_; // gathers resources while standing on a resource tile
+	bool builds_; // can turn the tile it stands on into a factory
+	bool founds_; // the factory it builds is always a builder factory, and it leaves a fighter, builder and miner around it
+	int glyph_; // unitGlyph bits
+	float threat_; // weight in the influence maps, fighters are what makes an area dangerous
+	float value_; // material a unit is worth to the MCTS evaluation
+};
+
+constexpr unitArchetype unitArchetypes[unitTypeCount] =
+{
+	{ 10, false, false, true, true, 0, 0.5f, 3.0f }, // unitMain
+	{ 50, true, false, false, false, glyphVerticalBar | glyphHorizontalBar, 1.0f, 2.0f }, // unitFighter
+	{ 10, false, false, true, false, glyphVerticalBar, 0.25f, 1.5f }, // unitBuilder
+	{ 100, false, true, false, false, glyphSquare, 0.25f, 1.5f }, // unitMiner
+};
@@ -2,80 +2,57 @@
 #include "tile.h"
 #include "drawmap.h"
 #include "unit.h"
+#include "landmarks.h"
+#include "trace.h"
+#include "metrics.h"
 #include <cassert>
+#include <atomic>
 
-std::vector<tile*> astar(SDL_Surface* winSurface, SDL_Window* window, std::vector<std::vector<tile*>>& tiles, std::list<unit*>& units, tile* start, tile* finish)
+// Every search gets a new number, tiles whose searchId_ differs hold nothing from the current search.
+// Shared by all worlds and threads so no two searches ever get the same number.
+static std::atomic<Uint64> astarSearches(0);
+
+bool astar(SDL_Surface* winSurface, SDL_Window* window, std::vector<std::vector<tile*>>& tiles, tile* start, tile* finish, std::vector<tile*>& path, const landmarkData* landmarks, astarQueue* open, int cheapestWeight, metricsCounters* counters)
 {
-	// Initialization
-	std::list<tile*> open;
-	std::list<tile*> closed;
-	std::vector<tile*> empty;
-	tile* current = start;
+	traceScope scope("astar");
+	Uint64 searchStart = SDL_GetPerformanceCounter();
+	Uint64 expanded = 0;
+	Uint64 search = astarSearches.fetch_add(1, std::memory_order_relaxed) + 1;
+	astarQueue localOpen;
+	astarQueue& queue = open != NULL ? *open : localOpen;
+	queue.clear();
+	path.clear();
 	tile* goal = finish;
-	tile* begin = start;
-	/*
-	for (int i = 0; i < tiles.size(); i++)
-	{
-		for (int j = 0; j < tiles[0].size(); j++)
-		{
-			if (tiles[i][j]->state_ == 3) 
-			{
-				goal = tiles[i][j];
-			}
-			if (tiles[i][j]->state_ == 2)
-			{
-				current = tiles[i][j];
-				begin = current;
-			}
-			tiles[i][j]->openclosed = 2;
-		}
-	}
-	if (goal == NULL)
-	{
-		std::cout << "Goal is null" << std::endl;
-		system("pause");
-		exit(1);
-	}
-	if (current == NULL)
-	{
-		std::cout << "Current is null" << std::endl;
-		system("pause");
-		exit(1);
-	}
-	*/
-	// Begin algorithm
-	// calculate start point f,g,h
-	current->h_=current->distTo(goal);
-	current->g_ = 0;
-	current->f_ = current->h_;
-	open.push_back(current);
-	while (open.size()>0)
+	int maph = tiles.size();
+	int mapw = tiles[0].size();
+	// No path ends in a wall, and the shared tile of an all-wall chunk has no position to aim at
+	if (isImplicitWall(goal)) return false;
+
+	// openclosed: 0 open, 1 closed, only meaningful on tiles stamped with this search
+	start->searchId_ = search;
+	start->h_ = altDistance(landmarks, start, goal, cheapestWeight);
+	start->g_ = 0;
+	start->f_ = start->h_;
+	start->parent_ = NULL;
+	start->openclosed = 0;
+	astarEntry first = { start->f_, start };
+	queue.push(first.f_, first);
+	bool found = false;
+	while (queue.size() > 0)
 	{
-		// find lowest f value, init to very big
-		int lowestf = INT_MAX;
-		std::vector<tile*> fvalues;
-		int index;
-		for (auto tile:open)
-		{
-			tile->f_ = tile->g_ + tile->h_;
-			fvalues.push_back(tile);
-		}
-		for (int i = 0; i < fvalues.size(); i++)
+		int key;
+		astarEntry entry = queue.pop(key);
+		tile* current = entry.tile_;
+		int f = entry.f_;
+		// Entries left behind by a cheaper path to the same tile
+		if (current->openclosed == 1 || f != current->f_) continue;
+		current->openclosed = 1;
+		expanded++;
+		if (current == goal)
 		{
-			if (fvalues[i]->f_ < lowestf) 
-			{ 
-				lowestf = fvalues[i]->f_; 
-				index = i;
-			}
+			found = true;
+			break;
 		}
-		current = fvalues[index];
-
-
-		if (current == goal) { goto GET_MOVE_SEQUENCE; }
-		// generate successors
-		std::list<tile*> successors;
-		int maph = tiles.size();
-		int mapw = tiles[0].size();
 
 		for (int i = -1; i <= 1; i++)
 		{
@@ -91,73 +68,47 @@ std::vector<tile*> astar(SDL_Surface* winSurface, SDL_Window* window, std::vecto
 				if (nj < 0) continue;
 				if (ni >= maph) continue;
 				if (nj >= mapw) continue;
-				if (tiles[ni][nj]->state_ == 1 || tiles[ni][nj]->state_ == 3) continue;
-				for (auto unit : units)
-				{
-					if (unit->tileAt_->x_ == nj && unit->tileAt_->y_ == ni)
-					{
-						goto BREAK_LOOPS;
-					}
+				tile* successor = tiles[ni][nj];
+				// Walls of an all-wall chunk are turned away without reading a tile
+				if (isImplicitWall(successor)) continue;
+				if (successor->state_ == 1 || successor->state_ == 3) continue;
+				if (successor->unitAt_ != NULL) continue;
 
+				int successorcurrentcost = current->g_ + successor->stepCost(current);
+				if (successor->searchId_ == search)
+				{
+					if (successor->g_ <= successorcurrentcost) continue;
 				}
-				successors.push_back(tiles[ni][nj]);
-			BREAK_LOOPS:
-				continue;
-			}
-		}
-		// compute successor f,g,h and open/closed
-		for (auto tile:successors)
-		{
-			int successorcurrentcost = current->g_ + tile->distTo(current);
-			if (std::find(open.begin(), open.end(), tile) != open.end())
-			{
-				if (tile->g_ <= successorcurrentcost) { continue; }
-			}
-			else if (std::find(closed.begin(), closed.end(), tile) != closed.end())
-			{
-				if (tile->g_ <= successorcurrentcost) { continue; }
-				closed.remove(tile);
-				open.push_back(tile);
-			}
-			else 
-			{
-				open.push_back(tile);
-				tile->h_ = tile->distTo(goal);
+				else
+				{
+					successor->searchId_ = search;
+					successor->h_ = altDistance(landmarks, successor, goal, cheapestWeight);
+				}
+				// Reopened if it was closed, the heuristic may be inconsistent with landmarks
+				successor->openclosed = 0;
+				successor->g_ = successorcurrentcost;
+				successor->f_ = successor->g_ + successor->h_;
+				successor->parent_ = current;
+				astarEntry entry = { successor->f_, successor };
+				queue.push(entry.f_, entry);
 			}
-			tile->g_ = successorcurrentcost;
-			tile->parent_ = current;
-		}
-
-
-		// Set current tile to closed and synchronize openclosedlist with tile openclosed
-		open.remove(current);
-		closed.push_back(current);
-		for (auto tile : open)
-		{
-			tile->openclosed = 0;
 		}
-		for (auto tile : closed)
-		{
-			tile->openclosed = 1;
-		}
-		/*
-		// Render piecewise
-		drawMap(winSurface, window, tiles);
-		*/
 	}
-	//std::cout << "Error: Open list became empty, could not find path" << std::endl;
-	return empty;
 
-	// system("pause");
-	// exit(1);
-GET_MOVE_SEQUENCE:
-	std::vector<tile*> path;
-	while (current != begin)
+	if (counters != NULL)
+	{
+		countMetric(counters->astarCalls_);
+		countMetric(counters->astarNodes_, expanded);
+		countMetric(counters->astarTicks_, SDL_GetPerformanceCounter() - searchStart);
+		if (!found) countMetric(counters->astarFailed_);
+	}
+	if (!found)
 	{
-		path.push_back(current);
-		current = current->parent_;
+		//std::cout << "Error: Open list became empty, could not find path" << std::endl;
+		return false;
 	}
+	for (tile* step = goal; step != start; step = step->parent_) path.push_back(step);
 	std::reverse(path.begin(), path.end());
 	// std::cout << "Found path" << std::endl;
-	return path;
-}
\ No newline at end of file
+	return true;
+}
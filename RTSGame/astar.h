@@ -1,5 +1,22 @@
 #pragma once
 #include "main.h"
+#include "bucketqueue.h"
 struct tile;
-struct unit;
-std::vector<tile*> astar(SDL_Surface* winSurface, SDL_Window* window, std::vector<std::vector<tile*>>& tiles, std::list<unit*> &units, tile* start, tile* finish);
\ No newline at end of file
+struct landmarkData;
+struct metricsCounters;
+
+// Open list entry, f is copied in because a tile's own f_ changes while older entries wait in the queue
+struct astarEntry
+{
+	int f_;
+	tile* tile_;
+};
+typedef bucketQueue<astarEntry> astarQueue;
+
+// Writes a cheapest path from start to finish into path, in walking order without start, empty if there is none.
+// Steps cost tile::stepCost. Walls, factories and tiles with a unit on them are avoided. Returns whether a path was found.
+// landmarks, when not NULL, tighten the heuristic with the ALT lower bound. cheapestWeight is the lowest terrainWeight
+// on the map, the octile part of the heuristic is scaled by it.
+// open, when not NULL, is used for the open list so its memory carries over between searches.
+// counters, when not NULL, count the search.
+bool astar(SDL_Surface* winSurface, SDL_Window* window, std::vector<std::vector<tile*>>& tiles, tile* start, tile* finish, std::vector<tile*>& path, const landmarkData* landmarks = NULL, astarQueue* open = NULL, int cheapestWeight = 2, metricsCounters* counters = NULL);
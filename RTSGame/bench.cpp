@@ -0,0 +1,407 @@
+#include "bench.h"
+#include "world.h"
+#include "tile.h"
+#include "unit.h"
+#include "player.h"
+#include "simulation.h"
+#include "mapfile.h"
+#include "mapgen.h"
+#include "components.h"
+#include "astar.h"
+#include "drawmap.h"
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+struct benchResult
+{
+	std::string scenario_;
+	int width_;
+	int height_;
+	int units_;
+	int factories_;
+	std::string kernel_;
+	int ops_; // operations per repetition
+	double min_; // ns per operation
+	double median_;
+	double mean_;
+	double stddev_;
+};
+
+struct benchContext
+{
+	int reps_;
+	Uint32 seed_;
+	SDL_Surface* surface_; // window sized, so drawing costs what it costs on screen
+	std::vector<benchResult> results_;
+	bool failed_; // a kernel didn't do the work it was supposed to time
+};
+
+// Summarizes the per-operation times of each repetition
+static void addResult(benchContext& context, const world& w, const std::string& scenario, const std::string& kernel, int ops, std::vector<double>& times)
+{
+	benchResult result;
+	result.scenario_ = scenario;
+	result.width_ = w.tiles_[0].size();
+	result.height_ = w.tiles_.size();
+	result.units_ = w.units_.size();
+	result.factories_ = w.factories_.size();
+	result.kernel_ = kernel;
+	result.ops_ = ops;
+	std::sort(times.begin(), times.end());
+	result.min_ = times.front();
+	result.median_ = times.size() % 2 == 1 ? times[times.size() / 2] : (times[times.size() / 2 - 1] + times[times.size() / 2]) / 2;
+	result.mean_ = 0;
+	for (auto time : times) result.mean_ += time;
+	result.mean_ /= times.size();
+	result.stddev_ = 0;
+	for (auto time : times) result.stddev_ += (time - result.mean_) * (time - result.mean_);
+	result.stddev_ = times.size() > 1 ? std::sqrt(result.stddev_ / (times.size() - 1)) : 0;
+	context.results_.push_back(result);
+	std::cout << std::left << std::setw(14) << scenario << std::setw(10) << kernel << std::right << std::fixed << std::setprecision(1)
+		<< std::setw(16) << result.median_ << std::setw(16) << result.min_ << std::setw(16) << result.stddev_ << std::setw(8) << ops << std::endl;
+	std::cout.unsetf(std::ios::fixed);
+}
+
+static double nanoseconds(Uint64 ticks)
+{
+	return ticks * 1e9 / double(SDL_GetPerformanceFrequency());
+}
+
+// Random open tile in the given region, or NULL if none was hit in a few hundred tries
+static tile* randomOpenTile(world& w, std::mt19937& gen, const tile* region)
+{
+	std::uniform_int_distribution<int> row(0, w.tiles_.size() - 1);
+	std::uniform_int_distribution<int> column(0, w.tiles_[0].size() - 1);
+	for (int attempt = 0; attempt < 500; attempt++)
+	{
+		tile* tilePtr = w.tiles_[row(gen)][column(gen)];
+		if (tilePtr->state_ != 0 || tilePtr->unitAt_ != NULL) continue;
+		if (region != NULL && !sameComponent(tilePtr, region)) continue;
+		return tilePtr;
+	}
+	return NULL;
+}
+
+static void benchKernels(benchContext& context, world& w, const std::string& scenario)
+{
+	std::mt19937 gen(context.seed_);
+	std::vector<double> times;
+	tile* region = w.players_.size() > 0 && w.players_[0]->units_.size() > 0 ? w.players_[0]->units_.front()->tileAt_ : NULL;
+
+	// astar between random open tiles of the region the players are in, no further apart than orders usually are,
+	// so searches across a big map don't take the whole run
+	const int searches = 8;
+	const int searchRange = 32;
+	std::vector<std::pair<tile*, tile*>> pairs;
+	for (int i = 0; i < searches * context.reps_ * 20 && pairs.size() < (size_t)(searches * context.reps_); i++)
+	{
+		tile* from = randomOpenTile(w, gen, region);
+		if (from == NULL) break;
+		tile* to = w.tiles_[std::max(0, std::min((int)w.tiles_.size() - 1, from->y_ + int(gen() % (2 * searchRange + 1)) - searchRange))]
+			[std::max(0, std::min((int)w.tiles_[0].size() - 1, from->x_ + int(gen() % (2 * searchRange + 1)) - searchRange))];
+		if (to != from && to->state_ == 0 && to->unitAt_ == NULL && sameComponent(from, to)) pairs.push_back(std::make_pair(from, to));
+	}
+	if (pairs.size() >= (size_t)context.reps_)
+	{
+		int perRep = pairs.size() / context.reps_;
+		std::vector<tile*> path;
+		for (int rep = 0; rep < context.reps_; rep++)
+		{
+			Uint64 start = SDL_GetPerformanceCounter();
+			for (int i = 0; i < perRep; i++)
+			{
+				std::pair<tile*, tile*>& pair = pairs[rep * perRep + i];
+				astar(NULL, NULL, w.tiles_, pair.first, pair.second, path, NULL, &w.astarOpen_, w.cheapestWeight_);
+			}
+			times.push_back(nanoseconds(SDL_GetPerformanceCounter() - start) / perRep);
+		}
+		addResult(context, w, scenario, "astar", perRep, times);
+	}
+
+	// distTo between random tiles, summed so the calls can't be optimized away
+	const int distances = 100000;
+	std::vector<tile*> ends;
+	std::uniform_int_distribution<int> row(0, w.tiles_.size() - 1);
+	std::uniform_int_distribution<int> column(0, w.tiles_[0].size() - 1);
+	for (int attempt = 0; attempt < 65536 && ends.size() < 1024; attempt++)
+	{
+		// The shared tile of an all-wall chunk has no position to measure from
+		tile* tilePtr = w.tiles_[row(gen)][column(gen)];
+		if (!isImplicitWall(tilePtr)) ends.push_back(tilePtr);
+	}
+	Uint64 sum = 0;
+	times.clear();
+	if (ends.size() == 1024)
+	{
+		for (int rep = 0; rep < context.reps_; rep++)
+		{
+			Uint64 start = SDL_GetPerformanceCounter();
+			for (int i = 0; i < distances; i++) sum += ends[i & 1023]->distTo(ends[(i * 7 + 13) & 1023]);
+			times.push_back(nanoseconds(SDL_GetPerformanceCounter() - start) / distances);
+		}
+		if (sum == 1) std::cout << std::endl;
+		addResult(context, w, scenario, "distTo", distances, times);
+	}
+
+	// act, every AI player deciding a few times on a fresh copy of the position
+	const int decisions = 10;
+	double frequency = double(SDL_GetPerformanceFrequency());
+	times.clear();
+	int actOps = 0;
+	for (int rep = 0; rep < context.reps_; rep++)
+	{
+		world position;
+		cloneWorld(w, position);
+		position.verbose_ = false;
+		position.rng_.seed(context.seed_ + rep);
+		Uint64 elapsed = 0;
+		actOps = 0;
+		for (int i = 0; i < decisions; i++)
+		{
+			for (auto playerPtr : position.players_)
+			{
+				Uint64 start = SDL_GetPerformanceCounter();
+				playerPtr->deadline_ = start + (Uint64)(playerPtr->budgetUs_ * frequency / 1000000);
+				playerPtr->act(position);
+				elapsed += SDL_GetPerformanceCounter() - start;
+				actOps++;
+			}
+		}
+		times.push_back(nanoseconds(elapsed) / std::max(1, actOps));
+		clearWorld(position);
+	}
+	if (actOps > 0) addResult(context, w, scenario, "act", actOps, times);
+
+	// combat, every fighter attacking a few frames in a row. With fewer than two players nobody has anyone to hit.
+	const int passes = 10;
+	times.clear();
+	int combatOps = 0;
+	for (int rep = 0; rep < context.reps_ && w.players_.size() > 1; rep++)
+	{
+		world position;
+		cloneWorld(w, position);
+		int fighters = 0;
+		for (auto playerPtr : position.players_) fighters += playerPtr->ofType_[unitFighter].size();
+		std::vector<unit*> deadUnits;
+		combatOps = passes * fighters;
+		Uint64 elapsed = 0;
+		for (int i = 0; i < passes; i++)
+		{
+			Uint64 start = SDL_GetPerformanceCounter();
+			int damage = resolveCombat(position, deadUnits);
+			elapsed += SDL_GetPerformanceCounter() - start;
+			if (damage == 0 && !context.failed_)
+			{
+				std::cout << "Combat pass on " << scenario << " hit nothing, the kernel would time an empty loop" << std::endl;
+				context.failed_ = true;
+			}
+		}
+		times.push_back(nanoseconds(elapsed) / std::max(1, combatOps));
+		clearWorld(position);
+	}
+	if (combatOps > 0) addResult(context, w, scenario, "combat", combatOps, times);
+
+	// spawnUnit, each spawned unit is removed again untimed so the factories keep room
+	times.clear();
+	int spawnOps = 0;
+	for (int rep = 0; rep < context.reps_; rep++)
+	{
+		world position;
+		cloneWorld(w, position);
+		Uint64 elapsed = 0;
+		spawnOps = 0;
+		for (int i = 0; i < passes; i++)
+		{
+			for (auto factoryPtr : position.factories_)
+			{
+				factoryPtr->claimedBy_->resources_ = 10;
+				size_t before = position.units_.size();
+				Uint64 start = SDL_GetPerformanceCounter();
+				factoryPtr->spawnUnit(position);
+				elapsed += SDL_GetPerformanceCounter() - start;
+				spawnOps++;
+				if (position.units_.size() > before) removeUnit(position, position.units_.back());
+			}
+		}
+		times.push_back(nanoseconds(elapsed) / std::max(1, spawnOps));
+		clearWorld(position);
+	}
+	if (spawnOps > 0) addResult(context, w, scenario, "spawnUnit", spawnOps, times);
+
+	// drawMap into the off-screen surface, the whole map is walked even where it falls outside
+	const int frames = 1; // a whole big map per frame is slow enough to time on its own
+	times.clear();
+	for (int rep = 0; rep < context.reps_; rep++)
+	{
+		Uint64 start = SDL_GetPerformanceCounter();
+		for (int i = 0; i < frames; i++) drawMap(context.surface_, NULL, w.tiles_, w.units_, w.players_);
+		times.push_back(nanoseconds(SDL_GetPerformanceCounter() - start) / frames);
+	}
+	addResult(context, w, scenario, "drawMap", frames, times);
+}
+
+// Places players, plays warmupFrames and adds extraUnits more fighters, then runs every kernel.
+// The extra fighters come in pairs of different players standing next to each other, so combat always has hits to time.
+static void benchScenario(benchContext& context, world& w, const std::string& scenario, int playerCount, int extraUnits, int warmupFrames)
+{
+	w.verbose_ = false;
+	w.rng_.seed(context.seed_);
+	std::vector<tile*> starts;
+	if (!pickStartTiles(w, playerCount, starts))
+	{
+		std::cout << "No room for " << playerCount << " players on " << scenario << ", skipped" << std::endl;
+		clearWorld(w);
+		return;
+	}
+	for (auto start : starts) addPlayer(w, false, start->y_, start->x_);
+	simTimers timers(0);
+	Uint64 now = 0;
+	for (int frame = 0; frame < warmupFrames && w.players_.size() > 1; frame++)
+	{
+		now += headlessFrameMs;
+		stepWorld(w, timers.poll(now));
+	}
+	if (w.players_.size() == 0)
+	{
+		std::cout << "Every player died during warmup on " << scenario << ", skipped" << std::endl;
+		clearWorld(w);
+		return;
+	}
+	// Start tiles may have been built on since, a unit is sure to stand in the region
+	std::mt19937 gen(context.seed_);
+	const tile* region = w.players_[0]->units_.size() > 0 ? w.players_[0]->units_.front()->tileAt_ : NULL;
+	static const int offsets[4][2] = { { -1, 0 }, { 0, -1 }, { 0, 1 }, { 1, 0 } };
+	int players = w.players_.size();
+	for (int i = 0, attempt = 0; i + 1 < extraUnits && attempt < 20 * extraUnits; attempt++)
+	{
+		tile* tilePtr = randomOpenTile(w, gen, region);
+		if (tilePtr == NULL) break;
+		const int* offset = offsets[gen() % 4];
+		int r = tilePtr->y_ + offset[0];
+		int c = tilePtr->x_ + offset[1];
+		if (r < 0 || c < 0 || r >= (int)w.tiles_.size() || c >= (int)w.tiles_[0].size()) continue;
+		tile* near = w.tiles_[r][c];
+		if (near->state_ != 0 || near->unitAt_ != NULL) continue;
+		addUnit(w, w.players_[i % players], unitFighter, tilePtr->y_, tilePtr->x_);
+		addUnit(w, w.players_[(i + 1) % players], unitFighter, near->y_, near->x_);
+		i += 2;
+	}
+	benchKernels(context, w, scenario);
+	clearWorld(w);
+}
+
+static bool writeBenchJson(const benchContext& context, const std::string& path)
+{
+	std::ofstream out(path);
+	if (!out)
+	{
+		std::cout << "Could not open " << path << " for writing" << std::endl;
+		return false;
+	}
+	out << "{\"seed\": " << context.seed_ << ", \"reps\": " << context.reps_ << ", \"results\": [" << std::endl;
+	for (size_t i = 0; i < context.results_.size(); i++)
+	{
+		const benchResult& result = context.results_[i];
+		out << "\t{\"scenario\": \"" << result.scenario_ << "\", \"width\": " << result.width_ << ", \"height\": " << result.height_
+			<< ", \"units\": " << result.units_ << ", \"factories\": " << result.factories_ << ", \"kernel\": \"" << result.kernel_
+			<< "\", \"ops\": " << result.ops_ << ", \"min_ns\": " << result.min_ << ", \"median_ns\": " << result.median_
+			<< ", \"mean_ns\": " << result.mean_ << ", \"stddev_ns\": " << result.stddev_ << "}" << (i + 1 < context.results_.size() ? "," : "") << std::endl;
+	}
+	out << "]}" << std::endl;
+	return out.good();
+}
+
+static bool writeBenchCsv(const benchContext& context, const std::string& path)
+{
+	std::ofstream out(path);
+	if (!out)
+	{
+		std::cout << "Could not open " << path << " for writing" << std::endl;
+		return false;
+	}
+	out << "scenario,width,height,units,factories,kernel,ops,reps,min_ns,median_ns,mean_ns,stddev_ns" << std::endl;
+	for (auto& result : context.results_)
+	{
+		out << result.scenario_ << "," << result.width_ << "," << result.height_ << "," << result.units_ << "," << result.factories_ << ","
+			<< result.kernel_ << "," << result.ops_ << "," << context.reps_ << "," << result.min_ << "," << result.median_ << ","
+			<< result.mean_ << "," << result.stddev_ << std::endl;
+	}
+	return out.good();
+}
+
+int runBench(int argc, char** args, int first)
+{
+	std::string mapPath = "map.txt";
+	std::vector<int> sizes = { 64, 128, 256 };
+	std::string jsonPath;
+	std::string csvPath;
+	int warmupFrames = 2000;
+	benchContext context;
+	context.reps_ = 10;
+	context.seed_ = 1;
+	context.failed_ = false;
+	for (int i = first; i < argc; i++)
+	{
+		std::string arg = args[i];
+		if (i + 1 >= argc)
+		{
+			std::cout << "Missing value for " << arg << std::endl;
+			return 1;
+		}
+		std::string value = args[++i];
+		if (arg == "--map") mapPath = value;
+		else if (arg == "--sizes")
+		{
+			sizes.clear();
+			std::stringstream list(value);
+			std::string size;
+			while (std::getline(list, size, ','))
+			{
+				if (size.size() > 0) sizes.push_back(std::max(16, std::stoi(size)));
+			}
+		}
+		else if (arg == "--reps") context.reps_ = std::max(1, std::stoi(value));
+		else if (arg == "--warmup") warmupFrames = std::max(0, std::stoi(value));
+		else if (arg == "--seed") context.seed_ = std::stoul(value);
+		else if (arg == "--json") jsonPath = value;
+		else if (arg == "--csv") csvPath = value;
+		else
+		{
+			std::cout << "Unknown benchmark option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	context.surface_ = SDL_CreateRGBSurfaceWithFormat(0, 1600, 900, 32, SDL_PIXELFORMAT_RGB888);
+	std::cout << std::left << std::setw(14) << "scenario" << std::setw(10) << "kernel" << std::right << std::setw(16) << "median ns"
+		<< std::setw(16) << "min ns" << std::setw(16) << "stddev" << std::setw(8) << "ops" << std::endl;
+	std::cout.unsetf(std::ios::adjustfield);
+
+	world w;
+	w.surface_ = context.surface_;
+	if (loadWorldMap(w, mapPath)) benchScenario(context, w, mapPath, 2, 16, warmupFrames);
+	else std::cout << "Could not load " << mapPath << ", skipped" << std::endl;
+	for (auto size : sizes)
+	{
+		// More room means more players and a denser fight, about one extra fighter per 80 tiles
+		mapGenParams params;
+		params.width_ = size;
+		params.height_ = size;
+		params.resourceClusters_ = size * size / 1024;
+		params.seed_ = context.seed_;
+		std::vector<Uint8> states;
+		generateMap(params, states);
+		allocateTiles(w.tiles_, states.data(), size, size);
+		terrainLoaded(w);
+		std::string scenario = "gen" + std::to_string(size);
+		benchScenario(context, w, scenario, std::min(8, std::max(2, size / 32)), size * size / 80, warmupFrames);
+	}
+
+	bool written = true;
+	if (jsonPath.size() > 0) written = writeBenchJson(context, jsonPath) && written;
+	if (csvPath.size() > 0) written = writeBenchCsv(context, csvPath) && written;
+	SDL_FreeSurface(context.surface_);
+	if (context.failed_) std::cout << "Benchmark failed" << std::endl;
+	return written && !context.failed_ ? 0 : 1;
+}
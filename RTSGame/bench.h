@@ -0,0 +1,13 @@
+#pragma once
+#include "main.h"
+
+/* Microbenchmarks of the simulation hot paths
+Every kernel runs in repetitions of a fixed batch of operations, and each repetition gives one time per operation.
+Scenarios are the given map with two players and generated square maps with more players and units as they grow,
+each played into the midgame first so there are paths, factories and fights to measure.
+Kernels: astar, distTo, act, combat (one fighter's attacks), spawnUnit and drawMap into an off-screen surface.
+*/
+
+// --bench [--map file --sizes 64,128,256 --reps n --warmup frames --seed s --json file --csv file]
+// Prints a table and optionally writes the results as JSON or CSV for tracking regressions
+int runBench(int argc, char** args, int first);
@@ -0,0 +1,94 @@
+#pragma once
+#include "main.h"
+
+/* Bucket queue (Dial's algorithm) for the small integer keys of path searches
+Every step costs at most a few dozen, so the keys waiting in a Dijkstra or consistent A* open list never lie more than
+a few dozen above the last key popped. They are kept in a ring of bucketQueueRing buckets indexed by key, which makes
+push and pop O(1) instead of the O(log n) of a heap. Among equal keys the last one pushed comes out first, so A* ties
+go to the deepest node. A key below the last one popped is treated as equal to it and one too far above is treated
+as the farthest the ring holds, both only happen with an inconsistent heuristic and cost optimality, not correctness.
+Every bucket is a list threaded through one shared entry pool, with popped entries reused by the next push, so the
+queue holds no more memory than a heap of the same size would and, like one, can be reserved up front. clear() keeps
+that memory, so a refilled queue stops allocating once it has been as full as it gets.
+*/
+const int bucketQueueRing = 64; // more than twice the dearest step, see terrainWeight
+
+template <typename Value>
+struct bucketQueue
+{
+	bucketQueue()
+	{
+		heads_.assign(bucketQueueRing, -1);
+		free_ = -1;
+		current_ = -1;
+		size_ = 0;
+	}
+
+	void clear()
+	{
+		std::fill(heads_.begin(), heads_.end(), -1);
+		entries_.clear();
+		free_ = -1;
+		current_ = -1;
+		size_ = 0;
+	}
+
+	// Room for count values queued at once
+	void reserve(size_t count)
+	{
+		entries_.reserve(count);
+	}
+
+	// Keys are never negative
+	void push(int key, const Value& value)
+	{
+		if (current_ < 0) current_ = key;
+		key = std::min(std::max(key, current_), current_ + bucketQueueRing - 1);
+		int slot = free_;
+		if (slot >= 0)
+		{
+			free_ = entries_[slot].next_;
+			entries_[slot].value_ = value;
+		}
+		else
+		{
+			slot = entries_.size();
+			entries_.push_back(entry());
+			entries_[slot].value_ = value;
+		}
+		int& head = heads_[key & (bucketQueueRing - 1)];
+		entries_[slot].next_ = head;
+		head = slot;
+		size_++;
+	}
+
+	// Lowest key first, the queue must not be empty. key is set to the key the value was filed under.
+	Value pop(int& key)
+	{
+		while (heads_[current_ & (bucketQueueRing - 1)] < 0) current_++;
+		int& head = heads_[current_ & (bucketQueueRing - 1)];
+		int slot = head;
+		head = entries_[slot].next_;
+		entries_[slot].next_ = free_;
+		free_ = slot;
+		size_--;
+		key = current_;
+		return entries_[slot].value_;
+	}
+
+	size_t size() const
+	{
+		return size_;
+	}
+
+	struct entry
+	{
+		Value value_;
+		int next_; // next older entry of the same bucket, or of the free list, -1 at the end
+	};
+	std::vector<int> heads_; // newest entry of each bucket, -1 while it is empty
+	std::vector<entry> entries_;
+	int free_; // popped entries, reused before entries_ grows
+	int current_; // no key below this is queued, -1 until the first push after clear()
+	size_t size_;
+};
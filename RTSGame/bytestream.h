@@ -0,0 +1,38 @@
+#pragma once
+#include "main.h"
+#include <cstring>
+
+// Little-endian byte buffer helpers shared by the binary snapshot and command log formats
+struct byteWriter
+{
+	byteWriter(std::vector<Uint8>& buffer) : buffer_(buffer) {}
+	template <typename T> void put(const T& value)
+	{
+		size_t at = buffer_.size();
+		buffer_.resize(at + sizeof(T));
+		memcpy(&buffer_[at], &value, sizeof(T));
+	}
+	std::vector<Uint8>& buffer_;
+};
+
+struct byteReader
+{
+	byteReader(const Uint8* data, size_t size) : data_(data), size_(size), offset_(0), failed_(false) {}
+	template <typename T> T get()
+	{
+		T value = T();
+		if (size_ - offset_ < sizeof(T))
+		{
+			failed_ = true;
+			offset_ = size_;
+			return value;
+		}
+		memcpy(&value, data_ + offset_, sizeof(T));
+		offset_ += sizeof(T);
+		return value;
+	}
+	const Uint8* data_;
+	size_t size_;
+	size_t offset_;
+	bool failed_; // set once a read runs past the end of the data
+};
@@ -0,0 +1,89 @@
+#include "chunks.h"
+#include "world.h"
+#include "tile.h"
+#include "unit.h"
+
+chunkSummary::chunkSummary()
+{
+	area_ = 0;
+	open_ = 0;
+	walls_ = 0;
+	resources_ = 0;
+	factories_ = 0;
+	units_ = 0;
+}
+
+chunkGrid::chunkGrid()
+{
+	width_ = 0;
+	height_ = 0;
+}
+
+const chunkSummary& chunkGrid::of(const tile* tilePtr) const
+{
+	return at(tilePtr->y_ / chunkSize, tilePtr->x_ / chunkSize);
+}
+
+static chunkSummary& chunkOf(world& w, const tile* tilePtr)
+{
+	return w.chunks_.chunks_[(tilePtr->y_ / chunkSize) * w.chunks_.width_ + tilePtr->x_ / chunkSize];
+}
+
+static void countState(chunkSummary& chunk, int state, int count)
+{
+	switch (state)
+	{
+	case(0):
+	case(4):
+	case(5):
+		chunk.open_ += count;
+		break;
+	case(1):
+		chunk.walls_ += count;
+		break;
+	case(2):
+		chunk.resources_ += count;
+		break;
+	case(3):
+		chunk.factories_ += count;
+		break;
+	}
+}
+
+void rebuildChunks(world& w)
+{
+	chunkGrid& grid = w.chunks_;
+	int height = w.tiles_.size();
+	int width = height > 0 ? w.tiles_[0].size() : 0;
+	grid.width_ = (width + chunkSize - 1) / chunkSize;
+	grid.height_ = (height + chunkSize - 1) / chunkSize;
+	grid.chunks_.assign((size_t)grid.width_ * grid.height_, chunkSummary());
+	// By position, walls of an all-wall chunk share one tile that has none
+	for (int r = 0; r < height; r++)
+	{
+		for (int c = 0; c < width; c++)
+		{
+			chunkSummary& chunk = grid.chunks_[(r / chunkSize) * grid.width_ + c / chunkSize];
+			chunk.area_++;
+			countState(chunk, w.tiles_[r][c]->state_, 1);
+		}
+	}
+	for (auto unitPtr : w.units_) chunkOf(w, unitPtr->tileAt_).units_++;
+}
+
+void chunkTilesChanged(world& w, const std::vector<tileChange>& changes)
+{
+	for (auto& change : changes)
+	{
+		if (change.kind_ != tileStateChanged) continue;
+		chunkSummary& chunk = chunkOf(w, change.tile_);
+		countState(chunk, change.oldState_, -1);
+		countState(chunk, change.newState_, 1);
+	}
+}
+
+void chunkUnitMoved(world& w, const tile* from, const tile* to)
+{
+	if (from != NULL) chunkOf(w, from).units_--;
+	if (to != NULL) chunkOf(w, to).units_++;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "main.h"
+#include "tileevents.h"
+struct world;
+struct tile;
+
+/* Chunk summaries
+The map is cut into chunkSize square chunks, each keeping counts of what its tiles hold, so a scan can tell from one
+lookup that a whole chunk has nothing it is looking for. Tile counts follow the tile change events and are exact once
+a frame is published, a factory built earlier in the same frame may still count as the ground it was built on. Unit
+counts follow the units themselves and are always exact.
+*/
+const int chunkSize = 16;
+
+struct chunkSummary
+{
+	chunkSummary();
+	int area_; // tiles in the chunk, fewer than chunkSize squared along the right and bottom edge
+	int open_; // walkable ground: open, slow and road tiles
+	int walls_;
+	int resources_;
+	int factories_;
+	int units_; // units standing in the chunk
+	bool allWall() const { return walls_ == area_; }
+	bool allOpen() const { return open_ == area_; }
+	bool hasResources() const { return resources_ > 0; }
+	bool hasUnits() const { return units_ > 0; }
+};
+
+struct chunkGrid
+{
+	chunkGrid();
+	int width_; // in chunks
+	int height_;
+	std::vector<chunkSummary> chunks_;
+	const chunkSummary& at(int chunkRow, int chunkColumn) const { return chunks_[chunkRow * width_ + chunkColumn]; }
+	const chunkSummary& of(const tile* tilePtr) const;
+};
+
+// Recounts every chunk, called whenever a map or snapshot is loaded
+void rebuildChunks(world& w);
+// Subscribed to tile state changes
+void chunkTilesChanged(world& w, const std::vector<tileChange>& changes);
+// A unit left from and arrived at to, either is NULL for a unit that was just added or is being removed
+void chunkUnitMoved(world& w, const tile* from, const tile* to);
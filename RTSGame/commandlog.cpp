@@ -0,0 +1,303 @@
+#include "commandlog.h"
+#include "world.h"
+#include "tile.h"
+#include "unit.h"
+#include "player.h"
+#include "snapshot.h"
+#include "bytestream.h"
+#include "landmarks.h"
+
+// Flush to disk once this much has been buffered
+const size_t commandLogFlushSize = 1 << 16;
+
+commandLog::commandLog()
+{
+}
+
+commandLog::~commandLog()
+{
+	flush();
+}
+
+bool commandLog::open(const std::string& path, const world& w, Uint32 seed)
+{
+	out_.open(path, std::ios::binary | std::ios::trunc);
+	if (!out_)
+	{
+		std::cout << "Could not open command log " << path << std::endl;
+		return false;
+	}
+	buffer_.clear();
+	byteWriter out(buffer_);
+	out.put<char>('R');
+	out.put<char>('T');
+	out.put<char>('S');
+	out.put<char>('L');
+	out.put<Uint32>(commandLogVersion);
+	out.put<Uint32>(seed);
+	out.put<Uint32>(w.landmarks_ == NULL ? 0 : w.landmarks_->count_);
+	out.put<Uint8>(w.cooperative_);
+	snapshot(w);
+	return true;
+}
+
+void commandLog::createPlayer(bool human, int row, int column)
+{
+	byteWriter out(buffer_);
+	out.put<Uint8>(cmdCreatePlayer);
+	out.put<Uint8>(human);
+	out.put<Sint32>(row);
+	out.put<Sint32>(column);
+}
+
+void commandLog::navigate(int unitId, tile* goal)
+{
+	byteWriter out(buffer_);
+	out.put<Uint8>(cmdNavigate);
+	out.put<Sint32>(unitId);
+	out.put<Sint32>(goal->y_);
+	out.put<Sint32>(goal->x_);
+}
+
+void commandLog::buildFactory(int unitId, int factoryType)
+{
+	byteWriter out(buffer_);
+	out.put<Uint8>(cmdBuildFactory);
+	out.put<Sint32>(unitId);
+	out.put<Uint8>(factoryType);
+}
+
+void commandLog::frame(const tickFlags& flags)
+{
+	byteWriter out(buffer_);
+	out.put<Uint8>(cmdFrame);
+	out.put<Uint8>(flags.miningTimerDone | flags.unitSpawnTimerDone << 1 | flags.unitMoveTimerDone << 2 | flags.aiActTimerDone << 3);
+}
+
+void commandLog::frameEnd()
+{
+	byteWriter out(buffer_);
+	out.put<Uint8>(cmdFrameEnd);
+	if (buffer_.size() >= commandLogFlushSize) flush();
+}
+
+void commandLog::snapshot(const world& w)
+{
+	std::vector<Uint8> state;
+	writeSnapshot(w, state);
+	byteWriter out(buffer_);
+	out.put<Uint8>(cmdSnapshot);
+	out.put<Uint32>(state.size());
+	buffer_.insert(buffer_.end(), state.begin(), state.end());
+}
+
+void commandLog::close(const world& w)
+{
+	byteWriter out(buffer_);
+	out.put<Uint8>(cmdEnd);
+	out.put<Uint64>(worldChecksum(w));
+	flush();
+	out_.close();
+}
+
+void commandLog::flush()
+{
+	if (!out_.is_open() || buffer_.size() == 0) return;
+	out_.write((const char*)buffer_.data(), buffer_.size());
+	out_.flush();
+	buffer_.clear();
+}
+
+commandReplay::commandReplay()
+{
+	offset_ = 0;
+	seed_ = 0;
+	landmarkCount_ = 0;
+	cooperative_ = true;
+	hasChecksum_ = false;
+	checksum_ = 0;
+	missingUnits_ = 0;
+}
+
+bool commandReplay::open(const std::string& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+	{
+		std::cout << "Could not open command log " << path << std::endl;
+		return false;
+	}
+	data_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	byteReader header(data_.data(), data_.size());
+	char magic[4];
+	for (int i = 0; i < 4; i++) magic[i] = header.get<char>();
+	if (memcmp(magic, "RTSL", 4) != 0 || header.get<Uint32>() != commandLogVersion)
+	{
+		std::cout << path << " is not a version " << commandLogVersion << " command log" << std::endl;
+		return false;
+	}
+	seed_ = header.get<Uint32>();
+	landmarkCount_ = header.get<Uint32>();
+	cooperative_ = header.get<Uint8>() != 0;
+	offset_ = header.offset_;
+	return !header.failed_;
+}
+
+static unit* findUnit(world& w, int id)
+{
+	for (auto unitPtr : w.units_)
+	{
+		if (unitPtr->id_ == id) return unitPtr;
+	}
+	return NULL;
+}
+
+static tile* findTile(world& w, int row, int column)
+{
+	if (row < 0 || column < 0 || row >= (int)w.tiles_.size() || column >= (int)w.tiles_[0].size()) return NULL;
+	return w.tiles_[row][column];
+}
+
+// Applies one record, returns its kind, or 0 at the end of the data
+static int applyRecord(commandReplay& replay, world& w, tickFlags* flags)
+{
+	byteReader in(replay.data_.data(), replay.data_.size());
+	in.offset_ = replay.offset_;
+	int kind = in.get<Uint8>();
+	if (in.failed_) return 0;
+	switch (kind)
+	{
+	case(cmdCreatePlayer):
+	{
+		bool human = in.get<Uint8>() != 0;
+		int row = in.get<Sint32>();
+		int column = in.get<Sint32>();
+		if (!in.failed_) addPlayer(w, human, row, column);
+		break;
+	}
+	case(cmdNavigate):
+	{
+		unit* unitPtr = findUnit(w, in.get<Sint32>());
+		int row = in.get<Sint32>();
+		int column = in.get<Sint32>();
+		tile* goal = findTile(w, row, column);
+		if (unitPtr == NULL || goal == NULL) replay.missingUnits_++;
+		else unitPtr->navigate(w, goal);
+		break;
+	}
+	case(cmdBuildFactory):
+	{
+		unit* unitPtr = findUnit(w, in.get<Sint32>());
+		int factoryType = in.get<Uint8>();
+		if (unitPtr == NULL) replay.missingUnits_++;
+		else unitPtr->buildFactory(w, factoryType);
+		break;
+	}
+	case(cmdFrame):
+	{
+		Uint8 bits = in.get<Uint8>();
+		if (flags != NULL)
+		{
+			flags->miningTimerDone = bits & 1;
+			flags->unitSpawnTimerDone = bits & 2;
+			flags->unitMoveTimerDone = bits & 4;
+			flags->aiActTimerDone = bits & 8;
+		}
+		break;
+	}
+	case(cmdFrameEnd):
+		break;
+	case(cmdSnapshot):
+	{
+		Uint32 size = in.get<Uint32>();
+		if (in.failed_ || in.size_ - in.offset_ < size || !readSnapshot(w, in.data_ + in.offset_, size, w.surface_, w.window_))
+		{
+			in.failed_ = true;
+			break;
+		}
+		in.offset_ += size;
+		break;
+	}
+	case(cmdEnd):
+		replay.checksum_ = in.get<Uint64>();
+		replay.hasChecksum_ = !in.failed_;
+		break;
+	default:
+		std::cout << "Unknown command " << kind << " in log at byte " << replay.offset_ << std::endl;
+		in.failed_ = true;
+		break;
+	}
+	if (in.failed_)
+	{
+		replay.offset_ = replay.data_.size();
+		return 0;
+	}
+	replay.offset_ = in.offset_;
+	return kind;
+}
+
+bool commandReplay::beginFrame(world& w, tickFlags& flags)
+{
+	while (true)
+	{
+		int kind = applyRecord(*this, w, &flags);
+		if (kind == 0 || kind == cmdEnd) return false;
+		if (kind == cmdFrame) return true;
+	}
+}
+
+void commandReplay::applyOrders(world& w)
+{
+	while (true)
+	{
+		int kind = applyRecord(*this, w, NULL);
+		if (kind == 0 || kind == cmdFrameEnd) return;
+	}
+}
+
+int runReplay(const std::string& path)
+{
+	commandReplay replay;
+	if (!replay.open(path)) return 1;
+
+	// Player colors still need a pixel format, a tiny off-screen surface stands in for the window
+	SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, 1, 1, 32, SDL_PIXELFORMAT_RGB888);
+	world w;
+	w.surface_ = surface;
+	w.verbose_ = false;
+	w.rng_.seed(replay.seed_);
+	w.replay_ = &replay;
+	w.cooperative_ = replay.cooperative_;
+	// Refreshed in place, a background refresh would make the searches depend on thread timing
+	landmarkTable landmarks(replay.landmarkCount_, false);
+	if (replay.landmarkCount_ > 0) w.landmarks_ = &landmarks;
+
+	Uint64 frames = 0;
+	tickFlags flags;
+	Uint64 start = SDL_GetPerformanceCounter();
+	while (replay.beginFrame(w, flags))
+	{
+		player* winner = stepWorld(w, flags);
+		frames++;
+		if (winner != NULL) std::cout << "Player with color " << winner->color_ << " wins at frame " << frames << std::endl;
+	}
+	double elapsed = (SDL_GetPerformanceCounter() - start) / double(SDL_GetPerformanceFrequency());
+
+	std::cout << "Replayed " << frames << " frames in " << elapsed << " s (" << (elapsed > 0 ? frames / elapsed : 0) << " frames/s)" << std::endl;
+	std::cout << w.players_.size() << " players, " << w.units_.size() << " units, " << w.factories_.size() << " factories remain" << std::endl;
+	int result = 0;
+	if (replay.missingUnits_ > 0)
+	{
+		std::cout << replay.missingUnits_ << " commands named units that do not exist, replay diverged" << std::endl;
+		result = 1;
+	}
+	if (replay.hasChecksum_)
+	{
+		bool match = replay.checksum_ == worldChecksum(w);
+		std::cout << "Final state " << (match ? "matches" : "does not match") << " the recording" << std::endl;
+		if (!match) result = 1;
+	}
+	clearWorld(w);
+	SDL_FreeSurface(surface);
+	return result;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "main.h"
+#include "simulation.h"
+struct world;
+struct tile;
+
+/* Command log (.rtsl)
+"RTSL", version, seed, landmark count (0 for plain octile A*), Uint8 cooperative pathfinding, then a stream of records, each a one byte commandKind followed by its fields.
+The first record is a snapshot of the starting state. Every frame appears as
+	[commands issued by the human] cmdFrame(timer flags) [AI orders] cmdFrameEnd
+so a replay can apply each command at the same point of the frame it was issued in.
+*/
+const Uint32 commandLogVersion = 4;
+
+enum commandKind
+{
+	cmdCreatePlayer = 1, // Uint8 human, Sint32 row, Sint32 column
+	cmdNavigate = 2, // Sint32 unit id, Sint32 goal row, Sint32 goal column
+	cmdBuildFactory = 3, // Sint32 unit id, Uint8 factory type
+	cmdFrame = 4, // Uint8 timer flags
+	cmdFrameEnd = 5,
+	cmdSnapshot = 6, // Uint32 size, then a snapshot, whenever the match is (re)loaded
+	cmdEnd = 7 // Uint64 checksum of the final state
+};
+
+// Append-only recorder, records are buffered and written out in large chunks
+struct commandLog
+{
+	commandLog();
+	~commandLog();
+	bool open(const std::string& path, const world& w, Uint32 seed);
+	void createPlayer(bool human, int row, int column);
+	void navigate(int unitId, tile* goal);
+	void buildFactory(int unitId, int factoryType);
+	void frame(const tickFlags& flags);
+	void frameEnd();
+	void snapshot(const world& w);
+	void close(const world& w);
+	void flush();
+	std::ofstream out_;
+	std::vector<Uint8> buffer_;
+};
+
+// Reads a log back and feeds its commands into a world
+struct commandReplay
+{
+	commandReplay();
+	bool open(const std::string& path);
+	// Applies records up to the next frame marker, returns false once the log is done
+	bool beginFrame(world& w, tickFlags& flags);
+	// Applies the AI orders of the current frame, called by stepWorld in place of player::act
+	void applyOrders(world& w);
+	std::vector<Uint8> data_;
+	size_t offset_;
+	Uint32 seed_;
+	Uint32 landmarkCount_; // A* tie-breaking depends on the heuristic, so a replay has to search the same way
+	bool cooperative_;
+	bool hasChecksum_;
+	Uint64 checksum_;
+	int missingUnits_; // commands naming a unit that doesn't exist, nonzero means the replay diverged
+};
+
+// Re-simulates a recorded match as fast as possible without rendering
+int runReplay(const std::string& path);
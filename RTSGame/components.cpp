@@ -0,0 +1,185 @@
+#include "components.h"
+#include "world.h"
+#include "tile.h"
+
+static bool isPassable(const tile* tilePtr)
+{
+	return tilePtr->state_ != 1 && tilePtr->state_ != 3;
+}
+
+// Relabels every tile reachable from start that currently has label from, returns how many were relabeled.
+// Only labels are looked at, a tile whose state changed but hasn't been handled yet still counts as what it was.
+static int floodLabel(world& w, tile* start, int from, int to)
+{
+	std::vector<tile*>& stack = w.componentStack_;
+	stack.clear();
+	int maph = w.tiles_.size();
+	int mapw = w.tiles_[0].size();
+	start->component_ = to;
+	stack.push_back(start);
+	int count = 0;
+	while (stack.size() > 0)
+	{
+		tile* current = stack.back();
+		stack.pop_back();
+		count++;
+		for (int i = -1; i <= 1; i++)
+		{
+			for (int j = -1; j <= 1; j++)
+			{
+				int ni = current->y_ + i;
+				int nj = current->x_ + j;
+				if (ni < 0 || nj < 0 || ni >= maph || nj >= mapw) continue;
+				tile* neighbor = w.tiles_[ni][nj];
+				if (neighbor->component_ != from) continue;
+				neighbor->component_ = to;
+				stack.push_back(neighbor);
+			}
+		}
+	}
+	return count;
+}
+
+static int newComponent(world& w, int size)
+{
+	w.componentSizes_.push_back(size);
+	return w.componentSizes_.size() - 1;
+}
+
+void labelComponents(world& w)
+{
+	w.componentSizes_.clear();
+	// A chunk that is wall throughout is skipped a whole chunk row at a time, its shared tile is already labeled -1
+	for (auto& row : w.tiles_)
+	{
+		for (int c = 0; c < (int)row.size(); c++)
+		{
+			if (c % chunkSize == 0 && isImplicitWall(row[c]))
+			{
+				c += chunkSize - 1;
+				continue;
+			}
+			// -2 marks passable tiles not yet reached, so floodLabel can tell them apart from walls
+			row[c]->component_ = isPassable(row[c]) ? -2 : -1;
+		}
+	}
+	for (auto& row : w.tiles_)
+	{
+		for (int c = 0; c < (int)row.size(); c++)
+		{
+			if (c % chunkSize == 0 && isImplicitWall(row[c]))
+			{
+				c += chunkSize - 1;
+				continue;
+			}
+			if (row[c]->component_ != -2) continue;
+			int label = newComponent(w, 0);
+			w.componentSizes_[label] = floodLabel(w, row[c], -2, label);
+		}
+	}
+}
+
+// Labeled tiles around tilePtr, in ring order
+static int passableNeighbors(world& w, tile* tilePtr, tile* neighbors[8])
+{
+	static const int ringi[8] = { -1, -1, 0, 1, 1, 1, 0, -1 };
+	static const int ringj[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+	int maph = w.tiles_.size();
+	int mapw = w.tiles_[0].size();
+	int count = 0;
+	for (int k = 0; k < 8; k++)
+	{
+		int ni = tilePtr->y_ + ringi[k];
+		int nj = tilePtr->x_ + ringj[k];
+		if (ni < 0 || nj < 0 || ni >= maph || nj >= mapw) continue;
+		if (w.tiles_[ni][nj]->component_ >= 0) neighbors[count++] = w.tiles_[ni][nj];
+	}
+	return count;
+}
+
+static void onTileBlocked(world& w, tile* tilePtr)
+{
+	int old = tilePtr->component_;
+	tilePtr->component_ = -1;
+	if (old < 0) return;
+	w.componentSizes_[old]--;
+
+	// Group the remaining neighbors by adjacency to each other. If they all touch, going around the
+	// blocked tile is always possible and the component cannot have split, which is the common case.
+	tile* neighbors[8];
+	int count = passableNeighbors(w, tilePtr, neighbors);
+	int group[8];
+	for (int k = 0; k < count; k++) group[k] = k;
+	for (int a = 0; a < count; a++)
+	{
+		for (int b = a + 1; b < count; b++)
+		{
+			if (std::abs(neighbors[a]->x_ - neighbors[b]->x_) > 1 || std::abs(neighbors[a]->y_ - neighbors[b]->y_) > 1) continue;
+			int from = group[b];
+			for (int k = 0; k < count; k++)
+			{
+				if (group[k] == from) group[k] = group[a];
+			}
+		}
+	}
+	bool split = false;
+	for (int k = 1; k < count; k++)
+	{
+		if (group[k] != group[0]) split = true;
+	}
+	if (!split) return;
+
+	// Possible split: the group of the first neighbor keeps the old label, and every other group that
+	// hasn't been reached yet is flooded, from one of its neighbors, into a fresh label
+	bool flooded[8] = {};
+	for (int k = 1; k < count; k++)
+	{
+		if (group[k] == group[0] || flooded[group[k]]) continue;
+		flooded[group[k]] = true;
+		if (neighbors[k]->component_ != old) continue;
+		int label = newComponent(w, 0);
+		w.componentSizes_[label] = floodLabel(w, neighbors[k], old, label);
+		w.componentSizes_[old] -= w.componentSizes_[label];
+	}
+}
+
+static void onTileOpened(world& w, tile* tilePtr)
+{
+	if (!isPassable(tilePtr) || tilePtr->component_ >= 0) return;
+	tile* neighbors[8];
+	int count = passableNeighbors(w, tilePtr, neighbors);
+
+	// Join the largest neighboring component, and relabel every smaller one into it
+	int largest = -1;
+	for (int k = 0; k < count; k++)
+	{
+		int label = neighbors[k]->component_;
+		if (largest < 0 || w.componentSizes_[label] > w.componentSizes_[largest]) largest = label;
+	}
+	if (largest < 0)
+	{
+		tilePtr->component_ = newComponent(w, 1);
+		return;
+	}
+	tilePtr->component_ = largest;
+	w.componentSizes_[largest]++;
+	for (int k = 0; k < count; k++)
+	{
+		int label = neighbors[k]->component_;
+		if (label == largest) continue;
+		int moved = floodLabel(w, neighbors[k], label, largest);
+		w.componentSizes_[label] -= moved;
+		w.componentSizes_[largest] += moved;
+	}
+}
+
+void onTileChanged(world& w, tile* tilePtr)
+{
+	if (isPassable(tilePtr)) onTileOpened(w, tilePtr);
+	else onTileBlocked(w, tilePtr);
+}
+
+bool sameComponent(const tile* a, const tile* b)
+{
+	return a->component_ >= 0 && a->component_ == b->component_;
+}
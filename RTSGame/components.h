@@ -0,0 +1,15 @@
+#pragma once
+#include "main.h"
+struct world;
+struct tile;
+
+// Connected component labels: every tile a unit can stand on (not wall, not factory) carries the id of the
+// 8-connected region it belongs to in tile::component_, impassable tiles carry -1. Two tiles are mutually
+// reachable exactly when their labels match, ignoring other units which move out of the way eventually.
+
+// Labels the whole map, called whenever a map or snapshot is loaded
+void labelComponents(world& w);
+// Incremental update for a tile that became impassable (factory built) or passable (factory destroyed). Several
+// changed tiles may be handled one after the other, each one sees the others as they are labeled so far.
+void onTileChanged(world& w, tile* tilePtr);
+bool sameComponent(const tile* a, const tile* b);
@@ -0,0 +1,348 @@
+#include "coopnav.h"
+#include "world.h"
+#include "tile.h"
+#include "unit.h"
+#include "metrics.h"
+#include <climits>
+
+const int unreachableDistance = INT_MAX / 4;
+
+static Uint64 reservationKey(int tileIndex, int tick)
+{
+	return ((Uint64)(Uint32)tick << 32) | (Uint32)tileIndex;
+}
+
+static int tileIndex(const world& w, const tile* tilePtr)
+{
+	return tilePtr->y_ * w.tiles_[0].size() + tilePtr->x_;
+}
+
+static tile* tileAt(const world& w, int index)
+{
+	int width = w.tiles_[0].size();
+	return w.tiles_[index / width][index % width];
+}
+
+// Lower bound on the walking cost, as if all of it were on the cheapest terrain of the map
+static int octile(const world& w, int from, int to)
+{
+	return tileAt(w, from)->distTo(tileAt(w, to)) * w.cheapestWeight_ / 2;
+}
+
+coopState::coopState()
+{
+	unit_ = -1;
+	replan_ = false;
+}
+
+coopState* coopStateOf(world& w, int unitId)
+{
+	int* slot = w.coop_.slots_.find(unitId);
+	return slot == NULL ? NULL : &w.coop_.states_[*slot];
+}
+
+bool coopMoving(const world& w, int unitId)
+{
+	return w.coop_.slots_.contains(unitId);
+}
+
+tile* coopGoal(const world& w, int unitId)
+{
+	const int* slot = w.coop_.slots_.find(unitId);
+	return slot == NULL ? NULL : tileAt(w, w.coop_.states_[*slot].distance_.goal_);
+}
+
+trueDistance::trueDistance()
+{
+	goal_ = -1;
+	origin_ = -1;
+	search_ = 0;
+}
+
+static bool reached(const trueDistance& search, int index)
+{
+	return search.stamp_[index] >> 1 == search.search_;
+}
+
+static bool closed(const trueDistance& search, int index)
+{
+	return search.stamp_[index] == 2 * search.search_ + 1;
+}
+
+static void startDistance(const world& w, trueDistance& search, int goal, int origin)
+{
+	size_t tiles = w.tiles_.size() * w.tiles_[0].size();
+	// A new map, or numbers about to run out: every stamp goes back to unreached
+	if (search.stamp_.size() != tiles || search.search_ >= 0x7fffffff)
+	{
+		search.stamp_.assign(tiles, 0);
+		search.g_.resize(tiles);
+		search.search_ = 0;
+	}
+	search.search_++;
+	search.goal_ = goal;
+	search.origin_ = origin;
+	search.open_.clear();
+	search.stamp_[goal] = 2 * search.search_;
+	search.g_[goal] = 0;
+	search.open_.push(octile(w, goal, origin), goal);
+}
+
+// Walking distance from target to the goal, continuing the reverse search until target is closed
+static int resumeDistance(const world& w, trueDistance& search, int target)
+{
+	if (closed(search, target)) return search.g_[target];
+	int height = w.tiles_.size();
+	int width = w.tiles_[0].size();
+	while (search.open_.size() > 0)
+	{
+		int f;
+		int index = search.open_.pop(f);
+		if (closed(search, index)) continue;
+		search.stamp_[index] = 2 * search.search_ + 1;
+		int g = search.g_[index];
+		int r = index / width;
+		int c = index % width;
+		for (int i = -1; i <= 1; i++)
+		{
+			for (int j = -1; j <= 1; j++)
+			{
+				if (i == 0 && j == 0) continue;
+				int ni = r + i;
+				int nj = c + j;
+				if (ni < 0 || nj < 0 || ni >= height || nj >= width || !w.tiles_[ni][nj]->walkable()) continue;
+				int next = ni * width + nj;
+				int cost = g + w.tiles_[ni][nj]->stepCost(w.tiles_[r][c]);
+				if (reached(search, next) && search.g_[next] <= cost) continue;
+				search.stamp_[next] = 2 * search.search_;
+				search.g_[next] = cost;
+				search.open_.push(cost + octile(w, next, search.origin_), next);
+			}
+		}
+		if (index == target) return g;
+	}
+	return unreachableDistance;
+}
+
+static void releaseReservations(world& w, coopState& state)
+{
+	for (auto key : state.reserved_) w.coop_.reservations_.erase(key);
+	state.reserved_.clear();
+}
+
+static void reserve(world& w, coopState& state, Uint64 key)
+{
+	w.coop_.reservations_[key] = state.unit_;
+	state.reserved_.push_back(key);
+}
+
+static int reservedBy(const world& w, int index, int tick)
+{
+	const int* holder = w.coop_.reservations_.find(reservationKey(index, tick));
+	return holder == NULL ? -1 : *holder;
+}
+
+// Units without a plan stay where they are, so their tile is blocked at every tick
+static bool blockedByIdleUnit(const world& w, const tile* tilePtr, const unit* self)
+{
+	return tilePtr->unitAt_ != NULL && tilePtr->unitAt_ != self && !coopMoving(w, tilePtr->unitAt_->id_);
+}
+
+// Space-time A* over the next reservationWindow ticks, then reserves the result and puts it in path_
+static void planWindow(world& w, unit* unitPtr, coopState& state)
+{
+	releaseReservations(w, state);
+	// Counted as A* searches, it is the search moving units get when cooperative
+	Uint64 searchStart = SDL_GetPerformanceCounter();
+	Uint64 expanded = 0;
+	int width = w.tiles_[0].size();
+	int height = w.tiles_.size();
+	int start = tileIndex(w, unitPtr->tileAt_);
+	int goal = state.distance_.goal_;
+	int now = w.moveTick_;
+	int self = unitPtr->id_;
+	// Tick a node is reached at, the first one whose credit covers the cost walked so far, as unit::advance spends it
+	int credit = unitPtr->moveCredit_;
+	auto tickOf = [&](int g) { return g == 0 ? 0 : std::max(1, (g - credit + moveTickCredit - 1) / moveTickCredit); };
+	auto heldByOther = [&](int index, int tick) { int holder = reservedBy(w, index, tick); return holder >= 0 && holder != self; };
+	// Tiles the window can reach in any direction, walking on the cheapest terrain of the map the whole way
+	int reach = (credit + moveTickCredit * reservationWindow) / (10 * w.cheapestWeight_ / 2);
+	int span = 2 * reach + 1;
+
+	std::vector<windowNode>& nodes = w.coop_.nodes_;
+	bucketQueue<int>& open = w.coop_.open_;
+	std::vector<int>& bestG = w.coop_.bestG_;
+	nodes.clear();
+	open.clear();
+	bestG.assign(span * span * (reservationWindow + 1), INT_MAX);
+	windowNode first = { resumeDistance(w, state.distance_, start), 0, start, 0, -1 };
+	nodes.push_back(first);
+	open.push(first.f_, 0);
+	int end = -1;
+	while (open.size() > 0)
+	{
+		int f;
+		int current = open.pop(f);
+		windowNode node = nodes[current];
+		expanded++;
+		if (node.tick_ == reservationWindow || node.tile_ == goal)
+		{
+			end = current;
+			break;
+		}
+		int r = node.tile_ / width;
+		int c = node.tile_ % width;
+		for (int i = -1; i <= 1; i++)
+		{
+			for (int j = -1; j <= 1; j++)
+			{
+				int ni = r + i;
+				int nj = c + j;
+				int dy = ni - unitPtr->tileAt_->y_;
+				int dx = nj - unitPtr->tileAt_->x_;
+				if (ni < 0 || nj < 0 || ni >= height || nj >= width || std::abs(dy) > reach || std::abs(dx) > reach) continue;
+				tile* next = w.tiles_[ni][nj];
+				int nextIndex = ni * width + nj;
+				if (!next->walkable() || blockedByIdleUnit(w, next, unitPtr)) continue;
+				int g = node.g_ + (nextIndex == node.tile_ ? moveTickCredit : next->stepCost(w.tiles_[r][c]));
+				int tick = tickOf(g);
+				if (tick > reservationWindow || heldByOther(nextIndex, now + tick)) continue;
+				// Saving up for a dear step keeps the unit on its tile for the ticks in between
+				bool stays = true;
+				for (int t = node.tick_ + 1; t < tick && stays; t++) stays = !heldByOther(node.tile_, now + t);
+				if (!stays) continue;
+				// Two units swapping tiles would pass through each other
+				if (nextIndex != node.tile_)
+				{
+					int swapper = reservedBy(w, node.tile_, now + tick);
+					if (swapper >= 0 && swapper != self && reservedBy(w, nextIndex, now + tick - 1) == swapper) continue;
+				}
+				int h = resumeDistance(w, state.distance_, nextIndex);
+				if (h >= unreachableDistance) continue;
+				int offset = (dy + reach) * span + (dx + reach);
+				int& seen = bestG[offset * (reservationWindow + 1) + tick];
+				if (seen <= g) continue;
+				seen = g;
+				windowNode child = { g + h, g, nextIndex, tick, current };
+				nodes.push_back(child);
+				open.push(child.f_, nodes.size() - 1);
+			}
+		}
+	}
+
+	unitPtr->path_.clear();
+	state.replan_ = false;
+	countMetric(w.metrics_.astarCalls_);
+	countMetric(w.metrics_.astarNodes_, expanded);
+	countMetric(w.metrics_.astarTicks_, SDL_GetPerformanceCounter() - searchStart);
+	if (end < 0)
+	{
+		countMetric(w.metrics_.astarFailed_);
+		// Boxed in for now, stay put and try again next tick
+		Uint64 stay = reservationKey(start, now + 1);
+		if (!w.coop_.reservations_.contains(stay)) reserve(w, state, stay);
+		return;
+	}
+	std::vector<int>& steps = w.coop_.steps_;
+	steps.clear();
+	for (int n = end; n >= 0; n = nodes[n].parent_) steps.push_back(n);
+	// steps runs from the end of the plan back to the start, the order path_ keeps its steps in. A tile is held from
+	// the tick the unit gets there until the tick before it reaches the next one, or just that tick when passing through.
+	for (size_t k = 0; k < steps.size(); k++)
+	{
+		const windowNode& node = nodes[steps[k]];
+		int leave = k == 0 ? node.tick_ : std::max(node.tick_, nodes[steps[k - 1]].tick_ - 1);
+		for (int t = node.tick_; t <= leave; t++) reserve(w, state, reservationKey(node.tile_, now + t));
+		if (node.parent_ >= 0) unitPtr->path_.push_back(tileAt(w, node.tile_));
+	}
+	// Hold the last tile one tick longer, so nobody plans into it before this unit replans
+	Uint64 hold = reservationKey(nodes[end].tile_, now + nodes[end].tick_ + 1);
+	if (!w.coop_.reservations_.contains(hold)) reserve(w, state, hold);
+}
+
+void coopNavigate(world& w, unit* unitPtr, tile* goal)
+{
+	coopPlanner& coop = w.coop_;
+	int* slot = coop.slots_.find(unitPtr->id_);
+	if (slot == NULL)
+	{
+		if (coop.free_.size() == 0)
+		{
+			// The distance buffers are sized by the first search, a pooled state then only grows its open list
+			// past the largest one it has held
+			coopState fresh;
+			fresh.reserved_.reserve(windowPlanSteps + reservationWindow + 2);
+			coop.states_.push_back(std::move(fresh));
+			coop.free_.reserve(coop.states_.size());
+			coop.free_.push_back(coop.states_.size() - 1);
+		}
+		coop.slots_[unitPtr->id_] = coop.free_.back();
+		coop.free_.pop_back();
+		slot = coop.slots_.find(unitPtr->id_);
+		coop.states_[*slot].unit_ = unitPtr->id_;
+		coop.states_[*slot].replan_ = false;
+	}
+	coopState& state = coop.states_[*slot];
+	startDistance(w, state.distance_, tileIndex(w, goal), tileIndex(w, unitPtr->tileAt_));
+	planWindow(w, unitPtr, state);
+}
+
+void coopForget(world& w, unit* unitPtr)
+{
+	coopPlanner& coop = w.coop_;
+	int* slot = coop.slots_.find(unitPtr->id_);
+	if (slot == NULL) return;
+	int index = *slot;
+	releaseReservations(w, coop.states_[index]);
+	coop.states_[index].unit_ = -1;
+	coop.free_.push_back(index);
+	coop.slots_.erase(unitPtr->id_);
+}
+
+void coopReplan(world& w)
+{
+	for (auto unitPtr : w.units_)
+	{
+		coopState* state = coopStateOf(w, unitPtr->id_);
+		if (state == NULL) continue;
+		if (tileIndex(w, unitPtr->tileAt_) == state->distance_.goal_ && unitPtr->path_.size() == 0)
+		{
+			// Arrived, from now on an obstacle like any other idle unit
+			coopForget(w, unitPtr);
+			continue;
+		}
+		if (state->replan_ || unitPtr->path_.size() <= reservationWindow / 2) planWindow(w, unitPtr, *state);
+	}
+}
+
+void coopCopy(const coopPlanner& src, coopPlanner& dst)
+{
+	dst.reservations_.assign(src.reservations_);
+	dst.slots_.assign(src.slots_);
+	if (dst.states_.size() < src.states_.size()) dst.states_.resize(src.states_.size());
+	for (size_t i = 0; i < src.states_.size(); i++) dst.states_[i] = src.states_[i];
+	// The extra states go under the free slots of src, so the copy hands out slots in the same order src would,
+	// and only reaches for them once src would have had to create new states
+	dst.free_.clear();
+	for (size_t i = dst.states_.size(); i-- > src.states_.size(); )
+	{
+		dst.states_[i].unit_ = -1;
+		dst.states_[i].reserved_.clear();
+		dst.free_.push_back(i);
+	}
+	dst.free_.insert(dst.free_.end(), src.free_.begin(), src.free_.end());
+}
+
+void coopReset(world& w)
+{
+	coopPlanner& coop = w.coop_;
+	coop.reservations_.clear();
+	coop.slots_.clear();
+	coop.free_.clear();
+	for (int i = coop.states_.size() - 1; i >= 0; i--)
+	{
+		coop.states_[i].unit_ = -1;
+		coop.states_[i].reserved_.clear();
+		coop.free_.push_back(i);
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "main.h"
+#include "flatmap.h"
+#include "bucketqueue.h"
+struct world;
+struct unit;
+struct tile;
+
+/* Cooperative pathfinding (windowed hierarchical cooperative A*)
+Time is counted in move ticks, world::moveTick_ being the number that have passed. A moving unit plans only its next
+reservationWindow ticks, through space and time, around the tile-ticks other units have reserved, waiting in place
+when that is cheaper than a detour. A step takes as long as unit::advance needs to save up its cost, so the tick a
+plan reaches a tile follows from the cost walked so far and the unit's credit when it planned: slow ground holds a
+unit on its tile for longer and a tick on road covers more than one tile. It then reserves every tile-tick of its
+plan and replans once half of it is used.
+The heuristic is the true walking distance to the goal ignoring units, from a reverse search that is resumed on demand
+instead of being rerun. Units standing still hold no reservations and are simply treated as obstacles.
+Everything is stored as tile indices and unit ids, so a world copy can copy it as is.
+*/
+const int reservationWindow = 8;
+// Most steps one window plan holds: a tick on road covers two steps and a unit may start with some credit left
+const int windowPlanSteps = 3 * (reservationWindow + 1);
+// Reverse resumable A* from a unit's goal toward the unit, gives exact distances to the goal. Its g values live in
+// tile-indexed buffers kept by the pooled state, so a search can always run to completion and never falls back to a
+// distance that ignores walls. That costs 8 bytes per map tile for each unit moving at once (512 KB on a 256x256
+// map), allocated once per pooled state, and a world copy copies them.
+struct trueDistance
+{
+	trueDistance();
+	int goal_;
+	int origin_;
+	Uint32 search_; // numbers the searches run with this state, see stamp_
+	std::vector<Uint32> stamp_; // per tile: 2 * search_ once reached by the current search, 2 * search_ + 1 once closed
+	std::vector<int> g_; // per tile, only meaningful where stamp_ is of the current search
+	bucketQueue<int> open_; // tile indices by f
+};
+
+struct coopState
+{
+	coopState();
+	int unit_; // id of the unit planning with this state, -1 while the slot is free
+	trueDistance distance_;
+	std::vector<Uint64> reserved_; // keys this unit holds in the reservation table
+	bool replan_; // the plan no longer matches what happened, replan on the next move tick
+};
+
+struct windowNode
+{
+	int f_;
+	int g_; // cost walked since the start, waits included at moveTickCredit each
+	int tile_;
+	int tick_; // move ticks after the start at which the unit gets here
+	int parent_; // index into the node list, -1 for the start
+};
+
+// Everything cooperative movement keeps on the world. States are pooled and keep their memory when a unit
+// arrives or dies, so planning doesn't allocate once the pool has grown to the number of units moving at once.
+struct coopPlanner
+{
+	flatMap<int> reservations_; // (move tick, tile index) to the id of the unit that will be there
+	flatMap<int> slots_; // unit id to its index in states_
+	std::vector<coopState> states_;
+	std::vector<int> free_; // unused indices into states_
+	// Window search scratch
+	std::vector<windowNode> nodes_;
+	bucketQueue<int> open_; // node indices by f
+	std::vector<int> bestG_; // cheapest g per (offset from the start, tick)
+	std::vector<int> steps_;
+};
+
+// The plan of a unit that is moving cooperatively, NULL for every other unit
+coopState* coopStateOf(world& w, int unitId);
+bool coopMoving(const world& w, int unitId);
+// Where a cooperatively moving unit is headed, NULL for every other unit. path_ only holds its current window.
+tile* coopGoal(const world& w, int unitId);
+// Plans a cooperative route for unitPtr, used by unit::navigate when world::cooperative_ is set
+void coopNavigate(world& w, unit* unitPtr, tile* goal);
+// Drops a unit's plan and reservations, when it dies or gets a plan of a different kind
+void coopForget(world& w, unit* unitPtr);
+// Called on every move tick before units advance: replans every unit that used up half its window or got stuck
+void coopReplan(world& w);
+// Drops every plan and reservation, keeping the memory, for a world being cleared
+void coopReset(world& w);
+// Makes dst hold the plans of src. States dst pooled beyond those of src stay around as free slots, handed out
+// only once the free slots of src are used up.
+void coopCopy(const coopPlanner& src, coopPlanner& dst);
@@ -1,7 +1,8 @@
 #include "drawmap.h"
 #include "player.h"
+#include "mapfile.h"
 
-void drawMap(SDL_Surface* winSurface, SDL_Window* window, std::vector<std::vector<tile*>> &tiles, std::list<unit*>& units, std::vector<player*>& players)
+void drawMap(SDL_Surface* winSurface, SDL_Window* window, std::vector<std::vector<tile*>> &tiles, std::list<unit*>& units, std::vector<player*>& players, const player* viewer)
 {
 	SDL_Rect drawRect;
 	drawRect.h = tilesize;
@@ -14,7 +15,23 @@ void drawMap(SDL_Surface* winSurface, SDL_Window* window, std::vector<std::vecto
 			//std::cout << "Attempting to draw tile x=" << i << " y=" << j << std::endl;
 			drawRect.x = i * tilesize;
 			drawRect.y = j * tilesize;
-			SDL_FillRect(winSurface, &drawRect, tiles[j][i]->getColor(*winSurface));
+			// Unexplored ground is black, explored ground out of sight is drawn at half brightness
+			if (viewer != NULL && !isExploredAt(viewer, j, i))
+			{
+				SDL_FillRect(winSurface, &drawRect, SDL_MapRGB(winSurface->format, 0, 0, 0));
+				continue;
+			}
+			bool inSight = viewer == NULL || isVisibleAt(viewer, j, i);
+			Uint32 color = tiles[j][i]->getColor(*winSurface);
+			if (!inSight)
+			{
+				Uint8 red;
+				Uint8 green;
+				Uint8 blue;
+				SDL_GetRGB(color, winSurface->format, &red, &green, &blue);
+				color = SDL_MapRGB(winSurface->format, red / 2, green / 2, blue / 2);
+			}
+			SDL_FillRect(winSurface, &drawRect, color);
 			switch (tiles[j][i]->factoryType) 
 			{
 			case(0): // Main Unit Factory
@@ -70,51 +87,37 @@ void drawMap(SDL_Surface* winSurface, SDL_Window* window, std::vector<std::vecto
 				drawRect.w = tilesize;
 			}
 			*/
+		}
+	}
 
-			// Render units
-			// Optimization note: This searches every single unit for every single tile (redundant)
-			// Optimize by having each tile know whether or not there's a unit on it, and checking that and the corresponding unit
-			for (auto unitPtr : units)
-			{
-				if (unitPtr->tileAt_->x_ == i && unitPtr->tileAt_->y_ == j)
-				{
-					drawRect.h -= 10;
-					drawRect.w -= 10;
-					drawRect.x += 5;
-					drawRect.y += 5;
-					SDL_FillRect(winSurface, &drawRect, unitPtr->team_->color_);
-					switch (unitPtr->type_)
-					{
-					case(0): // Main Unit
-						break;
-					case(1): // Fighter
-						drawRect.h = 15;
-						drawRect.w = 3;
-						drawRect.x += 6;
-						SDL_FillRect(winSurface, &drawRect, SDL_MapRGB(winSurface->format, 0, 255, 0));
-						drawRect.h = 3;
-						drawRect.w = 15;
-						drawRect.x -= 6;
-						drawRect.y += 6;
-						SDL_FillRect(winSurface, &drawRect, SDL_MapRGB(winSurface->format, 0, 255, 0));
-						break;
-					case(2): // Builder
-						drawRect.h = 15;
-						drawRect.w = 3;
-						drawRect.x += 6;
-						SDL_FillRect(winSurface, &drawRect, SDL_MapRGB(winSurface->format, 0, 255, 0));
-					case(3): // Miner
-						drawRect.h -= 8;
-						drawRect.w -= 8;
-						drawRect.x += 4;
-						drawRect.y += 4;
-						SDL_FillRect(winSurface, &drawRect, SDL_MapRGB(winSurface->format, 0, 255, 0));
-						break;
-					}
-					drawRect.h = tilesize;
-					drawRect.w = tilesize;
-				}
-			}
+	// Render units, in one pass over the list instead of searching it on every tile
+	for (auto unitPtr : units)
+	{
+		int i = unitPtr->tileAt_->x_;
+		int j = unitPtr->tileAt_->y_;
+		if (viewer != NULL && !isExploredAt(viewer, j, i)) continue;
+		if (viewer != NULL && unitPtr->team_ != viewer && !isVisibleAt(viewer, j, i)) continue;
+		drawRect.x = i * tilesize + 5;
+		drawRect.y = j * tilesize + 5;
+		drawRect.h = tilesize - 10;
+		drawRect.w = tilesize - 10;
+		SDL_FillRect(winSurface, &drawRect, unitPtr->team_->color_);
+		int glyph = unitArchetypes[unitPtr->type_].glyph_;
+		Uint32 glyphColor = SDL_MapRGB(winSurface->format, 0, 255, 0);
+		if (glyph & glyphVerticalBar)
+		{
+			SDL_Rect stroke = { drawRect.x + 6, drawRect.y, 3, 15 };
+			SDL_FillRect(winSurface, &stroke, glyphColor);
+		}
+		if (glyph & glyphHorizontalBar)
+		{
+			SDL_Rect stroke = { drawRect.x, drawRect.y + 6, 15, 3 };
+			SDL_FillRect(winSurface, &stroke, glyphColor);
+		}
+		if (glyph & glyphSquare)
+		{
+			SDL_Rect stroke = { drawRect.x + 4, drawRect.y + 4, drawRect.w - 8, drawRect.h - 8 };
+			SDL_FillRect(winSurface, &stroke, glyphColor);
 		}
 	}
 	// Start resource bars at corner of border corner tile
@@ -138,42 +141,18 @@ void drawMap(SDL_Surface* winSurface, SDL_Window* window, std::vector<std::vecto
 		drawRect.y += 14 + 12; // 14 px down to corner of current bar, 12 px gap between bars
 	}
 
-	SDL_UpdateWindowSurface(window);
+	if (window != NULL) SDL_UpdateWindowSurface(window); // NULL when drawing off-screen
 	//std::cout << "Attempted update to window surface" << std::endl;
 }
 void initMap(std::vector<std::vector<tile*>> &tiles, bool skiptarg, bool skipstart)
 {
-	tiles.clear();
-	std::ifstream map("map.txt");
-	std::string buffer;
-	int column = 0;
-	int rowIndex = 0;
-	while (getline(map, buffer))
-	{
-		//std::cout << "reading line..." << std::endl;
-		//std::cout << buffer << std::endl;
-		std::vector<tile*> row;
-		row.clear();
-		for (char ch : buffer)
-		{
-			int state = ch - '0';
-			// if (skiptarg && state == 3) { state = 0; }	deprecated
-			// if (skipstart && state == 2) { state = 0; }	deprecated
-			row.push_back(new tile(state, column, rowIndex));
-			column++;
-		}
-		tiles.push_back(row);
-		column = 0;
-		rowIndex++;
-	}
-
-	for (int i = 0; i < tiles.size(); i++)
+	// if (skiptarg && state == 3) { state = 0; }	deprecated
+	// if (skipstart && state == 2) { state = 0; }	deprecated
+	if (!loadMap("map.txt", tiles))
 	{
-		for (int j = 0; j < tiles[0].size(); j++)
-		{
-			tiles[i][j]->x_ = j;
-			tiles[i][j]->y_ = i;
-		}
+		std::cout << "Error: could not load map.txt" << std::endl;
+		std::system("pause");
+		exit(1);
 	}
 	//std::cout << "read map with height " << tiles.size() << std::endl;
 	//std::cout << "read map with width "<< tiles[0].size() << std::endl;
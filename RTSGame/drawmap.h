@@ -4,6 +4,7 @@
 #include "tile.h"
 struct unit;
 struct player;
-void drawMap(SDL_Surface* winSurface, SDL_Window* window, std::vector<std::vector<tile*>> &tiles, std::list<unit*>& units, std::vector<player*> &players);
+// viewer, when not NULL, only sees what its fog of war lets it see. window may be NULL to draw into an off-screen surface.
+void drawMap(SDL_Surface* winSurface, SDL_Window* window, std::vector<std::vector<tile*>> &tiles, std::list<unit*>& units, std::vector<player*> &players, const player* viewer = NULL);
 void initMap(std::vector<std::vector<tile*>> &tiles, bool skiptarg, bool skipstart);
 std::vector<int> getNode(std::vector<std::vector<tile>>& tiles, int state);
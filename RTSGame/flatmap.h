@@ -0,0 +1,159 @@
+#pragma once
+#include "main.h"
+
+/* Open addressing hash map from Uint64 keys, for tables that are refilled every tick
+clear() keeps the memory, so once a table has been as full as it gets it never allocates again, unlike
+std::unordered_map which allocates a node per insert. Linear probing, erase shifts later entries back instead of
+leaving tombstones. flatMapEmpty is reserved and can't be used as a key.
+*/
+const Uint64 flatMapEmpty = ~0ull;
+
+template <typename Value>
+struct flatMap
+{
+	flatMap()
+	{
+		size_ = 0;
+	}
+
+	Value* find(Uint64 key)
+	{
+		if (size_ == 0) return NULL;
+		for (size_t slot = home(key); ; slot = (slot + 1) & mask())
+		{
+			if (keys_[slot] == key) return &values_[slot];
+			if (keys_[slot] == flatMapEmpty) return NULL;
+		}
+	}
+
+	const Value* find(Uint64 key) const
+	{
+		return const_cast<flatMap*>(this)->find(key);
+	}
+
+	bool contains(Uint64 key) const
+	{
+		return find(key) != NULL;
+	}
+
+	// Inserts a default value if key is missing
+	Value& operator[](Uint64 key)
+	{
+		// At most half full keeps probe runs short
+		if ((size_ + 1) * 2 > keys_.size()) grow();
+		size_t slot = home(key);
+		while (keys_[slot] != flatMapEmpty && keys_[slot] != key) slot = (slot + 1) & mask();
+		if (keys_[slot] == flatMapEmpty)
+		{
+			keys_[slot] = key;
+			values_[slot] = Value();
+			size_++;
+		}
+		return values_[slot];
+	}
+
+	bool erase(Uint64 key)
+	{
+		if (size_ == 0) return false;
+		size_t slot = home(key);
+		while (keys_[slot] != key)
+		{
+			if (keys_[slot] == flatMapEmpty) return false;
+			slot = (slot + 1) & mask();
+		}
+		// Move back every following entry whose home lies at or before the hole
+		size_t hole = slot;
+		for (size_t next = (hole + 1) & mask(); keys_[next] != flatMapEmpty; next = (next + 1) & mask())
+		{
+			size_t wanted = home(keys_[next]);
+			if (((next - wanted) & mask()) >= ((next - hole) & mask()))
+			{
+				keys_[hole] = keys_[next];
+				values_[hole] = values_[next];
+				hole = next;
+			}
+		}
+		keys_[hole] = flatMapEmpty;
+		size_--;
+		return true;
+	}
+
+	// Makes room for count entries up front, so filling the table that far never allocates
+	void reserve(size_t count)
+	{
+		if (count * 2 <= keys_.size()) return;
+		size_t capacity = 16;
+		while (capacity < count * 2) capacity *= 2;
+		rehash(capacity);
+	}
+
+	// Like operator=, but refills this table in place when it is already as large as other's
+	void assign(const flatMap& other)
+	{
+		if (keys_.size() < other.keys_.size())
+		{
+			*this = other;
+			return;
+		}
+		clear();
+		other.forEach([this](Uint64 key, const Value& value) { (*this)[key] = value; });
+	}
+
+	void clear()
+	{
+		if (size_ == 0) return;
+		std::fill(keys_.begin(), keys_.end(), flatMapEmpty);
+		size_ = 0;
+	}
+
+	size_t size() const
+	{
+		return size_;
+	}
+
+	// Calls visit(key, value) for every entry, in no particular order
+	template <typename Visit>
+	void forEach(Visit visit) const
+	{
+		if (size_ == 0) return;
+		for (size_t slot = 0; slot < keys_.size(); slot++)
+		{
+			if (keys_[slot] != flatMapEmpty) visit(keys_[slot], values_[slot]);
+		}
+	}
+
+	std::vector<Uint64> keys_;
+	std::vector<Value> values_;
+	size_t size_;
+
+	size_t mask() const
+	{
+		return keys_.size() - 1;
+	}
+
+	size_t home(Uint64 key) const
+	{
+		Uint64 hash = key * 0x9E3779B97F4A7C15ull;
+		return (size_t)(hash ^ (hash >> 32)) & mask();
+	}
+
+	void grow()
+	{
+		rehash(std::max((size_t)16, keys_.size() * 2));
+	}
+
+	void rehash(size_t capacity)
+	{
+		std::vector<Uint64> oldKeys;
+		std::vector<Value> oldValues;
+		oldKeys.swap(keys_);
+		oldValues.swap(values_);
+		keys_.assign(capacity, flatMapEmpty);
+		values_.resize(keys_.size());
+		size_ = 0;
+		for (size_t slot = 0; slot < oldKeys.size(); slot++)
+		{
+			if (oldKeys[slot] != flatMapEmpty) (*this)[oldKeys[slot]] = oldValues[slot];
+		}
+	}
+};
@@ -0,0 +1,193 @@
+#include "fog.h"
+#include "world.h"
+#include "tile.h"
+#include "unit.h"
+#include "player.h"
+
+playerFog::playerFog()
+{
+	wordsPerRow_ = 0;
+	dirty_ = true;
+}
+
+static bool blocksSight(const world& w, int x, int y)
+{
+	return x < 0 || y < 0 || y >= (int)w.tiles_.size() || x >= (int)w.tiles_[0].size() || w.tiles_[y][x]->state_ == 1;
+}
+
+// Recursive shadowcasting over one octant, xx/xy/yx/yy map octant coordinates onto the map
+static void castLight(const world& w, int cx, int cy, int row, float start, float end, int xx, int xy, int yx, int yy, Uint64* fov)
+{
+	if (start < end) return;
+	float newStart = 0.0f;
+	for (int j = row; j <= sightRadius; j++)
+	{
+		int dx = -j - 1;
+		int dy = -j;
+		bool blocked = false;
+		while (dx <= 0)
+		{
+			dx++;
+			int x = cx + dx * xx + dy * xy;
+			int y = cy + dx * yx + dy * yy;
+			float leftSlope = (dx - 0.5f) / (dy + 0.5f);
+			float rightSlope = (dx + 0.5f) / (dy - 0.5f);
+			if (start < rightSlope) continue;
+			if (end > leftSlope) break;
+			bool wall = blocksSight(w, x, y);
+			if (dx * dx + dy * dy <= sightRadius * sightRadius && x >= 0 && y >= 0 && y < (int)w.tiles_.size() && x < (int)w.tiles_[0].size())
+			{
+				fov[y - cy + sightRadius] |= 1ull << (x - cx + sightRadius);
+			}
+			if (blocked)
+			{
+				if (wall)
+				{
+					newStart = rightSlope;
+					continue;
+				}
+				blocked = false;
+				start = newStart;
+			}
+			else if (wall && j < sightRadius)
+			{
+				blocked = true;
+				castLight(w, cx, cy, j + 1, start, leftSlope, xx, xy, yx, yy, fov);
+				newStart = rightSlope;
+			}
+		}
+		if (blocked) break;
+	}
+}
+
+static void computeFov(const world& w, unit* unitPtr)
+{
+	static const int multipliers[4][8] =
+	{
+		{ 1, 0, 0, -1, -1, 0, 0, 1 },
+		{ 0, 1, -1, 0, 0, -1, 1, 0 },
+		{ 0, 1, 1, 0, 0, -1, -1, 0 },
+		{ 1, 0, 0, 1, -1, 0, 0, -1 }
+	};
+	int cx = unitPtr->tileAt_->x_;
+	int cy = unitPtr->tileAt_->y_;
+	for (int i = 0; i < sightSpan; i++) unitPtr->fov_[i] = 0;
+	unitPtr->fov_[sightRadius] = 1ull << sightRadius;
+	for (int octant = 0; octant < 8; octant++)
+	{
+		castLight(w, cx, cy, 1, 1.0f, 0.0f, multipliers[0][octant], multipliers[1][octant], multipliers[2][octant], multipliers[3][octant], unitPtr->fov_);
+	}
+	unitPtr->fovAt_ = unitPtr->tileAt_;
+}
+
+// ORs one unit's masks into its team's visible rows
+static void unionFov(playerFog& fog, const unit* unitPtr, int height)
+{
+	int cx = unitPtr->fovAt_->x_;
+	int cy = unitPtr->fovAt_->y_;
+	for (int i = 0; i < sightSpan; i++)
+	{
+		Uint64 mask = unitPtr->fov_[i];
+		int y = cy - sightRadius + i;
+		if (mask == 0 || y < 0 || y >= height) continue;
+		int column = cx - sightRadius;
+		if (column < 0)
+		{
+			// Bits left of the map were never set, shift them out
+			mask >>= -column;
+			column = 0;
+		}
+		Uint64* row = &fog.visible_[(size_t)y * fog.wordsPerRow_];
+		int word = column / 64;
+		int offset = column % 64;
+		row[word] |= mask << offset;
+		if (offset > 0 && word + 1 < fog.wordsPerRow_) row[word + 1] |= mask >> (64 - offset);
+		fog.rowTouched_[y] = 1;
+	}
+}
+
+void updateFog(world& w)
+{
+	int height = w.tiles_.size();
+	if (height == 0) return;
+	int wordsPerRow = (w.tiles_[0].size() + 63) / 64;
+	for (auto playerPtr : w.players_)
+	{
+		playerFog& fog = playerPtr->fog_;
+		if (fog.wordsPerRow_ != wordsPerRow || (int)fog.rowTouched_.size() != height)
+		{
+			fog.wordsPerRow_ = wordsPerRow;
+			fog.visible_.assign((size_t)wordsPerRow * height, 0);
+			fog.explored_.assign((size_t)wordsPerRow * height, 0);
+			fog.rowTouched_.assign(height, 0);
+			fog.dirty_ = true;
+		}
+	}
+	for (auto unitPtr : w.units_)
+	{
+		if (unitPtr->fovAt_ == unitPtr->tileAt_) continue;
+		computeFov(w, unitPtr);
+		unitPtr->team_->fog_.dirty_ = true;
+	}
+	for (auto playerPtr : w.players_)
+	{
+		playerFog& fog = playerPtr->fog_;
+		if (!fog.dirty_) continue;
+		for (int y = 0; y < height; y++)
+		{
+			if (!fog.rowTouched_[y]) continue;
+			std::fill(fog.visible_.begin() + (size_t)y * wordsPerRow, fog.visible_.begin() + (size_t)(y + 1) * wordsPerRow, 0);
+			fog.rowTouched_[y] = 0;
+		}
+		for (auto unitPtr : playerPtr->units_) unionFov(fog, unitPtr, height);
+		for (int y = 0; y < height; y++)
+		{
+			if (!fog.rowTouched_[y]) continue;
+			Uint64* explored = &fog.explored_[(size_t)y * wordsPerRow];
+			const Uint64* visible = &fog.visible_[(size_t)y * wordsPerRow];
+			for (int word = 0; word < wordsPerRow; word++) explored[word] |= visible[word];
+		}
+		fog.dirty_ = false;
+	}
+}
+
+static bool testBit(const playerFog& fog, const std::vector<Uint64>& bits, int row, int column)
+{
+	// Before the first update everything counts as seen, so freshly created players aren't blind for a frame
+	if (fog.wordsPerRow_ == 0) return true;
+	return (bits[(size_t)row * fog.wordsPerRow_ + column / 64] >> (column % 64)) & 1;
+}
+
+bool isVisible(const player* playerPtr, const tile* tilePtr)
+{
+	return testBit(playerPtr->fog_, playerPtr->fog_.visible_, tilePtr->y_, tilePtr->x_);
+}
+
+bool isExplored(const player* playerPtr, const tile* tilePtr)
+{
+	return testBit(playerPtr->fog_, playerPtr->fog_.explored_, tilePtr->y_, tilePtr->x_);
+}
+
+bool isVisibleAt(const player* playerPtr, int row, int column)
+{
+	return testBit(playerPtr->fog_, playerPtr->fog_.visible_, row, column);
+}
+
+bool isExploredAt(const player* playerPtr, int row, int column)
+{
+	return testBit(playerPtr->fog_, playerPtr->fog_.explored_, row, column);
+}
+
+bool onFrontier(const world& w, const player* playerPtr, const tile* tilePtr)
+{
+	static const int offsets[4][2] = { { -1, 0 }, { 0, -1 }, { 0, 1 }, { 1, 0 } };
+	if (!isExplored(playerPtr, tilePtr)) return false;
+	for (auto& offset : offsets)
+	{
+		int r = tilePtr->y_ + offset[0];
+		int c = tilePtr->x_ + offset[1];
+		if (r < 0 || c < 0 || r >= (int)w.tiles_.size() || c >= (int)w.tiles_[0].size()) continue;
+		if (!isExploredAt(playerPtr, r, c)) return true;
+	}
+	return false;
+}
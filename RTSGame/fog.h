@@ -0,0 +1,35 @@
+#pragma once
+#include "main.h"
+struct world;
+struct player;
+struct unit;
+struct tile;
+
+/* Fog of war
+Each player has a visible and an explored bitset over the map, one bit per tile, rows padded to whole 64-bit words.
+Each unit caches its own field of view as one 64-bit mask per row of its sight square, recomputed by shadowcasting
+only when it moves. Walls block sight, factories and units don't. Once per frame a player whose units moved, spawned
+or died ORs its units' masks into a cleared visible set, touching only the rows they cover, and ORs that into explored.
+*/
+const int sightRadius = 7;
+const int sightSpan = 2 * sightRadius + 1; // must fit in 64 bits
+
+struct playerFog
+{
+	playerFog();
+	int wordsPerRow_;
+	std::vector<Uint64> visible_;
+	std::vector<Uint64> explored_;
+	std::vector<Uint8> rowTouched_; // rows with any visible bit, the only ones that need clearing
+	bool dirty_; // a unit of this player moved, spawned or died since the last update
+};
+
+// Brings every unit's field of view and every player's visibility up to date, once per frame
+void updateFog(world& w);
+bool isVisible(const player* playerPtr, const tile* tilePtr);
+bool isExplored(const player* playerPtr, const tile* tilePtr);
+// By position, for tiles that may be wall, see implicitWall
+bool isVisibleAt(const player* playerPtr, int row, int column);
+bool isExploredAt(const player* playerPtr, int row, int column);
+// Explored tile with an unexplored tile next to it, where a unit has to go to see more of the map
+bool onFrontier(const world& w, const player* playerPtr, const tile* tilePtr);
@@ -0,0 +1,181 @@
+#include "influence.h"
+#include "world.h"
+#include "tile.h"
+#include "unit.h"
+#include "player.h"
+
+// How much of last tick's field survives each spread
+const float influenceDecay = 0.5f;
+
+influenceMaps::influenceMaps()
+{
+	width_ = 0;
+	height_ = 0;
+}
+
+static float unitWeight(const unit* unitPtr)
+{
+	return unitArchetypes[unitPtr->type_].threat_;
+}
+
+static int cellOf(const influenceMaps& maps, const tile* tilePtr)
+{
+	return (tilePtr->y_ / influenceCellSize) * maps.width_ + tilePtr->x_ / influenceCellSize;
+}
+
+// Player layers are sized lazily, players can join after the map was loaded
+static playerInfluence& layersOf(world& w, player* playerPtr)
+{
+	playerInfluence& layers = playerPtr->influence_;
+	size_t cells = w.influence_.units_.size();
+	if (layers.units_.size() != cells)
+	{
+		layers.units_.assign(cells, 0.0f);
+		layers.factories_.assign(cells, 0.0f);
+		layers.pressure_.assign(cells, 0.0f);
+		layers.coverage_.assign(cells, 0.0f);
+	}
+	return layers;
+}
+
+void rebuildInfluence(world& w, const std::vector<Uint32>* resourceTiles)
+{
+	influenceMaps& maps = w.influence_;
+	int height = w.tiles_.size();
+	int width = height > 0 ? w.tiles_[0].size() : 0;
+	maps.width_ = (width + influenceCellSize - 1) / influenceCellSize;
+	maps.height_ = (height + influenceCellSize - 1) / influenceCellSize;
+	size_t cells = (size_t)maps.width_ * maps.height_;
+	maps.units_.assign(cells, 0.0f);
+	maps.resources_.assign(cells, 0.0f);
+	maps.resourceField_.assign(cells, 0.0f);
+	maps.scratch_.assign(cells, 0.0f);
+	for (auto playerPtr : w.players_) playerPtr->influence_.units_.clear();
+	for (auto playerPtr : w.players_) layersOf(w, playerPtr);
+
+	if (resourceTiles != NULL)
+	{
+		for (auto index : *resourceTiles) maps.resources_[cellOf(maps, w.tiles_[index / width][index % width])] += 1.0f;
+	}
+	else
+	{
+		for (auto& row : w.tiles_)
+		{
+			for (auto tilePtr : row)
+			{
+				if (tilePtr->state_ == 2) maps.resources_[cellOf(maps, tilePtr)] += 1.0f;
+				if (tilePtr->state_ == 3 && tilePtr->claimedBy_ != NULL) layersOf(w, tilePtr->claimedBy_).factories_[cellOf(maps, tilePtr)] += 1.0f;
+			}
+		}
+	}
+	for (auto unitPtr : w.units_) influenceUnitAdded(w, unitPtr);
+}
+
+void influenceUnitAdded(world& w, unit* unitPtr)
+{
+	influenceMaps& maps = w.influence_;
+	int cell = cellOf(maps, unitPtr->tileAt_);
+	float weight = unitWeight(unitPtr);
+	maps.units_[cell] += weight;
+	layersOf(w, unitPtr->team_).units_[cell] += weight;
+	if (unitPtr->tileAt_->state_ == 2) maps.resources_[cell] -= 1.0f;
+}
+
+void influenceUnitRemoved(world& w, unit* unitPtr)
+{
+	influenceMaps& maps = w.influence_;
+	int cell = cellOf(maps, unitPtr->tileAt_);
+	float weight = unitWeight(unitPtr);
+	maps.units_[cell] -= weight;
+	layersOf(w, unitPtr->team_).units_[cell] -= weight;
+	if (unitPtr->tileAt_->state_ == 2) maps.resources_[cell] += 1.0f;
+}
+
+void influenceUnitMoved(world& w, unit* unitPtr, tile* from)
+{
+	influenceMaps& maps = w.influence_;
+	int oldCell = cellOf(maps, from);
+	int newCell = cellOf(maps, unitPtr->tileAt_);
+	if (from->state_ == 2) maps.resources_[oldCell] += 1.0f;
+	if (unitPtr->tileAt_->state_ == 2) maps.resources_[newCell] -= 1.0f;
+	if (oldCell == newCell) return;
+	float weight = unitWeight(unitPtr);
+	playerInfluence& layers = layersOf(w, unitPtr->team_);
+	maps.units_[oldCell] -= weight;
+	maps.units_[newCell] += weight;
+	layers.units_[oldCell] -= weight;
+	layers.units_[newCell] += weight;
+}
+
+void influenceFactoryChanged(world& w, tile* factoryPtr, player* owner, bool built)
+{
+	if (owner == NULL) return;
+	layersOf(w, owner).factories_[cellOf(w.influence_, factoryPtr)] += built ? 1.0f : -1.0f;
+}
+
+// field = decay * blur(field) + (source - exclude), blur being a separable 1-2-1 kernel with clamped edges.
+// The inner loops are branch free over contiguous floats so the compiler vectorizes them.
+static void propagate(float* field, const float* source, const float* exclude, float* scratch, int width, int height)
+{
+	for (int y = 0; y < height; y++)
+	{
+		const float* in = field + (size_t)y * width;
+		float* out = scratch + (size_t)y * width;
+		if (width == 1)
+		{
+			out[0] = in[0];
+			continue;
+		}
+		out[0] = 0.75f * in[0] + 0.25f * in[1];
+		for (int x = 1; x < width - 1; x++) out[x] = 0.25f * in[x - 1] + 0.5f * in[x] + 0.25f * in[x + 1];
+		out[width - 1] = 0.25f * in[width - 2] + 0.75f * in[width - 1];
+	}
+	for (int y = 0; y < height; y++)
+	{
+		const float* up = scratch + (size_t)(y > 0 ? y - 1 : y) * width;
+		const float* mid = scratch + (size_t)y * width;
+		const float* down = scratch + (size_t)(y < height - 1 ? y + 1 : y) * width;
+		const float* add = source + (size_t)y * width;
+		float* out = field + (size_t)y * width;
+		if (exclude != NULL)
+		{
+			const float* sub = exclude + (size_t)y * width;
+			for (int x = 0; x < width; x++) out[x] = influenceDecay * (0.25f * up[x] + 0.5f * mid[x] + 0.25f * down[x]) + (add[x] - sub[x]);
+		}
+		else
+		{
+			for (int x = 0; x < width; x++) out[x] = influenceDecay * (0.25f * up[x] + 0.5f * mid[x] + 0.25f * down[x]) + add[x];
+		}
+	}
+}
+
+void updateInfluence(world& w)
+{
+	influenceMaps& maps = w.influence_;
+	if (maps.units_.size() == 0) return;
+	propagate(maps.resourceField_.data(), maps.resources_.data(), NULL, maps.scratch_.data(), maps.width_, maps.height_);
+	for (auto playerPtr : w.players_)
+	{
+		playerInfluence& layers = layersOf(w, playerPtr);
+		propagate(layers.pressure_.data(), maps.units_.data(), layers.units_.data(), maps.scratch_.data(), maps.width_, maps.height_);
+		propagate(layers.coverage_.data(), layers.factories_.data(), NULL, maps.scratch_.data(), maps.width_, maps.height_);
+	}
+}
+
+float enemyPressure(const world& w, const player* playerPtr, const tile* tilePtr)
+{
+	const std::vector<float>& field = playerPtr->influence_.pressure_;
+	return field.size() == 0 ? 0.0f : field[cellOf(w.influence_, tilePtr)];
+}
+
+float factoryCoverage(const world& w, const player* playerPtr, const tile* tilePtr)
+{
+	const std::vector<float>& field = playerPtr->influence_.coverage_;
+	return field.size() == 0 ? 0.0f : field[cellOf(w.influence_, tilePtr)];
+}
+
+float resourceProximity(const world& w, const tile* tilePtr)
+{
+	const std::vector<float>& field = w.influence_.resourceField_;
+	return field.size() == 0 ? 0.0f : field[cellOf(w.influence_, tilePtr)];
+}
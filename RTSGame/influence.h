@@ -0,0 +1,50 @@
+#pragma once
+#include "main.h"
+struct world;
+struct player;
+struct unit;
+struct tile;
+
+/* Influence maps
+Kept on a coarse grid of influenceCellSize square cells. Raw counts (unit weight, factories, free resource tiles)
+are updated incrementally as units spawn, move and die and as factories are built or destroyed. Once per AI tick
+the smoothed fields are refreshed by letting last tick's field spread one cell and decay, then adding the raw counts
+back in, so influence reaches further the longer its source stays put. Queries read one cell.
+*/
+const int influenceCellSize = 8;
+
+// One player's layers, lives on the player
+struct playerInfluence
+{
+	std::vector<float> units_; // raw weight of this player's units per cell
+	std::vector<float> factories_; // raw count of this player's factories per cell
+	std::vector<float> pressure_; // smoothed weight of every other player's units
+	std::vector<float> coverage_; // smoothed count of this player's factories
+};
+
+// Layers shared by every player, lives on the world
+struct influenceMaps
+{
+	influenceMaps();
+	int width_; // in cells
+	int height_;
+	std::vector<float> units_; // raw weight of every player's units per cell
+	std::vector<float> resources_; // raw count of resource tiles nobody stands on
+	std::vector<float> resourceField_; // smoothed free resources
+	std::vector<float> scratch_; // horizontal pass of the blur
+};
+
+// Recounts everything from scratch, called whenever a map or snapshot is loaded. A map's resource tiles, as row-major
+// indices, can be given to save scanning for them, only for a map without factories.
+void rebuildInfluence(world& w, const std::vector<Uint32>* resourceTiles = NULL);
+void influenceUnitAdded(world& w, unit* unitPtr);
+void influenceUnitRemoved(world& w, unit* unitPtr);
+void influenceUnitMoved(world& w, unit* unitPtr, tile* from);
+// owner may be NULL for factories placed by the map, which belong to nobody
+void influenceFactoryChanged(world& w, tile* factoryPtr, player* owner, bool built);
+// Spreads and decays every smoothed field once
+void updateInfluence(world& w);
+
+float enemyPressure(const world& w, const player* playerPtr, const tile* tilePtr);
+float factoryCoverage(const world& w, const player* playerPtr, const tile* tilePtr);
+float resourceProximity(const world& w, const tile* tilePtr);
@@ -0,0 +1,223 @@
+#include "landmarks.h"
+#include "tile.h"
+#include "bucketqueue.h"
+
+// terrainWeight of every tile, 0 where astar can't go: walls and factories
+static void passability(const std::vector<std::vector<tile*>>& tiles, std::vector<Uint8>& passable)
+{
+	int height = tiles.size();
+	int width = tiles[0].size();
+	passable.resize(width * height);
+	for (int r = 0; r < height; r++)
+	{
+		for (int c = 0; c < width; c++)
+		{
+			int state = tiles[r][c]->state_;
+			passable[r * width + c] = state == 1 || state == 3 ? 0 : terrainWeight[state];
+		}
+	}
+}
+
+// 8-connected Dijkstra with the costs of tile::stepCost
+static void dijkstra(const std::vector<Uint8>& passable, int width, int height, int source, std::vector<Uint32>& dist)
+{
+	dist.assign(passable.size(), UINT32_MAX);
+	bucketQueue<int> open;
+	dist[source] = 0;
+	open.push(0, source);
+	while (open.size() > 0)
+	{
+		int key;
+		int index = open.pop(key);
+		if ((Uint32)key != dist[index]) continue;
+		int r = index / width;
+		int c = index % width;
+		for (int i = -1; i <= 1; i++)
+		{
+			for (int j = -1; j <= 1; j++)
+			{
+				if (i == 0 && j == 0) continue;
+				int ni = r + i;
+				int nj = c + j;
+				if (ni < 0 || nj < 0 || ni >= height || nj >= width) continue;
+				int next = ni * width + nj;
+				if (!passable[next]) continue;
+				Uint32 cost = key + (i != 0 && j != 0 ? 14 : 10) * std::max(passable[index], passable[next]) / 2;
+				if (cost < dist[next])
+				{
+					dist[next] = cost;
+					open.push(cost, next);
+				}
+			}
+		}
+	}
+}
+
+// Landmarks are spread by farthest-point selection over the largest connected region, where almost all
+// searches happen. Searches elsewhere find every distance unknown and fall back to octile.
+static std::shared_ptr<const landmarkData> computeLandmarks(const std::vector<Uint8>& passable, int width, int height, int count)
+{
+	std::shared_ptr<landmarkData> data = std::make_shared<landmarkData>();
+	data->width_ = width;
+	data->height_ = height;
+	size_t tileCount = passable.size();
+
+	// Find a tile in the largest region
+	std::vector<int> region(tileCount, -1);
+	std::vector<int> stack;
+	int seed = -1;
+	int seedSize = 0;
+	for (int start = 0; start < (int)tileCount; start++)
+	{
+		if (!passable[start] || region[start] >= 0) continue;
+		int size = 0;
+		region[start] = start;
+		stack.push_back(start);
+		while (stack.size() > 0)
+		{
+			int current = stack.back();
+			stack.pop_back();
+			size++;
+			int r = current / width;
+			int c = current % width;
+			for (int i = -1; i <= 1; i++)
+			{
+				for (int j = -1; j <= 1; j++)
+				{
+					int ni = r + i;
+					int nj = c + j;
+					if (ni < 0 || nj < 0 || ni >= height || nj >= width) continue;
+					int next = ni * width + nj;
+					if (!passable[next] || region[next] >= 0) continue;
+					region[next] = start;
+					stack.push_back(next);
+				}
+			}
+		}
+		if (size > seedSize)
+		{
+			seed = start;
+			seedSize = size;
+		}
+	}
+	if (seed < 0) return data;
+
+	std::vector<Uint32> dist;
+	std::vector<Uint32> nearest(tileCount, UINT32_MAX);
+	dijkstra(passable, width, height, seed, dist);
+	for (int l = 0; l < count; l++)
+	{
+		// Next landmark is the tile farthest from every landmark so far (from the seed for the first one)
+		const std::vector<Uint32>& spread = l == 0 ? dist : nearest;
+		int farthest = -1;
+		for (int i = 0; i < (int)tileCount; i++)
+		{
+			if (region[i] != seed) continue;
+			if (farthest < 0 || spread[i] > spread[farthest]) farthest = i;
+		}
+		if (farthest < 0 || (l > 0 && spread[farthest] == 0)) break;
+		dijkstra(passable, width, height, farthest, dist);
+		data->landmarks_.push_back(farthest);
+		data->distances_.resize(data->landmarks_.size() * tileCount);
+		Uint16* row = &data->distances_[l * tileCount];
+		for (size_t i = 0; i < tileCount; i++)
+		{
+			row[i] = dist[i] >= landmarkUnknown ? landmarkUnknown : dist[i];
+			nearest[i] = std::min(nearest[i], dist[i]);
+		}
+	}
+	return data;
+}
+
+int altDistance(const landmarkData* data, tile* from, tile* goal, int cheapestWeight)
+{
+	int best = from->distTo(goal) * cheapestWeight / 2;
+	if (data == NULL) return best;
+	size_t tileCount = (size_t)data->width_ * data->height_;
+	size_t a = from->y_ * data->width_ + from->x_;
+	size_t b = goal->y_ * data->width_ + goal->x_;
+	for (size_t l = 0; l < data->landmarks_.size(); l++)
+	{
+		const Uint16* row = &data->distances_[l * tileCount];
+		Uint16 da = row[a];
+		Uint16 db = row[b];
+		if (da == landmarkUnknown || db == landmarkUnknown) continue;
+		int bound = da > db ? da - db : db - da;
+		if (bound > best) best = bound;
+	}
+	return best;
+}
+
+landmarkTable::landmarkTable(int count, bool background)
+{
+	count_ = count;
+	background_ = background;
+	pendingWidth_ = 0;
+	pendingHeight_ = 0;
+	hasPending_ = false;
+	stopping_ = false;
+}
+
+landmarkTable::~landmarkTable()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	wake_.notify_all();
+	if (worker_.joinable()) worker_.join();
+}
+
+void landmarkTable::build(const std::vector<std::vector<tile*>>& tiles)
+{
+	std::vector<Uint8> passable;
+	passability(tiles, passable);
+	std::shared_ptr<const landmarkData> data = computeLandmarks(passable, tiles[0].size(), tiles.size(), count_);
+	std::lock_guard<std::mutex> lock(mutex_);
+	hasPending_ = false;
+	data_ = data;
+}
+
+void landmarkTable::terrainChanged(const std::vector<std::vector<tile*>>& tiles, bool opened)
+{
+	if (!background_)
+	{
+		build(tiles);
+		return;
+	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (opened) data_.reset();
+	passability(tiles, pending_);
+	pendingWidth_ = tiles[0].size();
+	pendingHeight_ = tiles.size();
+	hasPending_ = true;
+	if (!worker_.joinable())
+	{
+		worker_ = std::thread([this]()
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			while (true)
+			{
+				wake_.wait(lock, [this]() { return hasPending_ || stopping_; });
+				if (stopping_) return;
+				std::vector<Uint8> passable;
+				passable.swap(pending_);
+				int width = pendingWidth_;
+				int height = pendingHeight_;
+				hasPending_ = false;
+				lock.unlock();
+				std::shared_ptr<const landmarkData> data = computeLandmarks(passable, width, height, count_);
+				lock.lock();
+				// A newer change arrived while computing, these tables are already out of date
+				if (!hasPending_) data_ = data;
+			}
+		});
+	}
+	wake_.notify_all();
+}
+
+std::shared_ptr<const landmarkData> landmarkTable::current()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return data_;
+}
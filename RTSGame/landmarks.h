@@ -0,0 +1,45 @@
+#pragma once
+#include "main.h"
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+struct tile;
+
+// Exact distances from a handful of landmark tiles to every tile, for the ALT (A*, landmarks, triangle inequality) heuristic
+struct landmarkData
+{
+	int width_;
+	int height_;
+	std::vector<int> landmarks_; // row-major tile index of each landmark
+	std::vector<Uint16> distances_; // landmark-major, in tile::stepCost units, landmarkUnknown if unreachable or too far to store
+};
+const Uint16 landmarkUnknown = 0xFFFF;
+
+// Lower bound on the path cost between two tiles, never below the octile distance scaled by the lowest terrainWeight
+// on the map, which is what walking all the way on the cheapest terrain would cost
+int altDistance(const landmarkData* data, tile* from, tile* goal, int cheapestWeight = 2);
+
+// Owns the current tables and refreshes them after factories change the terrain.
+// Blocking a tile only makes paths longer, so the old tables stay admissible and keep being used until the refresh lands.
+// Opening a tile can make paths shorter, so the tables are dropped (plain octile) until then.
+struct landmarkTable
+{
+	landmarkTable(int count, bool background);
+	~landmarkTable();
+	void build(const std::vector<std::vector<tile*>>& tiles);
+	void terrainChanged(const std::vector<std::vector<tile*>>& tiles, bool opened);
+	// Tables to use for one search, NULL while none are valid
+	std::shared_ptr<const landmarkData> current();
+	int count_;
+	bool background_; // refresh on a worker thread; off for runs that have to be reproducible
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::shared_ptr<const landmarkData> data_;
+	std::vector<Uint8> pending_; // terrain weights waiting for the worker, 0 where impassable
+	int pendingWidth_;
+	int pendingHeight_;
+	bool hasPending_;
+	bool stopping_;
+	std::thread worker_;
+};
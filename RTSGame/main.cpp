@@ -5,6 +5,24 @@
 #include "unit.h"
 #include "player.h"
 #include "buildfactory.h"
+#include "mapfile.h"
+#include "mapgen.h"
+#include "world.h"
+#include "snapshot.h"
+#include "simulation.h"
+#include "commandlog.h"
+#include "landmarks.h"
+#include "tournament.h"
+#include "mcts.h"
+#include "bench.h"
+#include "trace.h"
+#include "metrics.h"
+#include "overlay.h"
+#include "alloccheck.h"
+#include "stress.h"
+#include "server.h"
+#include "selfcheck.h"
+#include "scheduler.h"
 
 const int tilesize = 25;
 
@@ -12,6 +30,109 @@ const int tilesize = 25;
 
 int main(int argc, char** args)
 {
+	// Command line: --map <file> picks a text or .rtsm map, --convert <map.txt> <map.rtsm> converts and exits
+	// --generate <file> [--size WxH --walls d --rooms n --corridor w --resources n --cluster n --slow n --roads n --seed s] writes a generated map and exits
+	// --load <file.rtss> resumes a saved snapshot instead of starting on a fresh map
+	// --record <file.rtsl> logs every command, --replay <file.rtsl> re-simulates a log headless and exits, --seed <n> seeds the AI
+	// --alt <n> guides A* with n landmarks, --no-coop moves units along plain A* paths instead of cooperative ones
+	// --tournament <map> [--matches n --threads n --seed s --max-frames n --strategies a,b] plays every pairing of AI strategies headless and exits
+	// --bench [--map file --sizes 64,128,256 --reps n --warmup frames --seed s --json file --csv file] times the simulation hot paths and exits
+	// --trace <file> records frame phases from the start and writes them as a Chrome trace on exit, put it before any mode that exits
+	// --metrics <file.csv> dumps the simulation counters every 40 frames, also put before any mode that exits
+	// --alloc-check <map> [--warmup n --frames n --seed s --strategy name] fails if a steady frame of an AI match allocates, in builds with ALLOC_CHECK
+	// --serve <jobs file> [--threads n --out file --slice ticks] plays a batch of matches in one process and exits
+	// --stress [scenario] [--map file | --size WxH --players n --units n --factories n --ticks n ...] runs a large headless match and reports its costs
+	// --mcts-bench <map> [--warmup n --clones n --rollouts n --decisions n --seed s] measures world cloning and search throughput and exits
+	// --self-check plays small built-in scenarios headless and fails if a simulation rule they check is broken
+	std::string mapPath = "map.txt";
+	std::string snapshotPath;
+	std::string recordPath;
+	Uint32 seed = std::random_device{}();
+	int landmarkCount = 0;
+	bool cooperative = true;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = args[i];
+		if (arg == "--convert" && i + 2 < argc)
+		{
+			return convertTextMap(args[i + 1], args[i + 2]) ? 0 : 1;
+		}
+		else if (arg == "--generate" && i + 1 < argc)
+		{
+			mapGenParams params;
+			if (!parseMapGenArgs(argc, args, i + 2, params)) return 1;
+			std::vector<Uint8> states;
+			generateMap(params, states);
+			if (!writeMap(args[i + 1], states, params.width_, params.height_)) return 1;
+			std::cout << "Generated " << params.width_ << "x" << params.height_ << " map " << args[i + 1] << " with seed " << params.seed_ << std::endl;
+			return 0;
+		}
+		else if (arg == "--tournament" && i + 1 < argc)
+		{
+			return runTournament(args[i + 1], argc, args, i + 2);
+		}
+		else if (arg == "--trace" && i + 1 < argc)
+		{
+			traceToFileAtExit(args[++i]);
+		}
+		else if (arg == "--metrics" && i + 1 < argc)
+		{
+			if (!dumpMetricsTo(args[++i])) return 1;
+		}
+		else if (arg == "--serve")
+		{
+			return runServer(argc, args, i + 1);
+		}
+		else if (arg == "--stress")
+		{
+			return runStress(argc, args, i + 1);
+		}
+		else if (arg == "--alloc-check" && i + 1 < argc)
+		{
+			return runAllocCheck(args[i + 1], argc, args, i + 2);
+		}
+		else if (arg == "--self-check")
+		{
+			return runSelfCheck();
+		}
+		else if (arg == "--bench")
+		{
+			return runBench(argc, args, i + 1);
+		}
+		else if (arg == "--mcts-bench" && i + 1 < argc)
+		{
+			return runMctsBench(args[i + 1], argc, args, i + 2);
+		}
+		else if (arg == "--map" && i + 1 < argc)
+		{
+			mapPath = args[++i];
+		}
+		else if (arg == "--load" && i + 1 < argc)
+		{
+			snapshotPath = args[++i];
+		}
+		else if (arg == "--record" && i + 1 < argc)
+		{
+			recordPath = args[++i];
+		}
+		else if (arg == "--replay" && i + 1 < argc)
+		{
+			return runReplay(args[i + 1]);
+		}
+		else if (arg == "--seed" && i + 1 < argc)
+		{
+			seed = std::stoul(args[++i]);
+		}
+		else if (arg == "--alt" && i + 1 < argc)
+		{
+			landmarkCount = std::stoi(args[++i]);
+		}
+		else if (arg == "--no-coop")
+		{
+			cooperative = false;
+		}
+	}
+
 	SDL_Surface* winSurface = NULL;
 	SDL_Window* window = NULL;
 
@@ -40,8 +161,35 @@ int main(int argc, char** args)
 	}
 
 	// Map init
-	std::vector<std::vector<tile*>> tiles;
-	initMap(tiles, false, false);
+	// Helps with combat on big battles, started once instead of a thread per stripe every frame
+	int helpers = std::thread::hardware_concurrency() - 1;
+	workStealingPool pool(std::max(1, helpers));
+	if (helpers > 0) pool.start();
+	world game;
+	if (helpers > 0) game.pool_ = &pool;
+	game.surface_ = winSurface;
+	game.window_ = window;
+	game.rng_.seed(seed);
+	game.cooperative_ = cooperative;
+	// Refreshing in the background would make recorded searches depend on thread timing
+	landmarkTable landmarks(landmarkCount, recordPath.size() == 0);
+	if (landmarkCount > 0) game.landmarks_ = &landmarks;
+	std::vector<std::vector<tile*>>& tiles = game.tiles_;
+	if (snapshotPath.size() > 0)
+	{
+		if (!loadSnapshot(game, snapshotPath, winSurface, window))
+		{
+			std::cout << "Error loading snapshot " << snapshotPath << std::endl;
+			std::system("pause");
+			return 1;
+		}
+	}
+	else if (!loadWorldMap(game, mapPath))
+	{
+		std::cout << "Error loading map " << mapPath << std::endl;
+		std::system("pause");
+		return 1;
+	}
 	// std::cout << "map has height " << tiles.size() << std::endl;
 	// std::cout << "map has width " << tiles[0].size() << std::endl;
 	/*for (auto row : tiles) {
@@ -70,9 +218,9 @@ int main(int argc, char** args)
 			}
 		}
 	}
-	std::list<unit*> units;
+	std::list<unit*>& units = game.units_;
 	// player p1(0, *winSurface);
-	std::vector<player*> players;
+	std::vector<player*>& players = game.players_;
 	// players.push_back(&p1);
 	// unit hero(players.back(), tiles, 0, startr, startc, window, winSurface);
 	// units.push_back(&hero);
@@ -86,34 +234,29 @@ int main(int argc, char** args)
 	// Create unit, initialize, create path variable
 	
 	std::vector<tile*> path;
-	unit* currentunit = NULL;
-
-	// Create list of factories, so that not every tile has to be searched for spawning loop
-	std::list<tile*> factories;
-
-	// Initialize resource timer
-	int resourceMineInterval = 500;
-	Uint64 resourceTimer = SDL_GetTicks64() % resourceMineInterval;
+	unit*& currentunit = game.currentunit_;
 
-	// Initializing spawning timer
-	int unitSpawnInterval = 10000;
-	Uint64 unitSpawnTimer = SDL_GetTicks64() % unitSpawnInterval;
+	// Initialize resource, spawning, move and AI acting timers
+	simTimers timers(SDL_GetTicks64());
 
-	// Init move timer
-	int unitMoveInterval = 75;
-	Uint64 unitMoveTimer = SDL_GetTicks64() % unitMoveInterval;
+	int playerlimit = 15;
 
-	// Init AI acting timer
-	int aiActInterval = 300;
-	Uint64 aiActTimer = SDL_GetTicks64() % aiActInterval;
+	commandLog log;
+	if (recordPath.size() > 0 && log.open(recordPath, game, seed)) game.log_ = &log;
 
-	int playerlimit = 15;
+	// Counters drawn over the map, toggled with F3
+	bool showOverlay = false;
+	metricsRate overlayRate;
+	std::vector<std::string> overlayLines;
 
 	// Main game loop
 	while (gameRunning)
 	{
 		Uint64 start = SDL_GetPerformanceCounter();
-		SDL_PollEvent(&event);
+		traceScope frameScope("frame");
+		traceScope eventScope("events");
+		// Only handle each event once, instead of repeating the last one on frames without a new event
+		if (!SDL_PollEvent(&event)) event.type = SDL_FIRSTEVENT;
 		switch (event.type)
 		{
 			case(SDL_QUIT):
@@ -130,6 +273,37 @@ int main(int argc, char** args)
 						{
 							std::cout << "Player " << i << " has " << players[i]->resources_ << " resources." << std::endl;
 						}
+						printAiStats(players);
+						describeMetrics(game, overlayRate, overlayLines);
+						for (auto& line : overlayLines) std::cout << line << std::endl;
+						break;
+					case(SDLK_F3):
+						showOverlay = !showOverlay;
+						break;
+					case(SDLK_t):
+						// Tracing on and off, each stretch is written out when it ends
+						if (!traceEnabled)
+						{
+							setTracing(true);
+							std::cout << "Tracing on, press T again to write trace.json" << std::endl;
+						}
+						else
+						{
+							setTracing(false);
+							writeChromeTrace("trace.json");
+						}
+						break;
+					case(SDLK_F5):
+						// Quicksave the whole match
+						if (saveSnapshot(game, "quicksave.rtss")) std::cout << "Saved snapshot to quicksave.rtss" << std::endl;
+						break;
+					case(SDLK_F9):
+						// Quickload, replacing the current match
+						if (loadSnapshot(game, "quicksave.rtss", winSurface, window))
+						{
+							std::cout << "Loaded snapshot from quicksave.rtss" << std::endl;
+							if (game.log_ != NULL) game.log_->snapshot(game);
+						}
 						break;
 					case(SDLK_f):
 					{
@@ -138,7 +312,7 @@ int main(int argc, char** args)
 						SDL_GetMouseState(&mousex, &mousey);
 						int row = mousey / tilesize;
 						int column = mousex / tilesize;
-						if(currentunit != NULL) currentunit->buildFactory(units, tiles, factories, winSurface, window, 1);
+						if(currentunit != NULL) currentunit->buildFactory(game, 1);
 						currentunit = NULL;
 						break;
 					}
@@ -149,7 +323,7 @@ int main(int argc, char** args)
 						SDL_GetMouseState(&mousex, &mousey);
 						int row = mousey / tilesize;
 						int column = mousex / tilesize;
-						if (currentunit != NULL) currentunit->buildFactory(units, tiles, factories, winSurface, window, 2);
+						if (currentunit != NULL) currentunit->buildFactory(game, 2);
 						currentunit = NULL;
 						break;
 					}
@@ -160,7 +334,7 @@ int main(int argc, char** args)
 						SDL_GetMouseState(&mousex, &mousey);
 						int row = mousey / tilesize;
 						int column = mousex / tilesize;
-						if (currentunit != NULL) currentunit->buildFactory(units, tiles, factories, winSurface, window, 3);
+						if (currentunit != NULL) currentunit->buildFactory(game, 3);
 						currentunit = NULL;
 						break;
 					}
@@ -213,12 +387,12 @@ int main(int argc, char** args)
 							{
 								for (int c = 0; c < tiles[0].size(); c++)
 								{
-									tiles[r][c]->onpath = false;
+									if (!isImplicitWall(tiles[r][c])) tiles[r][c]->onpath = false;
 								}
 							}
 							// std::cout << "setting new goal to r=" << row << " and c=" << column << std::endl;
 							// tiles[row][column]->state_ = 3;
-							currentunit->navigate(tiles, units, tiles[row][column], winSurface, window);
+							currentunit->navigate(game, tiles[row][column]);
 						}
 						else if (tiles[row][column]->magicflag != 62)
 						{
@@ -237,22 +411,20 @@ int main(int argc, char** args)
 					if (players.size() == 0)
 					{
 						// std::cout << "Creating human player" << std::endl;
-						players.push_back(new player(players.size(), *winSurface, true));
-						units.push_back(new unit(players.back(), tiles, 0, row, column, window, winSurface));
-						currentunit = units.back();
+						player* human = addPlayer(game, true, row, column);
+						if (human != NULL) currentunit = human->units_.back();
+						else std::cout << "A player can only start on open ground" << std::endl;
 					}
 					else if (players.size() < playerlimit)
 					{
 						// std::cout << "Creating AI player" << std::endl;
-						players.push_back(new player(players.size(), *winSurface, false));
-						units.push_back(new unit(players.back(), tiles, 0, row, column, window, winSurface));
+						if (addPlayer(game, false, row, column) == NULL) std::cout << "A player can only start on open ground" << std::endl;
 					}
 					else
 					{
 						std::cout << "Exceeded player limit, which is " << playerlimit << std::endl;
 						std::system("pause");
 					}
-					players.back()->units_.push_back(units.back());
 				}
 				else if (event.button.button == SDL_BUTTON_MIDDLE)
 				{
@@ -261,188 +433,38 @@ int main(int argc, char** args)
 				break;
 		}
 
-		// done separate from searching every unit, so every unit only has to be searched once
-		bool miningTimerDone = false;
-		if (resourceTimer > SDL_GetTicks64() % resourceMineInterval)
-		{
-			miningTimerDone = true;
-			resourceTimer = SDL_GetTicks64() % resourceMineInterval;
-		}
-		else
-		{
-			resourceTimer = SDL_GetTicks64() % resourceMineInterval;
-		}
-
-		// spawning timer flag
-		bool unitSpawnTimerDone = false;
-		if (unitSpawnTimer > SDL_GetTicks64() % unitSpawnInterval)
-		{
-			unitSpawnTimerDone = true;
-			unitSpawnTimer = SDL_GetTicks64() % unitSpawnInterval;
-		}
-		else
-		{
-			unitSpawnTimer = SDL_GetTicks64() % unitSpawnInterval;
-		}
-
-		for (auto factory : factories)
-		{
-			if (unitSpawnTimerDone)
-			{
-				factory->spawnUnit(tiles, units, window, winSurface);
-			}
-		}
-
-		bool unitMoveTimerDone = false;
-		if (unitMoveTimer > SDL_GetTicks64() % unitMoveInterval)
-		{
-			unitMoveTimerDone = true;
-			unitMoveTimer = SDL_GetTicks64() % unitMoveInterval;
-		}
-		else
-		{
-			unitMoveTimer = SDL_GetTicks64() % unitMoveInterval;
-		}
-
-		bool aiActTimerDone = false;
-		if (aiActTimer > SDL_GetTicks64() % aiActInterval)
-		{
-			aiActTimerDone = true;
-			aiActTimer = SDL_GetTicks64() % aiActInterval;
-		}
-		else
-		{
-			aiActTimer = SDL_GetTicks64() % aiActInterval;
-		}
-
-		// Cycle through every player, tell non-humans to perform AI actions
-		if (aiActTimerDone)
-		{
-			for (auto playerPtr : players)
-			{
-				if (!playerPtr->human_)
-				{
-					playerPtr->act(units, factories, tiles, winSurface, window);
-				}
-			}
-		}
-
-		// Cycle through every unit, compute combat, mining, and moving
-		std::list<unit*> deadUnits;
-		std::list<tile*> deadFactories;
-		for(auto unitPtr : units)
-		{
-			if (unitMoveTimerDone) unitPtr->unitMoveFlag = true;
-			if (unitPtr->type_ == 1)
-			{
-				for (auto targetPtr : units)
-				{
-					int targetX = targetPtr->tileAt_->x_;
-					int targetY = targetPtr->tileAt_->y_;
-					int selfX = unitPtr->tileAt_->x_;
-					int selfY = unitPtr->tileAt_->y_;
-					
-					bool above = (targetX == selfX && targetY == selfY - 1);
-					bool left = (targetX == selfX - 1 && targetY == selfY);
-					bool right = (targetX == selfX + 1 && targetY == selfY);
-					bool below = (targetX == selfX && targetY == selfY + 1);
-					if ((above || left || right || below) && (targetPtr->team_ != unitPtr->team_))
-					{
-						targetPtr->health_ -= 1;
-						bool alreadyDeadCheck = deadUnits.end() == std::find(deadUnits.begin(), deadUnits.end(), targetPtr);
-						if (targetPtr->health_ < 1 && alreadyDeadCheck) deadUnits.push_back(targetPtr);
-					}
-				}
-				//for (auto targetPtr : factories)
-				for(std::list<tile*>::iterator it = factories.begin(); it != factories.end(); it++)
-				{
-					tile* targetPtr = *it;
-					int targetX = targetPtr->x_;
-					int targetY = targetPtr->y_;
-					int selfX = unitPtr->tileAt_->x_;
-					int selfY = unitPtr->tileAt_->y_;
-
-					bool above = (targetX == selfX && targetY == selfY - 1);
-					bool left = (targetX == selfX - 1 && targetY == selfY);
-					bool right = (targetX == selfX + 1 && targetY == selfY);
-					bool below = (targetX == selfX && targetY == selfY + 1);
-					if ((above || left || right || below) && (targetPtr->claimedBy_ != unitPtr->team_))
-					{
-						bool alreadyDeadCheck = deadFactories.end() == std::find(deadFactories.begin(), deadFactories.end(), targetPtr);
-						if (alreadyDeadCheck)
-						{
-							targetPtr->claimedBy_ = NULL;
-							targetPtr->factoryType = 0;
-							targetPtr->state_ = 0;
-							it = factories.erase(std::find(factories.begin(), factories.end(), targetPtr));
-							if (it == factories.end()) break;
-						}
-					}
-				}
-			}
-			if (miningTimerDone) unitPtr->resourceMineFlag = true;
-			unitPtr->advance(tiles);
-		}
+		eventScope.close();
 
-		// Kill units that died during this frame, avoids modifying actively iterated lists
-		for (auto deadPtr : deadUnits)
+		traceScope timerScope("timers");
+		tickFlags flags = timers.poll(SDL_GetTicks64());
+		timerScope.close();
+		player* winner = stepWorld(game, flags);
+		if (winner != NULL)
 		{
-			if (deadPtr == currentunit) currentunit = NULL;
-			player* deadPtrTeam = deadPtr->team_;
-			std::list<unit*>::iterator deadUnit = std::find(deadPtrTeam->units_.begin(), deadPtrTeam->units_.end(), deadPtr);
-			// check if dead unit is in its team's unit list
-			if (deadUnit != deadPtrTeam->units_.end())
-			{
-				//std::cout << "Dead unit found in units list. Pointer is " << deadPtr << std::endl;
-				deadPtrTeam->units_.erase(deadUnit);
-			}
-			else std::cout << "Dead unit not found in team's units list. Pointer is " << deadPtr << std::endl;
-
-
-			units.erase(std::find(units.begin(), units.end(), deadPtr));
-			deadPtr->tileAt_->unitAt_ = NULL; // "corpse" removed from tile
-			delete deadPtr;
+			std::cout << "Player with color " << winner->color_ << " wins!" << std::endl;
+			std::system("pause");
+			gameRunning = false;
 		}
 
-
-		// Win conditions: if player has no factories or units, it is a dead player, and if only one player left and has units and factories, that player wins
-		std::list<player*> deadPlayers;
+		// The human player's view, everything until one exists
+		player* viewer = NULL;
 		for (auto playerPtr : players)
 		{
-			bool hasNoFactories = true;
-			for (auto factoryPtr : factories)
-			{
-				if (factoryPtr->claimedBy_ == playerPtr) hasNoFactories = false;
-			}
-			if (playerPtr->units_.size() == 0 && hasNoFactories)
-			{
-				deadPlayers.push_back(playerPtr);
-			}
-		}
-		for (auto playerPtr : deadPlayers)
-		{
-			players.erase(std::find(players.begin(), players.end(), playerPtr));
-			delete playerPtr;
+			if (playerPtr->human_) viewer = playerPtr;
 		}
-		if (players.size() == 1)
+		traceScope drawScope("drawMap");
+		Uint64 now = SDL_GetPerformanceCounter();
+		if (now - overlayRate.lastCounter_ >= SDL_GetPerformanceFrequency()) overlayRate.update(game.metrics_.frames_, now);
+		if (showOverlay)
 		{
-			for (auto playerPtr : players)
-			{
-				bool hasNoFactories = true;
-				for (auto factoryPtr : factories)
-				{
-					if (factoryPtr->claimedBy_ == playerPtr) hasNoFactories = false;
-				}
-				if (playerPtr->units_.size() != 0 && !hasNoFactories)
-				{
-					std::cout << "Player with color " << playerPtr->color_ << " wins!" << std::endl;
-					std::system("pause");
-					gameRunning = false;
-				}
-			}
+			// The overlay goes on before the window is updated, so it doesn't flicker
+			drawMap(winSurface, NULL, tiles, units, players, viewer);
+			describeMetrics(game, overlayRate, overlayLines);
+			drawOverlay(winSurface, overlayLines);
+			SDL_UpdateWindowSurface(window);
 		}
-
-		drawMap(winSurface, window, tiles, units, players);
+		else drawMap(winSurface, window, tiles, units, players, viewer);
+		drawScope.close();
 
 		// FPS counter
 		Uint64 end = SDL_GetPerformanceCounter();
@@ -451,6 +473,8 @@ int main(int argc, char** args)
 		// std::cout << "FPS is " << FPS << std::endl;
 	}
 	// Cleanup
+	printAiStats(players);
+	if (game.log_ != NULL) game.log_->close(game);
 	SDL_FreeSurface(winSurface);
 	SDL_DestroyWindow(window);
 	SDL_Quit();
@@ -0,0 +1,358 @@
+#include "mapfile.h"
+#include "tile.h"
+#include "chunks.h"
+#include <cstring>
+#include <new>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a whole file, unmapped when it goes out of scope
+struct mappedFile
+{
+	mappedFile(const std::string& path);
+	~mappedFile();
+	const Uint8* data_;
+	size_t size_;
+#ifdef _WIN32
+	HANDLE file_;
+	HANDLE mapping_;
+#else
+	int fd_;
+#endif
+};
+
+mappedFile::mappedFile(const std::string& path)
+{
+	data_ = NULL;
+	size_ = 0;
+#ifdef _WIN32
+	mapping_ = NULL;
+	file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file_ == INVALID_HANDLE_VALUE) return;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file_, &fileSize) || fileSize.QuadPart == 0) return;
+	mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping_ == NULL) return;
+	data_ = (const Uint8*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+	if (data_ != NULL) size_ = (size_t)fileSize.QuadPart;
+#else
+	fd_ = open(path.c_str(), O_RDONLY);
+	if (fd_ < 0) return;
+	struct stat info;
+	if (fstat(fd_, &info) != 0 || info.st_size == 0) return;
+	void* view = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+	if (view == MAP_FAILED) return;
+	data_ = (const Uint8*)view;
+	size_ = info.st_size;
+#endif
+}
+
+mappedFile::~mappedFile()
+{
+#ifdef _WIN32
+	if (data_ != NULL) UnmapViewOfFile(data_);
+	if (mapping_ != NULL) CloseHandle(mapping_);
+	if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+	if (data_ != NULL) munmap((void*)data_, size_);
+	if (fd_ >= 0) close(fd_);
+#endif
+}
+
+// Chunks whose every tile is wall, row-major over the chunk grid
+static std::vector<Uint8> implicitChunks(const Uint8* states, int width, int height)
+{
+	int chunksWide = (width + chunkSize - 1) / chunkSize;
+	int chunksHigh = (height + chunkSize - 1) / chunkSize;
+	std::vector<Uint8> implicit((size_t)chunksWide * chunksHigh, 1);
+	for (int r = 0; r < height; r++)
+	{
+		for (int c = 0; c < width; c++)
+		{
+			if (states[r * width + c] != 1) implicit[(r / chunkSize) * chunksWide + c / chunkSize] = 0;
+		}
+	}
+	return implicit;
+}
+
+void allocateTiles(std::vector<std::vector<tile*>>& tiles, const Uint8* states, int width, int height)
+{
+	int chunksWide = (width + chunkSize - 1) / chunkSize;
+	std::vector<Uint8> implicit = implicitChunks(states, width, height);
+	size_t stored = 0;
+	for (int r = 0; r < height; r++)
+	{
+		for (int c = 0; c < width; c++)
+		{
+			if (!implicit[(r / chunkSize) * chunksWide + c / chunkSize]) stored++;
+		}
+	}
+	// One allocation for the whole map instead of one per tile
+	tile* slab = stored == 0 ? NULL : (tile*)::operator new(sizeof(tile) * stored);
+	tiles.assign(height, std::vector<tile*>(width));
+	size_t next = 0;
+	for (int r = 0; r < height; r++)
+	{
+		for (int c = 0; c < width; c++)
+		{
+			if (implicit[(r / chunkSize) * chunksWide + c / chunkSize])
+			{
+				tiles[r][c] = &implicitWall;
+				continue;
+			}
+			tile* tilePtr = &slab[next++];
+			new (tilePtr) tile(states[r * width + c], c, r);
+			tiles[r][c] = tilePtr;
+		}
+	}
+}
+
+void freeTiles(std::vector<std::vector<tile*>>& tiles)
+{
+	// The first stored tile in row-major order is the start of the slab
+	tile* slab = NULL;
+	for (auto& row : tiles)
+	{
+		for (auto tilePtr : row)
+		{
+			if (isImplicitWall(tilePtr)) continue;
+			if (slab == NULL) slab = tilePtr;
+			tilePtr->~tile();
+		}
+	}
+	::operator delete(slab);
+	tiles.clear();
+}
+
+bool isBinaryMapPath(const std::string& path)
+{
+	std::string extension = ".rtsm";
+	return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+bool readTextMap(const std::string& path, std::vector<Uint8>& states, int& width, int& height)
+{
+	std::ifstream map(path, std::ios::binary);
+	if (!map)
+	{
+		std::cout << "Could not open map " << path << std::endl;
+		return false;
+	}
+	std::string contents((std::istreambuf_iterator<char>(map)), std::istreambuf_iterator<char>());
+	states.clear();
+	states.reserve(contents.size());
+	width = 0;
+	height = 0;
+	int column = 0;
+	for (char ch : contents)
+	{
+		if (ch == '\r') continue;
+		if (ch == '\n')
+		{
+			if (column == 0) continue;
+			if (width == 0) width = column;
+			if (column != width)
+			{
+				std::cout << "Map " << path << " row " << height << " has " << column << " tiles, expected " << width << std::endl;
+				return false;
+			}
+			column = 0;
+			height++;
+			continue;
+		}
+		if (ch < '0' || ch >= '0' + tileStateCount)
+		{
+			std::cout << "Map " << path << " row " << height << " has unknown tile '" << ch << "'" << std::endl;
+			return false;
+		}
+		states.push_back(ch - '0');
+		column++;
+	}
+	// Last row may not end in a newline
+	if (column != 0)
+	{
+		if (width == 0) width = column;
+		if (column != width)
+		{
+			std::cout << "Map " << path << " row " << height << " has " << column << " tiles, expected " << width << std::endl;
+			return false;
+		}
+		height++;
+	}
+	return width > 0 && height > 0;
+}
+
+bool writeTextMap(const std::string& path, const std::vector<Uint8>& states, int width, int height)
+{
+	std::ofstream out(path, std::ios::binary);
+	if (!out)
+	{
+		std::cout << "Could not open " << path << " for writing" << std::endl;
+		return false;
+	}
+	std::string row(width, '0');
+	for (int r = 0; r < height; r++)
+	{
+		for (int c = 0; c < width; c++) row[c] = '0' + states[r * width + c];
+		out << row;
+		if (r != height - 1) out << '\n';
+	}
+	return out.good();
+}
+
+bool writeBinaryMap(const std::string& path, const std::vector<Uint8>& states, int width, int height)
+{
+	std::ofstream out(path, std::ios::binary);
+	if (!out)
+	{
+		std::cout << "Could not open " << path << " for writing" << std::endl;
+		return false;
+	}
+	std::vector<Uint32> stateCounts(tileStateCount, 0);
+	std::vector<Uint32> resourceTiles;
+	for (Uint32 i = 0; i < states.size(); i++)
+	{
+		if (states[i] < stateCounts.size()) stateCounts[states[i]]++;
+		if (states[i] == 2) resourceTiles.push_back(i);
+	}
+
+	mapHeader header;
+	memcpy(header.magic, "RTSM", 4);
+	header.version = mapFileVersion;
+	header.width = width;
+	header.height = height;
+	header.sectionCount = 2;
+	header.reserved = 0;
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)states.data(), states.size());
+
+	mapSection section;
+	section.tag = sectionStateCounts;
+	section.size = stateCounts.size() * sizeof(Uint32);
+	out.write((const char*)&section, sizeof(section));
+	out.write((const char*)stateCounts.data(), section.size);
+
+	Uint32 resourceCount = resourceTiles.size();
+	section.tag = sectionResourceTiles;
+	section.size = sizeof(Uint32) + resourceCount * sizeof(Uint32);
+	out.write((const char*)&section, sizeof(section));
+	out.write((const char*)&resourceCount, sizeof(resourceCount));
+	out.write((const char*)resourceTiles.data(), resourceCount * sizeof(Uint32));
+	return out.good();
+}
+
+bool loadBinaryMap(const std::string& path, std::vector<std::vector<tile*>>& tiles, mapMetadata* metadata)
+{
+	mappedFile file(path);
+	if (file.data_ == NULL)
+	{
+		std::cout << "Could not map " << path << std::endl;
+		return false;
+	}
+	mapHeader header;
+	if (file.size_ < sizeof(header))
+	{
+		std::cout << "Map " << path << " is too small to hold a header" << std::endl;
+		return false;
+	}
+	memcpy(&header, file.data_, sizeof(header));
+	if (memcmp(header.magic, "RTSM", 4) != 0 || header.version != mapFileVersion)
+	{
+		std::cout << "Map " << path << " is not a version " << mapFileVersion << " binary map" << std::endl;
+		return false;
+	}
+	size_t tileCount = (size_t)header.width * header.height;
+	if (tileCount == 0 || file.size_ - sizeof(header) < tileCount)
+	{
+		std::cout << "Map " << path << " is truncated" << std::endl;
+		return false;
+	}
+
+	for (size_t i = 0; i < tileCount; i++)
+	{
+		if (file.data_[sizeof(header) + i] >= tileStateCount)
+		{
+			std::cout << "Map " << path << " has unknown tile state " << (int)file.data_[sizeof(header) + i] << std::endl;
+			return false;
+		}
+	}
+	// States are used in place from the mapping, no intermediate copy
+	freeTiles(tiles);
+	allocateTiles(tiles, file.data_ + sizeof(header), header.width, header.height);
+
+	if (metadata == NULL) return true;
+	metadata->stateCounts.clear();
+	metadata->resourceTiles.clear();
+	size_t offset = sizeof(header) + tileCount;
+	for (Uint32 i = 0; i < header.sectionCount; i++)
+	{
+		mapSection section;
+		if (file.size_ - offset < sizeof(section)) break;
+		memcpy(&section, file.data_ + offset, sizeof(section));
+		offset += sizeof(section);
+		if (file.size_ - offset < section.size) break;
+		const Uint8* payload = file.data_ + offset;
+		switch (section.tag)
+		{
+		case(sectionStateCounts):
+			metadata->stateCounts.resize(section.size / sizeof(Uint32));
+			memcpy(metadata->stateCounts.data(), payload, metadata->stateCounts.size() * sizeof(Uint32));
+			break;
+		case(sectionResourceTiles):
+		{
+			Uint32 resourceCount;
+			if (section.size < sizeof(resourceCount)) break;
+			memcpy(&resourceCount, payload, sizeof(resourceCount));
+			if (((size_t)resourceCount + 1) * sizeof(Uint32) > section.size) break;
+			metadata->resourceTiles.resize(resourceCount);
+			memcpy(metadata->resourceTiles.data(), payload + sizeof(Uint32), resourceCount * sizeof(Uint32));
+			break;
+		}
+		}
+		offset += section.size;
+	}
+	return true;
+}
+
+bool loadMap(const std::string& path, std::vector<std::vector<tile*>>& tiles, mapMetadata* metadata)
+{
+	if (isBinaryMapPath(path)) return loadBinaryMap(path, tiles, metadata);
+	// Text maps carry no metadata
+	if (metadata != NULL)
+	{
+		metadata->stateCounts.clear();
+		metadata->resourceTiles.clear();
+	}
+	std::vector<Uint8> states;
+	int width;
+	int height;
+	if (!readTextMap(path, states, width, height)) return false;
+	freeTiles(tiles);
+	allocateTiles(tiles, states.data(), width, height);
+	return true;
+}
+
+bool writeMap(const std::string& path, const std::vector<Uint8>& states, int width, int height)
+{
+	if (isBinaryMapPath(path)) return writeBinaryMap(path, states, width, height);
+	return writeTextMap(path, states, width, height);
+}
+
+bool convertTextMap(const std::string& textPath, const std::string& binaryPath)
+{
+	std::vector<Uint8> states;
+	int width;
+	int height;
+	if (!readTextMap(textPath, states, width, height)) return false;
+	if (!writeBinaryMap(binaryPath, states, width, height)) return false;
+	std::cout << "Converted " << textPath << " (" << width << "x" << height << ") to " << binaryPath << std::endl;
+	return true;
+}
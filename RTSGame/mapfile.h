@@ -0,0 +1,53 @@
+#pragma once
+#include "main.h"
+struct tile;
+
+/* Binary map format (.rtsm)
+Header, then width*height tile states as one byte each in row-major order, then optional metadata sections.
+Every section is a mapSection followed by size bytes of payload. Loaders skip sections they don't know.
+All fields are little-endian.
+*/
+const Uint32 mapFileVersion = 1;
+
+struct mapHeader
+{
+	char magic[4]; // "RTSM"
+	Uint32 version;
+	Uint32 width;
+	Uint32 height;
+	Uint32 sectionCount;
+	Uint32 reserved;
+};
+
+struct mapSection
+{
+	Uint32 tag;
+	Uint32 size;
+};
+
+enum mapSectionTag
+{
+	sectionStateCounts = 1, // Uint32 count for each tile state, as many as the writer knew (4 before slow ground and roads)
+	sectionResourceTiles = 2 // Uint32 number of resource tiles, then Uint32 row-major index of each
+};
+
+// Precomputed data read from the optional sections, empty if the file has none
+struct mapMetadata
+{
+	std::vector<Uint32> stateCounts;
+	std::vector<Uint32> resourceTiles;
+};
+
+// Tiles are constructed into one contiguous slab in row-major order, except those of chunks that are wall throughout,
+// which all point at implicitWall and take no memory of their own
+void allocateTiles(std::vector<std::vector<tile*>>& tiles, const Uint8* states, int width, int height);
+void freeTiles(std::vector<std::vector<tile*>>& tiles);
+
+bool isBinaryMapPath(const std::string& path);
+bool readTextMap(const std::string& path, std::vector<Uint8>& states, int& width, int& height);
+bool writeTextMap(const std::string& path, const std::vector<Uint8>& states, int width, int height);
+bool writeBinaryMap(const std::string& path, const std::vector<Uint8>& states, int width, int height);
+bool loadBinaryMap(const std::string& path, std::vector<std::vector<tile*>>& tiles, mapMetadata* metadata = NULL);
+bool loadMap(const std::string& path, std::vector<std::vector<tile*>>& tiles, mapMetadata* metadata = NULL);
+bool writeMap(const std::string& path, const std::vector<Uint8>& states, int width, int height);
+bool convertTextMap(const std::string& textPath, const std::string& binaryPath);
@@ -0,0 +1,221 @@
+#include "mapgen.h"
+#include <random>
+
+/*States
+0 = Open
+1 = Wall
+2 = Resource
+4 = Slow ground
+5 = Road
+*/
+
+mapGenParams::mapGenParams()
+{
+	width_ = 64;
+	height_ = 64;
+	wallDensity_ = 0.1;
+	rooms_ = 0;
+	corridorWidth_ = 2;
+	resourceClusters_ = 4;
+	clusterSize_ = 6;
+	slowPatches_ = 0;
+	roads_ = 0;
+	seed_ = 1;
+}
+
+// std distributions are implementation defined, so draw straight from the engine to get identical maps on every platform
+static int randomBelow(std::mt19937& gen, int n)
+{
+	if (n <= 0) return 0;
+	return gen() % n;
+}
+
+static void fillRect(std::vector<Uint8>& states, int width, int r0, int c0, int r1, int c1, Uint8 state)
+{
+	for (int r = r0; r <= r1; r++)
+	{
+		for (int c = c0; c <= c1; c++) states[r * width + c] = state;
+	}
+}
+
+void generateMap(const mapGenParams& params, std::vector<Uint8>& states)
+{
+	std::mt19937 gen(params.seed_);
+	int width = params.width_;
+	int height = params.height_;
+	states.assign(width * height, 1);
+
+	// Interior, leaving a one tile border wall like map.txt
+	int minr = 1;
+	int minc = 1;
+	int maxr = height - 2;
+	int maxc = width - 2;
+	if (maxr < minr || maxc < minc) return;
+
+	if (params.rooms_ <= 0)
+	{
+		fillRect(states, width, minr, minc, maxr, maxc, 0);
+	}
+	else
+	{
+		// Carve rooms, each joined to the previous one by an L shaped corridor
+		int prevr = -1;
+		int prevc = -1;
+		int maxRoomh = std::max(3, (maxr - minr) / 3);
+		int maxRoomw = std::max(3, (maxc - minc) / 3);
+		for (int i = 0; i < params.rooms_; i++)
+		{
+			int roomh = std::min(maxr - minr + 1, 3 + randomBelow(gen, maxRoomh));
+			int roomw = std::min(maxc - minc + 1, 3 + randomBelow(gen, maxRoomw));
+			int r0 = minr + randomBelow(gen, maxr - minr + 2 - roomh);
+			int c0 = minc + randomBelow(gen, maxc - minc + 2 - roomw);
+			fillRect(states, width, r0, c0, r0 + roomh - 1, c0 + roomw - 1, 0);
+			int centerr = r0 + roomh / 2;
+			int centerc = c0 + roomw / 2;
+			if (prevr >= 0)
+			{
+				int halfWidth = (params.corridorWidth_ - 1) / 2;
+				int extra = (params.corridorWidth_ - 1) - halfWidth;
+				int lowr = std::max(minr, std::min(prevr, centerr) - halfWidth);
+				int highr = std::min(maxr, std::max(prevr, centerr) + extra);
+				int lowc = std::max(minc, std::min(prevc, centerc) - halfWidth);
+				int highc = std::min(maxc, std::max(prevc, centerc) + extra);
+				// Horizontal leg along the previous room's row, vertical leg along this room's column
+				fillRect(states, width, std::max(minr, prevr - halfWidth), lowc, std::min(maxr, prevr + extra), highc, 0);
+				fillRect(states, width, lowr, std::max(minc, centerc - halfWidth), highr, std::min(maxc, centerc + extra), 0);
+			}
+			prevr = centerr;
+			prevc = centerc;
+		}
+	}
+
+	// Scatter short wall segments until the requested share of open tiles is wall
+	int openCount = 0;
+	for (Uint8 state : states)
+	{
+		if (state == 0) openCount++;
+	}
+	int wallTarget = openCount * params.wallDensity_;
+	int attempts = 0;
+	while (wallTarget > 0 && attempts < openCount * 4)
+	{
+		attempts++;
+		int r = minr + randomBelow(gen, maxr - minr + 1);
+		int c = minc + randomBelow(gen, maxc - minc + 1);
+		bool horizontal = randomBelow(gen, 2) == 0;
+		int length = 1 + randomBelow(gen, 6);
+		for (int i = 0; i < length && wallTarget > 0; i++)
+		{
+			if (r > maxr || c > maxc) break;
+			Uint8& state = states[r * width + c];
+			if (state == 0)
+			{
+				state = 1;
+				wallTarget--;
+			}
+			if (horizontal) c++;
+			else r++;
+		}
+	}
+
+	// Resource clusters grow by random walk from an open seed tile
+	for (int i = 0; i < params.resourceClusters_; i++)
+	{
+		int r = -1;
+		int c = -1;
+		for (int tries = 0; tries < 1000; tries++)
+		{
+			int tryr = minr + randomBelow(gen, maxr - minr + 1);
+			int tryc = minc + randomBelow(gen, maxc - minc + 1);
+			if (states[tryr * width + tryc] == 0)
+			{
+				r = tryr;
+				c = tryc;
+				break;
+			}
+		}
+		if (r < 0) continue;
+		int placed = 0;
+		for (int steps = 0; placed < params.clusterSize_ && steps < params.clusterSize_ * 8; steps++)
+		{
+			Uint8& state = states[r * width + c];
+			if (state == 0)
+			{
+				state = 2;
+				placed++;
+			}
+			int nextr = r + randomBelow(gen, 3) - 1;
+			int nextc = c + randomBelow(gen, 3) - 1;
+			if (nextr < minr || nextr > maxr || nextc < minc || nextc > maxc) continue;
+			if (states[nextr * width + nextc] == 1) continue;
+			r = nextr;
+			c = nextc;
+		}
+	}
+
+	// Slow ground grows the same way, over open ground only
+	for (int i = 0; i < params.slowPatches_; i++)
+	{
+		int r = minr + randomBelow(gen, maxr - minr + 1);
+		int c = minc + randomBelow(gen, maxc - minc + 1);
+		for (int steps = 0; steps < slowPatchSize * 2; steps++)
+		{
+			if (states[r * width + c] == 0) states[r * width + c] = 4;
+			r = std::min(maxr, std::max(minr, r + randomBelow(gen, 3) - 1));
+			c = std::min(maxc, std::max(minc, c + randomBelow(gen, 3) - 1));
+		}
+	}
+
+	// Roads pave open and slow ground, walls and resources interrupt them
+	for (int i = 0; i < params.roads_; i++)
+	{
+		bool horizontal = i % 2 == 0;
+		int line = horizontal ? minr + randomBelow(gen, maxr - minr + 1) : minc + randomBelow(gen, maxc - minc + 1);
+		int length = horizontal ? maxc - minc + 1 : maxr - minr + 1;
+		for (int k = 0; k < length; k++)
+		{
+			Uint8& state = horizontal ? states[line * width + minc + k] : states[(minr + k) * width + line];
+			if (state == 0 || state == 4) state = 5;
+		}
+	}
+}
+
+// Reads --size WxH (or N), --walls, --rooms, --corridor, --resources, --cluster, --slow, --roads and --seed starting at args[first]
+bool parseMapGenArgs(int argc, char** args, int first, mapGenParams& params)
+{
+	for (int i = first; i < argc; i++)
+	{
+		std::string arg = args[i];
+		if (i + 1 >= argc)
+		{
+			std::cout << "Missing value for " << arg << std::endl;
+			return false;
+		}
+		std::string value = args[++i];
+		if (arg == "--size")
+		{
+			size_t split = value.find('x');
+			params.width_ = std::stoi(value.substr(0, split));
+			params.height_ = split == std::string::npos ? params.width_ : std::stoi(value.substr(split + 1));
+		}
+		else if (arg == "--walls") params.wallDensity_ = std::stod(value);
+		else if (arg == "--rooms") params.rooms_ = std::stoi(value);
+		else if (arg == "--corridor") params.corridorWidth_ = std::max(1, std::stoi(value));
+		else if (arg == "--resources") params.resourceClusters_ = std::stoi(value);
+		else if (arg == "--cluster") params.clusterSize_ = std::stoi(value);
+		else if (arg == "--slow") params.slowPatches_ = std::stoi(value);
+		else if (arg == "--roads") params.roads_ = std::stoi(value);
+		else if (arg == "--seed") params.seed_ = std::stoul(value);
+		else
+		{
+			std::cout << "Unknown map generator option " << arg << std::endl;
+			return false;
+		}
+	}
+	if (params.width_ < 3 || params.height_ < 3)
+	{
+		std::cout << "Generated maps must be at least 3x3" << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "main.h"
+
+const int slowPatchSize = 24;
+
+// Parameters for a procedurally generated map, the same parameters always give the same map
+struct mapGenParams
+{
+	mapGenParams();
+	int width_;
+	int height_;
+	double wallDensity_; // fraction of open interior tiles turned into wall segments
+	int rooms_; // 0 = open field, otherwise rooms carved out of solid rock and joined by corridors
+	int corridorWidth_;
+	int resourceClusters_;
+	int clusterSize_; // resource tiles per cluster
+	int slowPatches_; // blobs of slow ground, slowPatchSize tiles each
+	int roads_; // straight roads running the whole way across the map, alternately horizontal and vertical
+	Uint32 seed_;
+};
+
+void generateMap(const mapGenParams& params, std::vector<Uint8>& states);
+bool parseMapGenArgs(int argc, char** args, int first, mapGenParams& params);
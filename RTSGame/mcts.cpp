@@ -0,0 +1,325 @@
+#include "mcts.h"
+#include "world.h"
+#include "tile.h"
+#include "unit.h"
+#include "player.h"
+#include "simulation.h"
+#include "components.h"
+#include <cmath>
+
+struct mctsOrder
+{
+	int unitId_; // -1 for doing nothing
+	bool build_; // build a factory of factoryType_ instead of moving
+	int factoryType_;
+	int row_;
+	int column_;
+};
+
+static void applyOrder(world& w, const mctsOrder& order)
+{
+	if (order.unitId_ < 0) return;
+	for (auto unitPtr : w.units_)
+	{
+		if (unitPtr->id_ != order.unitId_) continue;
+		if (order.build_) unitPtr->buildFactory(w, order.factoryType_);
+		else unitPtr->navigate(w, w.tiles_[order.row_][order.column_]);
+		return;
+	}
+}
+
+// A few random picks, keeping the first in from's region
+static tile* randomReachable(const std::vector<tile*>& candidates, const tile* from, std::mt19937& gen)
+{
+	if (candidates.size() == 0) return NULL;
+	std::uniform_int_distribution<> distrib(0, candidates.size() - 1);
+	for (int i = 0; i < 16; i++)
+	{
+		tile* tilePtr = candidates[distrib(gen)];
+		if (sameComponent(from, tilePtr)) return tilePtr;
+	}
+	return NULL;
+}
+
+static mctsOrder moveOrder(const unit* unitPtr, const tile* goal)
+{
+	mctsOrder order = { unitPtr->id_, false, 0, goal->y_, goal->x_ };
+	return order;
+}
+
+static void generateOrders(const world& w, const player* playerPtr, std::mt19937& gen, std::vector<mctsOrder>& orders)
+{
+	std::vector<tile*> openTiles;
+	std::vector<tile*> openResources;
+	std::vector<tile*> frontier;
+	int teamFactories = 0;
+	for (int r = 0; r < (int)w.tiles_.size(); r++)
+	{
+		for (int c = 0; c < (int)w.tiles_[r].size(); c++)
+		{
+			if (c % chunkSize == 0 && w.chunks_.at(r / chunkSize, c / chunkSize).allWall())
+			{
+				c += chunkSize - 1;
+				continue;
+			}
+			tile* tilePtr = w.tiles_[r][c];
+			if (tilePtr->claimedBy_ == playerPtr) teamFactories++;
+			if (!isExplored(playerPtr, tilePtr)) continue;
+			if (tilePtr->walkable() && tilePtr->unitAt_ == NULL)
+			{
+				openTiles.push_back(tilePtr);
+				if (onFrontier(w, playerPtr, tilePtr)) frontier.push_back(tilePtr);
+			}
+			if (tilePtr->state_ == 2 && tilePtr->unitAt_ == NULL) openResources.push_back(tilePtr);
+		}
+	}
+	int activeMiners = 0;
+	for (auto unitPtr : playerPtr->ofType_[unitMiner])
+	{
+		if (unitPtr->tileAt_->state_ == 2) activeMiners++;
+	}
+
+	std::vector<mctsOrder> options;
+	for (auto unitPtr : playerPtr->ofType_[unitFighter])
+	{
+		// One random destination and the most contested of a few
+		tile* goal = randomReachable(openTiles, unitPtr->tileAt_, gen);
+		if (goal != NULL) options.push_back(moveOrder(unitPtr, goal));
+		tile* contested = NULL;
+		for (int i = 0; i < 4; i++)
+		{
+			tile* candidate = randomReachable(openTiles, unitPtr->tileAt_, gen);
+			if (candidate != NULL && (contested == NULL || enemyPressure(w, playerPtr, candidate) > enemyPressure(w, playerPtr, contested))) contested = candidate;
+		}
+		if (contested != NULL && contested != goal) options.push_back(moveOrder(unitPtr, contested));
+		// Scouting, the search can only value what it has seen
+		tile* scout = randomReachable(frontier, unitPtr->tileAt_, gen);
+		if (scout != NULL) options.push_back(moveOrder(unitPtr, scout));
+	}
+	for (auto unitPtr : playerPtr->ofType_[unitBuilder])
+	{
+		tile* goal = randomReachable(openTiles, unitPtr->tileAt_, gen);
+		if (goal != NULL) options.push_back(moveOrder(unitPtr, goal));
+		tile* scout = randomReachable(frontier, unitPtr->tileAt_, gen);
+		if (scout != NULL) options.push_back(moveOrder(unitPtr, scout));
+		if (teamFactories * 2 < activeMiners && unitPtr->tileAt_->state_ == 0)
+		{
+			for (int factoryType = 1; factoryType <= 3; factoryType++)
+			{
+				mctsOrder order = { unitPtr->id_, true, factoryType, 0, 0 };
+				options.push_back(order);
+			}
+		}
+	}
+	for (auto unitPtr : playerPtr->ofType_[unitMiner])
+	{
+		if (unitPtr->tileAt_->state_ != 2)
+		{
+			tile* goal = randomReachable(openResources, unitPtr->tileAt_, gen);
+			if (goal != NULL) options.push_back(moveOrder(unitPtr, goal));
+		}
+	}
+	std::shuffle(options.begin(), options.end(), gen);
+	orders.clear();
+	mctsOrder idle = { -1, false, 0, 0, 0 };
+	orders.push_back(idle);
+	for (size_t i = 0; i < options.size() && (int)orders.size() < mctsMaxCandidates; i++) orders.push_back(options[i]);
+}
+
+static float material(const world& w, const player* playerPtr)
+{
+	float score = playerPtr->resources_ * 0.05f;
+	for (auto unitPtr : playerPtr->units_) score += unitArchetypes[unitPtr->type_].value_;
+	for (auto factoryPtr : w.factories_)
+	{
+		if (factoryPtr->claimedBy_ == playerPtr) score += 5.0f;
+	}
+	return score;
+}
+
+// Share of the material held by playerPtr against its strongest opponent, 0 if it died
+static float evaluate(const world& w, const player* playerPtr)
+{
+	if (std::find(w.players_.begin(), w.players_.end(), playerPtr) == w.players_.end()) return 0.0f;
+	float own = material(w, playerPtr);
+	float enemy = 0.0f;
+	for (auto otherPtr : w.players_)
+	{
+		if (otherPtr != playerPtr) enemy = std::max(enemy, material(w, otherPtr));
+	}
+	return own + enemy > 0.0f ? own / (own + enemy) : 0.5f;
+}
+
+// Clones w, applies order and plays the clone forward, returns the score for the player at playerIndex.
+// Gives up and returns a negative score once deadline passes, checked after every frame.
+static float rollout(const world& w, int playerIndex, const mctsOrder& order, world& scratch, std::mt19937& gen, Uint64 deadline)
+{
+	cloneWorld(w, scratch);
+	scratch.verbose_ = false;
+	scratch.rng_.seed(gen());
+	for (auto playerPtr : scratch.players_)
+	{
+		if (playerPtr->strat_ == Strategy::mcts) playerPtr->strat_ = Strategy::balanced;
+	}
+	player* self = scratch.players_[playerIndex];
+	applyOrder(scratch, order);
+	simTimers timers(0);
+	Uint64 now = 0;
+	for (int frame = 0; frame < mctsRolloutFrames; frame++)
+	{
+		now += headlessFrameMs;
+		player* winner = stepWorld(scratch, timers.poll(now));
+		if (winner != NULL) return winner == self ? 1.0f : 0.0f;
+		if (SDL_GetPerformanceCounter() >= deadline) return -1.0f;
+	}
+	return evaluate(scratch, self);
+}
+
+int mctsAct(world& w, player* playerPtr)
+{
+	if (playerPtr->units_.size() == 1)
+	{
+		unit* unitPtr = playerPtr->units_.back();
+		if (unitPtr->type_ == unitMain)
+		{
+			unitPtr->buildFactory(w, unitBuilder);
+			return 0;
+		}
+	}
+	// Searching draws once from the match generator no matter how long it runs, so the match itself stays reproducible
+	std::mt19937 gen(w.rng_());
+	std::vector<mctsOrder> orders;
+	generateOrders(w, playerPtr, gen, orders);
+	if (orders.size() == 1) return 0;
+	int playerIndex = std::find(w.players_.begin(), w.players_.end(), playerPtr) - w.players_.begin();
+
+	std::vector<int> visits(orders.size(), 0);
+	std::vector<float> totals(orders.size(), 0.0f);
+	if (playerPtr->searchWorld_ == NULL) playerPtr->searchWorld_ = new world();
+	world& scratch = *playerPtr->searchWorld_;
+	int rollouts = 0;
+	// The last twentieth of the budget is left for issuing the chosen order, which plans a path.
+	// With no time left for a single rollout every order has 0 visits and the first one, doing nothing, is issued.
+	Uint64 searchStart = SDL_GetPerformanceCounter();
+	Uint64 searchDeadline = searchStart + (playerPtr->deadline_ > searchStart ? (playerPtr->deadline_ - searchStart) * 19 / 20 : 0);
+	while (SDL_GetPerformanceCounter() < searchDeadline)
+	{
+		// UCB1, every order gets tried once first
+		int pick = 0;
+		float bestBound = -1.0f;
+		for (size_t i = 0; i < orders.size(); i++)
+		{
+			float bound = visits[i] == 0 ? 2.0f : totals[i] / visits[i] + 0.7f * std::sqrt(std::log((float)rollouts) / visits[i]);
+			if (bound > bestBound)
+			{
+				pick = i;
+				bestBound = bound;
+			}
+		}
+		float score = rollout(w, playerIndex, orders[pick], scratch, gen, searchDeadline);
+		if (score < 0.0f) break;
+		totals[pick] += score;
+		visits[pick]++;
+		rollouts++;
+	}
+
+	int best = std::max_element(visits.begin(), visits.end()) - visits.begin();
+	applyOrder(w, orders[best]);
+	return rollouts;
+}
+
+int runMctsBench(const std::string& mapPath, int argc, char** args, int first)
+{
+	int warmupFrames = 2000;
+	int clones = 10000;
+	int rollouts = 200;
+	int decisions = 20;
+	Uint32 seed = 1;
+	for (int i = first; i < argc; i++)
+	{
+		std::string arg = args[i];
+		if (i + 1 >= argc)
+		{
+			std::cout << "Missing value for " << arg << std::endl;
+			return 1;
+		}
+		std::string value = args[++i];
+		if (arg == "--warmup") warmupFrames = std::stoi(value);
+		else if (arg == "--clones") clones = std::max(1, std::stoi(value));
+		else if (arg == "--rollouts") rollouts = std::max(1, std::stoi(value));
+		else if (arg == "--decisions") decisions = std::max(1, std::stoi(value));
+		else if (arg == "--seed") seed = std::stoul(value);
+		else
+		{
+			std::cout << "Unknown benchmark option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, 1, 1, 32, SDL_PIXELFORMAT_RGB888);
+	world w;
+	w.surface_ = surface;
+	w.verbose_ = false;
+	w.rng_.seed(seed);
+	std::vector<tile*> starts;
+	if (!loadWorldMap(w, mapPath) || !pickStartTiles(w, 2, starts))
+	{
+		std::cout << "No room for two players on " << mapPath << std::endl;
+		SDL_FreeSurface(surface);
+		return 1;
+	}
+	addPlayer(w, false, starts[0]->y_, starts[0]->x_);
+	addPlayer(w, false, starts[1]->y_, starts[1]->x_);
+	// Play into the midgame so there is something to clone
+	simTimers timers(0);
+	Uint64 now = 0;
+	for (int frame = 0; frame < warmupFrames && w.players_.size() > 1; frame++)
+	{
+		now += headlessFrameMs;
+		stepWorld(w, timers.poll(now));
+	}
+	if (w.players_.size() < 2)
+	{
+		std::cout << "Match ended during warmup, try fewer warmup frames" << std::endl;
+		clearWorld(w);
+		SDL_FreeSurface(surface);
+		return 1;
+	}
+	std::cout << w.tiles_[0].size() << "x" << w.tiles_.size() << " map, " << w.units_.size() << " units, " << w.factories_.size() << " factories after " << warmupFrames << " frames" << std::endl;
+	double frequency = double(SDL_GetPerformanceFrequency());
+
+	world scratch;
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (int i = 0; i < clones; i++) cloneWorld(w, scratch);
+	double elapsed = (SDL_GetPerformanceCounter() - start) / frequency;
+	std::cout << "clone: " << elapsed * 1e6 / clones << " us per clone (" << clones / elapsed << " clones/s)" << std::endl;
+
+	std::mt19937 gen(seed);
+	mctsOrder idle = { -1, false, 0, 0, 0 };
+	start = SDL_GetPerformanceCounter();
+	for (int i = 0; i < rollouts; i++) rollout(w, 0, idle, scratch, gen, UINT64_MAX);
+	elapsed = (SDL_GetPerformanceCounter() - start) / frequency;
+	std::cout << "rollout: " << elapsed * 1e3 / rollouts << " ms per " << mctsRolloutFrames << " frame rollout (" << rollouts / elapsed << " rollouts/s, " << rollouts * (double)mctsRolloutFrames / elapsed << " frames/s)" << std::endl;
+	clearWorld(scratch);
+
+	// Decide on copies, so every decision sees the same position
+	int played = 0;
+	start = SDL_GetPerformanceCounter();
+	for (int i = 0; i < decisions; i++)
+	{
+		world position;
+		cloneWorld(w, position);
+		position.verbose_ = false;
+		position.rng_.seed(seed + i);
+		player* playerPtr = position.players_[0];
+		playerPtr->deadline_ = SDL_GetPerformanceCounter() + (Uint64)(playerPtr->budgetUs_ * frequency / 1000000);
+		played += mctsAct(position, playerPtr);
+		clearWorld(position);
+	}
+	elapsed = (SDL_GetPerformanceCounter() - start) / frequency;
+	std::cout << "decision: " << played / (double)decisions << " rollouts per decision, " << elapsed * 1e3 / decisions << " ms per decision (budget " << aiDefaultBudgetUs / 1000.0 << " ms)" << std::endl;
+
+	clearWorld(w);
+	SDL_FreeSurface(surface);
+	return 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "main.h"
+struct world;
+struct player;
+
+/* Monte Carlo search AI (Strategy::mcts)
+Flat search: the root's children are a dozen candidate orders for this player's units plus doing nothing, picked
+between with UCB1. Each rollout clones the world, applies one candidate and plays every player forward with the
+balanced strategy, then scores the material balance. Rollouts only start before the player's deadline, less a slice
+for issuing the order, and a rollout still running then is dropped. The most visited order is issued.
+Rollouts run in a world the player keeps between decisions, a copy whose counters never reach the process-wide metrics.
+*/
+const int mctsRolloutFrames = 120; // three simulated seconds
+const int mctsMaxCandidates = 12;
+
+// Decides and issues one order for playerPtr, returns how many rollouts were played
+int mctsAct(world& w, player* playerPtr);
+// --mcts-bench <map> [--warmup frames --clones n --rollouts n --decisions n --seed s]
+// Measures clone time, rollout throughput and rollouts per decision on a match between two balanced players
+int runMctsBench(const std::string& mapPath, int argc, char** args, int first);
@@ -0,0 +1,152 @@
+#include "metrics.h"
+#include "world.h"
+#include "player.h"
+#include <mutex>
+#include <sstream>
+#include <iomanip>
+
+metricsRegistry metrics;
+const char* const simPhaseNames[simPhaseCount] = { "spawn", "ai", "combat", "units", "deaths", "fog", "win" };
+
+static std::mutex metricsFileLock;
+static std::ofstream metricsFile;
+static metricsRate metricsFileRate;
+static int metricsFileTeams = 0;
+
+metricsCounters::metricsCounters()
+{
+	frames_ = 0;
+	astarCalls_ = 0;
+	astarNodes_ = 0;
+	astarFailed_ = 0;
+	astarTicks_ = 0;
+	for (auto& count : navigates_) count = 0;
+	combatChecks_ = 0;
+	blocked_ = 0;
+	for (auto& ticks : phaseTicks_) ticks = 0;
+}
+
+metricsRate::metricsRate()
+{
+	lastFrames_ = 0;
+	lastCounter_ = 0;
+	perSecond_ = 0;
+}
+
+void metricsRate::update(Uint64 frames, Uint64 now)
+{
+	if (lastCounter_ != 0 && now > lastCounter_) perSecond_ = (frames - lastFrames_) * double(SDL_GetPerformanceFrequency()) / (now - lastCounter_);
+	lastFrames_ = frames;
+	lastCounter_ = now;
+}
+
+Uint64 metricsPhaseDone(world& w, simPhase phase, Uint64 start)
+{
+	Uint64 now = SDL_GetPerformanceCounter();
+	countMetric(w.metrics_.phaseTicks_[phase], now - start);
+	return now;
+}
+
+static double astarMeanUs(Uint64 calls, Uint64 ticks)
+{
+	return calls > 0 ? ticks * 1e6 / double(SDL_GetPerformanceFrequency()) / calls : 0;
+}
+
+static void addToTotal(std::atomic<Uint64>& total, Uint64 count, Uint64& counted)
+{
+	if (count != counted) total.fetch_add(count - counted, std::memory_order_relaxed);
+	counted = count;
+}
+
+// Returns the frame total after adding w's frames
+static Uint64 addToTotals(world& w)
+{
+	const metricsCounters& now = w.metrics_;
+	metricsCounters& counted = w.metricsCounted_;
+	Uint64 frames = metrics.frames_.fetch_add(now.frames_ - counted.frames_, std::memory_order_relaxed) + now.frames_ - counted.frames_;
+	counted.frames_ = now.frames_;
+	addToTotal(metrics.astarCalls_, now.astarCalls_, counted.astarCalls_);
+	addToTotal(metrics.astarNodes_, now.astarNodes_, counted.astarNodes_);
+	addToTotal(metrics.astarFailed_, now.astarFailed_, counted.astarFailed_);
+	addToTotal(metrics.astarTicks_, now.astarTicks_, counted.astarTicks_);
+	for (int team = 0; team < metricsMaxTeams; team++) addToTotal(metrics.navigates_[team], now.navigates_[team], counted.navigates_[team]);
+	addToTotal(metrics.combatChecks_, now.combatChecks_, counted.combatChecks_);
+	addToTotal(metrics.blocked_, now.blocked_, counted.blocked_);
+	for (int phase = 0; phase < simPhaseCount; phase++) addToTotal(metrics.phaseTicks_[phase], now.phaseTicks_[phase], counted.phaseTicks_[phase]);
+	return frames;
+}
+
+void flushMetrics(world& w)
+{
+	if (w.countsToTotals_) addToTotals(w);
+}
+
+bool dumpMetricsTo(const std::string& path)
+{
+	std::lock_guard<std::mutex> guard(metricsFileLock);
+	metricsFile.open(path);
+	if (!metricsFile)
+	{
+		std::cout << "Could not open " << path << " for writing" << std::endl;
+		return false;
+	}
+	metricsFileTeams = 0;
+	return true;
+}
+
+void metricsFrameDone(world& w)
+{
+	w.metrics_.frames_++;
+	if (w.metrics_.frames_ % metricsSampleFrames != 0 || !w.countsToTotals_) return;
+	Uint64 frames = addToTotals(w);
+	if (!metricsFile.is_open()) return;
+	std::lock_guard<std::mutex> guard(metricsFileLock);
+	metricsFileRate.update(frames, SDL_GetPerformanceCounter());
+	// Columns are fixed by the first row, players joining later are still counted in the total
+	if (metricsFileTeams == 0)
+	{
+		metricsFileTeams = std::max(1, std::min(metricsMaxTeams, (int)w.players_.size()));
+		metricsFile << "frames,ticks_per_s,astar_calls,astar_nodes,astar_failed,astar_us_mean,navigates,units,factories,combat_checks,blocked";
+		for (int team = 0; team < metricsFileTeams; team++) metricsFile << ",navigates_team" << team;
+		metricsFile << std::endl;
+	}
+	Uint64 navigates = 0;
+	for (int team = 0; team < metricsMaxTeams; team++) navigates += metrics.navigates_[team].load(std::memory_order_relaxed);
+	metricsFile << frames << "," << metricsFileRate.perSecond_ << "," << metrics.astarCalls_.load(std::memory_order_relaxed) << ","
+		<< metrics.astarNodes_.load(std::memory_order_relaxed) << "," << metrics.astarFailed_.load(std::memory_order_relaxed) << ","
+		<< astarMeanUs(metrics.astarCalls_.load(std::memory_order_relaxed), metrics.astarTicks_.load(std::memory_order_relaxed)) << "," << navigates << "," << w.units_.size() << "," << w.factories_.size() << ","
+		<< metrics.combatChecks_.load(std::memory_order_relaxed) << "," << metrics.blocked_.load(std::memory_order_relaxed);
+	for (int team = 0; team < metricsFileTeams; team++) metricsFile << "," << metrics.navigates_[team].load(std::memory_order_relaxed);
+	metricsFile << std::endl;
+}
+
+void describeMetrics(const world& w, const metricsRate& rate, std::vector<std::string>& lines)
+{
+	lines.clear();
+	std::stringstream line;
+	line << std::fixed << std::setprecision(1);
+	line << "TICKS/S " << rate.perSecond_;
+	lines.push_back(line.str());
+	line.str("");
+	line << "ASTAR " << w.metrics_.astarCalls_ << " FAILED " << w.metrics_.astarFailed_;
+	lines.push_back(line.str());
+	line.str("");
+	line << "NODES " << w.metrics_.astarNodes_ << " US/SEARCH " << astarMeanUs(w.metrics_.astarCalls_, w.metrics_.astarTicks_);
+	lines.push_back(line.str());
+	line.str("");
+	line << "UNITS " << w.units_.size() << " FACTORIES " << w.factories_.size();
+	lines.push_back(line.str());
+	line.str("");
+	line << "COMBAT CHECKS " << w.metrics_.combatChecks_;
+	lines.push_back(line.str());
+	line.str("");
+	line << "BLOCKED " << w.metrics_.blocked_;
+	lines.push_back(line.str());
+	for (auto playerPtr : w.players_)
+	{
+		if (playerPtr->team_ < 0 || playerPtr->team_ >= metricsMaxTeams) continue;
+		line.str("");
+		line << "PLAYER " << playerPtr->team_ << " NAVIGATES " << w.metrics_.navigates_[playerPtr->team_];
+		lines.push_back(line.str());
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "main.h"
+#include <atomic>
+struct world;
+
+/* Simulation counters
+Every world counts into its own metricsCounters, plain integers since only one thread steps a world at a time, so
+tournament and server threads never share a cache line while counting. Hot loops count locally and add once per call.
+Once per sample a world adds what it counted since the last sample to the process-wide totals, the only atomics, which
+the CSV dump reads. Copies made with cloneWorld, such as MCTS rollouts, keep their counts to themselves.
+Counters only ever grow; rates and means are worked out from two samples.
+*/
+const int metricsMaxTeams = 16; // navigate counts are kept per team id below this
+const int metricsSampleFrames = 40; // one simulated second of headless frames between CSV rows
+
+// The parts of stepWorld, in the order they run
+enum simPhase
+{
+	phaseSpawn,
+	phaseAi,
+	phaseCombat,
+	phaseUnits,
+	phaseDeaths,
+	phaseFog,
+	phaseWin,
+	simPhaseCount
+};
+extern const char* const simPhaseNames[simPhaseCount];
+
+struct metricsCounters
+{
+	metricsCounters();
+	Uint64 frames_; // stepWorld calls
+	Uint64 astarCalls_;
+	Uint64 astarNodes_; // tiles expanded
+	Uint64 astarFailed_; // searches that emptied the open list
+	Uint64 astarTicks_; // performance counter ticks spent searching
+	Uint64 navigates_[metricsMaxTeams];
+	Uint64 combatChecks_; // targets a fighter looked at
+	Uint64 blocked_; // moves unit::advance could not make because the next tile was taken
+	Uint64 phaseTicks_[simPhaseCount]; // performance counter ticks stepWorld spent in each phase
+};
+
+// Totals over every world that counts toward them, same fields as metricsCounters
+struct metricsRegistry
+{
+	std::atomic<Uint64> frames_; // stepWorld calls
+	std::atomic<Uint64> astarCalls_;
+	std::atomic<Uint64> astarNodes_; // tiles expanded
+	std::atomic<Uint64> astarFailed_; // searches that emptied the open list
+	std::atomic<Uint64> astarTicks_; // performance counter ticks spent searching
+	std::atomic<Uint64> navigates_[metricsMaxTeams];
+	std::atomic<Uint64> combatChecks_; // targets a fighter looked at
+	std::atomic<Uint64> blocked_; // moves unit::advance could not make because the next tile was taken
+	std::atomic<Uint64> phaseTicks_[simPhaseCount]; // performance counter ticks stepWorld spent in each phase
+};
+
+extern metricsRegistry metrics;
+
+inline void countMetric(Uint64& counter, Uint64 amount = 1)
+{
+	counter += amount;
+}
+
+// Adds the time since start to phase and returns the current performance counter, to start the next phase with
+Uint64 metricsPhaseDone(world& w, simPhase phase, Uint64 start);
+
+// Frames per second of wall time, over whatever interval lies between two updates
+struct metricsRate
+{
+	metricsRate();
+	void update(Uint64 frames, Uint64 now);
+	Uint64 lastFrames_;
+	Uint64 lastCounter_;
+	double perSecond_;
+};
+
+// Called at the end of stepWorld. Every metricsSampleFrames frames of a world its counts go into the totals, and a CSV
+// row is written when a dump file is open.
+void metricsFrameDone(world& w);
+// Adds what w counted since its last sample to the totals, for a world that is about to be cleared
+void flushMetrics(world& w);
+// --metrics <file.csv>: dumps the counters to path for the rest of the run. Rows hold totals, with the units and
+// factories of the world that happened to finish the sampled frame.
+bool dumpMetricsTo(const std::string& path);
+// The counters of one world as text lines, for the overlay and the R key
+void describeMetrics(const world& w, const metricsRate& rate, std::vector<std::string>& lines);
@@ -0,0 +1,161 @@
+#include "minerassign.h"
+#include "world.h"
+#include "tile.h"
+#include "unit.h"
+#include "player.h"
+
+// Forward auction, benefits scaled by (miners + 1) so an increment of 1 gives an optimal assignment.
+// Every miner can also settle for staying idle at benefit 0, which never runs out.
+static void auction(minerScratch& scratch, int miners, int resources, int maxDistance)
+{
+	const std::vector<minerEdge>& edges = scratch.edges_;
+	// Group the edges by miner, counting sort keeps them in sweep order within a miner
+	std::vector<int>& edgeStart = scratch.edgeStart_;
+	std::vector<int>& edgeOrder = scratch.edgeOrder_;
+	edgeStart.assign(miners + 1, 0);
+	for (auto& edge : edges) edgeStart[edge.miner_ + 1]++;
+	for (int m = 0; m < miners; m++) edgeStart[m + 1] += edgeStart[m];
+	edgeOrder.resize(edges.size());
+	std::vector<int>& fill = scratch.waiting_;
+	fill.assign(edgeStart.begin(), edgeStart.end() - 1);
+	for (int e = 0; e < (int)edges.size(); e++) edgeOrder[fill[edges[e].miner_]++] = e;
+
+	Sint64 scale = miners + 1;
+	std::vector<Sint64>& prices = scratch.prices_;
+	std::vector<int>& owners = scratch.owners_;
+	std::vector<int>& assigned = scratch.assigned_;
+	std::vector<int>& waiting = scratch.waiting_;
+	prices.assign(resources, 0);
+	owners.assign(resources, -1);
+	assigned.assign(miners, -1);
+	waiting.clear();
+	for (int m = miners - 1; m >= 0; m--) waiting.push_back(m);
+	while (waiting.size() > 0)
+	{
+		int miner = waiting.back();
+		waiting.pop_back();
+		// Best and second best value, idle being worth 0
+		int bestEdge = -1;
+		Sint64 best = 0;
+		Sint64 second = 0;
+		for (int k = edgeStart[miner]; k < edgeStart[miner + 1]; k++)
+		{
+			int e = edgeOrder[k];
+			Sint64 value = (maxDistance + 1 - edges[e].distance_) * scale - prices[edges[e].resource_];
+			if (value > best)
+			{
+				second = best;
+				best = value;
+				bestEdge = e;
+			}
+			else if (value > second) second = value;
+		}
+		if (bestEdge < 0) continue;
+		int resource = edges[bestEdge].resource_;
+		prices[resource] += best - second + 1;
+		if (owners[resource] >= 0)
+		{
+			assigned[owners[resource]] = -1;
+			waiting.push_back(owners[resource]);
+		}
+		owners[resource] = miner;
+		assigned[miner] = resource;
+	}
+}
+
+int assignMiners(world& w, player* playerPtr, Uint64 deadline)
+{
+	minerScratch& scratch = w.minerScratch_;
+	std::vector<unit*>& idle = scratch.idle_;
+	std::vector<char>& targeted = scratch.targeted_;
+	int height = w.tiles_.size();
+	int width = w.tiles_[0].size();
+	idle.clear();
+	targeted.assign((size_t)width * height, 0);
+	for (auto unitPtr : playerPtr->ofType_[unitMiner])
+	{
+		if (unitPtr->tileAt_->state_ == 2) continue;
+		// A cooperative path ends with its window, short of the goal, and may be empty while the miner waits
+		tile* goal = coopGoal(w, unitPtr->id_);
+		if (goal == NULL && unitPtr->path_.size() > 0) goal = unitPtr->path_.front();
+		if (goal != NULL) targeted[goal->y_ * width + goal->x_] = 1;
+		else idle.push_back(unitPtr);
+	}
+	if (idle.size() == 0) return 0;
+	bool anyResources = false;
+	for (auto& chunk : w.chunks_.chunks_) anyResources = anyResources || chunk.hasResources();
+	if (!anyResources) return 0;
+
+	// Multi-source sweep, each tile settled by up to minerCandidates different miners
+	bucketQueue<std::pair<int, int>>& open = scratch.open_;
+	std::vector<Uint8>& settledCount = scratch.settledCount_;
+	std::vector<int>& settledBy = scratch.settledBy_;
+	std::vector<int>& resourceIndex = scratch.resourceIndex_;
+	std::vector<tile*>& resources = scratch.resources_;
+	std::vector<minerEdge>& edges = scratch.edges_;
+	open.clear();
+	settledCount.assign((size_t)width * height, 0);
+	settledBy.resize((size_t)width * height * minerCandidates);
+	resourceIndex.resize((size_t)width * height, -1);
+	resources.clear();
+	edges.clear();
+	int maxDistance = 0;
+	for (int m = 0; m < (int)idle.size(); m++)
+	{
+		tile* start = idle[m]->tileAt_;
+		open.push(0, std::make_pair(start->y_ * width + start->x_, m));
+	}
+	int pops = 0;
+	while (open.size() > 0)
+	{
+		// Past the deadline, assign with the candidates found so far
+		if (++pops % 1024 == 0 && SDL_GetPerformanceCounter() >= deadline) break;
+		int distance;
+		std::pair<int, int> current = open.pop(distance);
+		int index = current.first;
+		int miner = current.second;
+		int* settled = &settledBy[index * minerCandidates];
+		if (settledCount[index] >= minerCandidates || std::find(settled, settled + settledCount[index], miner) != settled + settledCount[index]) continue;
+		settled[settledCount[index]++] = miner;
+
+		tile* tilePtr = w.tiles_[index / width][index % width];
+		if (tilePtr->state_ == 2 && tilePtr->unitAt_ == NULL && !targeted[index] && isExplored(playerPtr, tilePtr))
+		{
+			if (resourceIndex[index] < 0)
+			{
+				resourceIndex[index] = resources.size();
+				resources.push_back(tilePtr);
+			}
+			minerEdge edge = { miner, resourceIndex[index], distance };
+			edges.push_back(edge);
+			maxDistance = std::max(maxDistance, distance);
+		}
+		for (int i = -1; i <= 1; i++)
+		{
+			for (int j = -1; j <= 1; j++)
+			{
+				if (i == 0 && j == 0) continue;
+				int ni = tilePtr->y_ + i;
+				int nj = tilePtr->x_ + j;
+				if (ni < 0 || nj < 0 || ni >= height || nj >= width) continue;
+				tile* neighbor = w.tiles_[ni][nj];
+				int next = ni * width + nj;
+				if (neighbor->state_ == 1 || neighbor->state_ == 3 || settledCount[next] >= minerCandidates) continue;
+				open.push(distance + neighbor->stepCost(tilePtr), std::make_pair(next, miner));
+			}
+		}
+	}
+	// Only the resources found were marked, unmark just those for the next call
+	for (auto resource : resources) resourceIndex[resource->y_ * width + resource->x_] = -1;
+	if (edges.size() == 0) return 0;
+
+	auction(scratch, idle.size(), resources.size(), maxDistance);
+	int sent = 0;
+	for (int m = 0; m < (int)idle.size(); m++)
+	{
+		if (scratch.assigned_[m] < 0) continue;
+		idle[m]->navigate(w, resources[scratch.assigned_[m]]);
+		sent++;
+	}
+	return sent;
+}
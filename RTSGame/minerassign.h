@@ -0,0 +1,45 @@
+#pragma once
+#include "main.h"
+#include "bucketqueue.h"
+struct world;
+struct player;
+struct unit;
+struct tile;
+
+/* Batch miner assignment
+Idle miners (not on a resource, no path) are matched to open resource tiles all at once instead of one random pair per act.
+A single Dijkstra sweep seeded from every idle miner at once lets each tile be settled by its minerCandidates nearest
+miners, which gives every reachable resource a short list of (miner, distance) candidates. An auction over those
+lists finds the assignment with the least total walking, with staying idle as a fallback option so it always terminates.
+*/
+const int minerCandidates = 4;
+
+struct minerEdge
+{
+	int miner_;
+	int resource_; // index into the resource list
+	int distance_;
+};
+
+// Buffers assignMiners refills on every call, kept on the world so assigning doesn't allocate
+struct minerScratch
+{
+	std::vector<unit*> idle_;
+	std::vector<char> targeted_; // per tile, resources some miner of this player is already walking to
+	bucketQueue<std::pair<int, int>> open_; // tile index and miner, by distance
+	std::vector<Uint8> settledCount_; // per tile
+	std::vector<int> settledBy_; // per tile, minerCandidates slots
+	std::vector<int> resourceIndex_; // per tile, position in resources_ or -1
+	std::vector<tile*> resources_;
+	std::vector<minerEdge> edges_;
+	// Auction
+	std::vector<int> edgeStart_; // edges of miner m are edgeOrder_[edgeStart_[m], edgeStart_[m + 1])
+	std::vector<int> edgeOrder_;
+	std::vector<Sint64> prices_;
+	std::vector<int> owners_;
+	std::vector<int> waiting_;
+	std::vector<int> assigned_;
+};
+
+// Sends matched miners on their way, stops sweeping at deadline (performance counter). Returns how many were sent.
+int assignMiners(world& w, player* playerPtr, Uint64 deadline);
@@ -0,0 +1,66 @@
+#include "overlay.h"
+
+struct overlayGlyph
+{
+	char character_;
+	const char* rows_; // five rows of three dots, top to bottom, '1' is lit
+};
+
+static const overlayGlyph overlayFont[] =
+{
+	{ '0', "111101101101111" }, { '1', "010110010010111" }, { '2', "111001111100111" }, { '3', "111001111001111" },
+	{ '4', "101101111001001" }, { '5', "111100111001111" }, { '6', "111100111101111" }, { '7', "111001001001001" },
+	{ '8', "111101111101111" }, { '9', "111101111001111" },
+	{ 'A', "010101111101101" }, { 'B', "110101110101110" }, { 'C', "011100100100011" }, { 'D', "110101101101110" },
+	{ 'E', "111100110100111" }, { 'F', "111100110100100" }, { 'G', "011100101101011" }, { 'H', "101101111101101" },
+	{ 'I', "111010010010111" }, { 'J', "001001001101010" }, { 'K', "101101110101101" }, { 'L', "100100100100111" },
+	{ 'M', "101111111101101" }, { 'N', "110101101101101" }, { 'O', "010101101101010" }, { 'P', "110101110100100" },
+	{ 'Q', "010101101110011" }, { 'R', "110101110101101" }, { 'S', "011100010001110" }, { 'T', "111010010010010" },
+	{ 'U', "101101101101111" }, { 'V', "101101101101010" }, { 'W', "101101111111101" }, { 'X', "101101010101101" },
+	{ 'Y', "101101010010010" }, { 'Z', "111001010100111" },
+	{ '.', "000000000000010" }, { ':', "000010000010000" }, { '/', "001001010100100" }, { '-', "000000111000000" },
+	{ '%', "101001010100101" }
+};
+
+static const char* glyphRows(char character)
+{
+	for (auto& glyph : overlayFont)
+	{
+		if (glyph.character_ == character) return glyph.rows_;
+	}
+	return NULL;
+}
+
+void drawOverlay(SDL_Surface* winSurface, const std::vector<std::string>& lines)
+{
+	int advance = 4 * overlayScale; // three dots and a gap
+	int lineHeight = 7 * overlayScale;
+	int longest = 0;
+	for (auto& line : lines) longest = std::max(longest, (int)line.size());
+	SDL_Rect backing;
+	backing.w = longest * advance + 4 * overlayScale;
+	backing.h = lines.size() * lineHeight + 3 * overlayScale;
+	backing.x = winSurface->w - backing.w;
+	backing.y = 0;
+	SDL_FillRect(winSurface, &backing, SDL_MapRGB(winSurface->format, 20, 20, 20));
+
+	Uint32 color = SDL_MapRGB(winSurface->format, 255, 255, 255);
+	SDL_Rect dot;
+	dot.w = overlayScale;
+	dot.h = overlayScale;
+	for (int l = 0; l < (int)lines.size(); l++)
+	{
+		for (int c = 0; c < (int)lines[l].size(); c++)
+		{
+			const char* rows = glyphRows(lines[l][c]);
+			if (rows == NULL) continue;
+			for (int i = 0; i < 15; i++)
+			{
+				if (rows[i] != '1') continue;
+				dot.x = backing.x + 2 * overlayScale + c * advance + (i % 3) * overlayScale;
+				dot.y = 2 * overlayScale + l * lineHeight + (i / 3) * overlayScale;
+				SDL_FillRect(winSurface, &dot, color);
+			}
+		}
+	}
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "main.h"
+
+// Pixel size of one dot of the overlay's 3x5 font
+const int overlayScale = 2;
+
+// Draws lines of text in the top right corner of the surface on a dark backing, with a built in font made of
+// filled rectangles. Knows digits, capital letters, space and . : / - %, other characters are left blank.
+void drawOverlay(SDL_Surface* winSurface, const std::vector<std::string>& lines);
@@ -3,16 +3,22 @@
 #include "unit.h"
 #include "buildfactory.h"
 #include "main.h"
-#include <random>
-
-auto gen = std::mt19937{ std::random_device{}() };
+#include "world.h"
+#include "components.h"
+#include "mcts.h"
+#include "minerassign.h"
+#include "trace.h"
 
 player::player(int team, SDL_Surface& winSurface, bool human)
 {
 	resources_ = 0;
 	maxResources_ = 100;
-	strat_ = random;
+	strat_ = Strategy::balanced;
 	human_ = human;
+	team_ = team;
+	budgetUs_ = aiDefaultBudgetUs;
+	deadline_ = 0;
+	searchWorld_ = NULL;
 	/*switch (team)
 	{
 	case(0):
@@ -29,6 +35,13 @@ player::player(int team, SDL_Surface& winSurface, bool human)
 	color_ = teamColor(team, winSurface);
 }
 
+player::~player()
+{
+	if (searchWorld_ == NULL) return;
+	clearWorld(*searchWorld_);
+	delete searchWorld_;
+}
+
 Uint32 player::teamColor(int team, SDL_Surface &winSurface)
 {
 	// Decide what color this new team should be
@@ -81,113 +94,344 @@ Uint32 player::teamColor(int team, SDL_Surface &winSurface)
 	exit(1);*/
 }
 
+const char* strategyName(Strategy strat)
+{
+	switch (strat)
+	{
+	case(Strategy::random):
+		return "random";
+	case(Strategy::turtle):
+		return "turtle";
+	case(Strategy::balanced):
+		return "balanced";
+	case(Strategy::aggro):
+		return "aggro";
+	case(Strategy::mcts):
+		return "mcts";
+	}
+	return "unknown";
+}
+
+bool parseStrategy(const std::string& name, Strategy& strat)
+{
+	for (int i = 0; i < strategyCount; i++)
+	{
+		if (name == strategyName((Strategy)i))
+		{
+			strat = (Strategy)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+aiStats::aiStats()
+{
+	decisions_ = 0;
+	overruns_ = 0;
+	totalUs_ = 0;
+	worstUs_ = 0;
+}
+
+void aiStats::record(double us, int budgetUs)
+{
+	decisions_++;
+	totalUs_ += us;
+	worstUs_ = std::max(worstUs_, us);
+	if (us > budgetUs) overruns_++;
+}
+
+void printAiStats(const std::vector<player*>& players)
+{
+	for (auto playerPtr : players)
+	{
+		if (playerPtr->human_) continue;
+		const aiStats& stats = playerPtr->stats_;
+		std::cout << "Player " << playerPtr->team_ << " (" << strategyName(playerPtr->strat_) << "): " << stats.decisions_ << " decisions, ";
+		std::cout << (stats.decisions_ > 0 ? stats.totalUs_ / stats.decisions_ : 0) << " us mean, " << stats.worstUs_ << " us worst, ";
+		std::cout << stats.overruns_ << " over the " << playerPtr->budgetUs_ << " us budget" << std::endl;
+	}
+}
+
 enum moveTypes {moveFighter, moveBuilder, buildFactory, moveMiner};
 
-void player::act(std::list<unit*>& units, std::list<tile*>& factories, std::vector<std::vector<tile*>>& tiles, SDL_Surface* winSurface, SDL_Window* window)
+// How a strategy weighs its options, indexed by Strategy, mcts searches instead
+struct strategyProfile
+{
+	int moveWeights_[4]; // relative odds of each moveTypes entry
+	int factoryWeights_[3]; // relative odds of building a fighter, builder or miner factory
+	bool useInfluence_; // false picks move targets uniformly
+	bool assignMiners_; // false sends one random miner to one random resource
+	// Target scores are weighted sums of the influence maps
+	float fighterPressure_;
+	float fighterCoverage_;
+	float builderResources_;
+	float builderPressure_;
+	float builderCoverage_;
+	int explorePercent_; // share of fighter and builder moves that head for the edge of explored ground instead
+};
+
+static const strategyProfile strategyProfiles[] =
+{
+	// random: uniform everything, the original AI
+	{ { 1, 1, 1, 1 }, { 1, 1, 1 }, false, false, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0 },
+	// turtle: mine and fortify, fighters guard their own factories, builders stay on covered ground, rarely scouting
+	{ { 1, 2, 3, 3 }, { 1, 1, 2 }, true, true, 0.25f, 1.0f, 1.0f, -2.0f, 1.0f, 10 },
+	// balanced: fighters go where enemies gather, builders expand toward free resources away from enemies and existing factories
+	{ { 1, 1, 1, 1 }, { 1, 1, 1 }, true, true, 1.0f, 0.0f, 1.0f, -1.0f, -1.0f, 30 },
+	// aggro: mostly fighters, hunting enemy concentrations and scouting for them, builders push forward
+	{ { 3, 1, 1, 1 }, { 3, 1, 1 }, true, true, 2.0f, 0.0f, 1.0f, 0.5f, -1.0f, 40 },
+};
+
+// Samples one tile out of candidates, only considering tiles in the same connected component as from. NULL if there is none.
+static tile* sampleReachable(const std::vector<tile*>& candidates, const tile* from, std::mt19937& gen)
+{
+	int reachable = 0;
+	for (auto tilePtr : candidates)
+	{
+		if (sameComponent(from, tilePtr)) reachable++;
+	}
+	if (reachable == 0) return NULL;
+	std::uniform_int_distribution<> distrib(0, reachable - 1);
+	int pick = distrib(gen);
+	for (auto tilePtr : candidates)
+	{
+		if (sameComponent(from, tilePtr) && pick-- == 0) return tilePtr;
+	}
+	return NULL;
+}
+
+// How many reachable candidates are rated when picking a target by influence
+const int influenceSamples = 8;
+
+// Samples up to influenceSamples reachable candidates and returns the one score rates highest, NULL if none is reachable.
+// Past the deadline it settles for what it has sampled so far, once it has at least one.
+template <typename Score>
+static tile* sampleBestReachable(const std::vector<tile*>& candidates, const tile* from, std::mt19937& gen, Score score, Uint64 deadline)
 {
-	switch (strat_) 
+	tile* sampled[influenceSamples];
+	int seen = 0;
+	int scanned = 0;
+	for (auto tilePtr : candidates)
+	{
+		if (++scanned % 256 == 0 && seen > 0 && SDL_GetPerformanceCounter() >= deadline) break;
+		if (!sameComponent(from, tilePtr)) continue;
+		if (seen < influenceSamples) sampled[seen] = tilePtr;
+		else
+		{
+			std::uniform_int_distribution<> distrib(0, seen);
+			int slot = distrib(gen);
+			if (slot < influenceSamples) sampled[slot] = tilePtr;
+		}
+		seen++;
+	}
+	int count = std::min(seen, influenceSamples);
+	if (count == 0) return NULL;
+	tile* best = sampled[0];
+	float bestScore = score(best);
+	for (int i = 1; i < count; i++)
+	{
+		float candidateScore = score(sampled[i]);
+		if (candidateScore > bestScore)
+		{
+			best = sampled[i];
+			bestScore = candidateScore;
+		}
+	}
+	return best;
+}
+
+// Index drawn with odds proportional to weights, like std::discrete_distribution but without allocating its table.
+// -1 if every weight is zero.
+static int weightedPick(const int* weights, int count, std::mt19937& gen)
+{
+	int total = 0;
+	for (int i = 0; i < count; i++) total += weights[i];
+	if (total <= 0) return -1;
+	std::uniform_int_distribution<> distrib(0, total - 1);
+	int pick = distrib(gen);
+	for (int i = 0; i < count; i++)
+	{
+		if (pick < weights[i]) return i;
+		pick -= weights[i];
+	}
+	return count - 1;
+}
+
+template <typename Item>
+static Item pickOne(const std::vector<Item>& items, std::mt19937& gen)
+{
+	std::uniform_int_distribution<> distrib(0, items.size() - 1);
+	return items[distrib(gen)];
+}
+
+void player::unitJoined(unit* unitPtr)
+{
+	units_.push_back(unitPtr);
+	ofType_[unitPtr->type_].push_back(unitPtr);
+}
+
+bool player::unitLeft(unit* unitPtr)
+{
+	std::list<unit*>::iterator it = std::find(units_.begin(), units_.end(), unitPtr);
+	if (it == units_.end()) return false;
+	units_.erase(it);
+	std::vector<unit*>& bucket = ofType_[unitPtr->type_];
+	bucket.erase(std::find(bucket.begin(), bucket.end(), unitPtr));
+	return true;
+}
+
+void player::act(world& w)
+{
+	traceScope scope("act");
+	std::vector<std::vector<tile*>>& tiles = w.tiles_;
+	std::mt19937& gen = w.rng_;
+	if (strat_ == Strategy::mcts)
+	{
+		mctsAct(w, this);
+		return;
+	}
+	const strategyProfile& profile = strategyProfiles[(int)strat_];
 	{
-	case(random):
-		double r = rand() / double(RAND_MAX);
 		// Possible moves are:
 		// Move fighter (randomly): if this team has a fighter, if there is a valid destination
 		// Move builder (randomly): if this team has a builder, if there is a valid destination
 		// Builder builds factory: if there are not more factories than 2x active miners and valid builder to build a factory
 		// Miner moves to resource: if there is a valid miner and a valid resource
-		std::list<unit*> fighters;
-		std::list<unit*> builders;
-		std::list<unit*> miners;
-		std::list<unit*> activeMiners;
-		std::list<tile*> openTiles;
-		std::list<tile*> openResources;
-		std::list<tile*> teamFactories;
-		for (auto unitPtr : units_)
+		actScratch& scratch = w.actScratch_;
+		const std::vector<unit*>& fighters = ofType_[unitFighter];
+		const std::vector<unit*>& builders = ofType_[unitBuilder];
+		const std::vector<unit*>& miners = ofType_[unitMiner];
+		std::vector<tile*>& openTiles = scratch.openTiles_;
+		std::vector<tile*>& openResources = scratch.openResources_;
+		std::vector<tile*>& frontier = scratch.frontier_;
+		openTiles.clear();
+		openResources.clear();
+		frontier.clear();
+		size_t activeMiners = 0;
+		size_t teamFactories = 0;
+		for (auto unitPtr : miners)
 		{
-			if (unitPtr->type_ == 1) fighters.push_back(unitPtr);
-			if (unitPtr->type_ == 2) builders.push_back(unitPtr);
-			if (unitPtr->type_ == 3) miners.push_back(unitPtr);
-			if (unitPtr->type_ == 3 && unitPtr->tileAt_->state_ == 2) activeMiners.push_back(unitPtr);
+			if (unitPtr->tileAt_->state_ == 2) activeMiners++;
 		}
-		for (std::vector<std::vector<tile*>>::iterator tilesRowIt = tiles.begin(); tilesRowIt != tiles.end(); tilesRowIt++)
+		// Counted apart from the scan below, which the budget may cut short
+		for (auto factoryPtr : w.factories_)
 		{
-			for (std::vector<tile*>::iterator tilesColIt = (*tilesRowIt).begin(); tilesColIt != (*tilesRowIt).end(); tilesColIt++)
+			if (factoryPtr->claimedBy_ == this) teamFactories++;
+		}
+		// Rows are scanned from a random start, so when the budget cuts the scan short the partial lists aren't biased toward the top of the map
+		std::uniform_int_distribution<> rowDistrib(0, tiles.size() - 1);
+		int firstRow = rowDistrib(gen);
+		for (size_t scanned = 0; scanned < tiles.size(); scanned++)
+		{
+			if (scanned > 0 && SDL_GetPerformanceCounter() >= deadline_) break;
+			int r = (firstRow + scanned) % tiles.size();
+			std::vector<tile*>& row = tiles[r];
+			for (int c = 0; c < (int)row.size(); c++)
 			{
-				if (((*tilesColIt)->state_ == 0 || (*tilesColIt)->state_ == 2) && (*tilesColIt)->unitAt_ == NULL) openTiles.push_back(*tilesColIt);
-				if ((*tilesColIt)->claimedBy_ == this) teamFactories.push_back(*tilesColIt);
-				if ((*tilesColIt)->state_ == 2 && (*tilesColIt)->unitAt_ == NULL) openResources.push_back(*tilesColIt);
+				// Chunks of nothing but walls hold no ground, walls never change so this is never stale
+				if (c % chunkSize == 0 && w.chunks_.at(r / chunkSize, c / chunkSize).allWall())
+				{
+					c += chunkSize - 1;
+					continue;
+				}
+				tile* tilePtr = row[c];
+				// Targets only come from ground this player has seen
+				if (!isExplored(this, tilePtr)) continue;
+				if (tilePtr->walkable() && tilePtr->unitAt_ == NULL)
+				{
+					openTiles.push_back(tilePtr);
+					// A profile that never explores has no frontier, so it doesn't draw for exploring either
+					if (profile.explorePercent_ > 0 && onFrontier(w, this, tilePtr)) frontier.push_back(tilePtr);
+				}
+				if (tilePtr->state_ == 2 && tilePtr->unitAt_ == NULL) openResources.push_back(tilePtr);
 			}
 		}
+		// Once there is unexplored ground left, some moves go to the closest of a few frontier tiles to uncover more
+		std::uniform_int_distribution<> percent(0, 99);
+		auto exploreTarget = [&](const unit* unitPtr) -> tile*
+		{
+			if (frontier.size() == 0 || percent(gen) >= profile.explorePercent_) return NULL;
+			return sampleBestReachable(frontier, unitPtr->tileAt_, gen, [&](tile* tilePtr) { return -(float)unitPtr->tileAt_->distTo(tilePtr); }, deadline_);
+		};
 
 		bool canMoveFighter = fighters.size() > 0 && openTiles.size() > 0;
 		bool canMoveBuilder = builders.size() > 0 && openTiles.size() > 0;
-		bool canBuildFactory = builders.size() > 0 && (teamFactories.size() * 2) < activeMiners.size();
-		bool canMoveMiner = miners.size() > 0 && miners.size() > activeMiners.size() && openResources.size() > 0;
+		bool canBuildFactory = builders.size() > 0 && (teamFactories * 2) < activeMiners;
+		bool canMoveMiner = miners.size() > 0 && miners.size() > activeMiners && openResources.size() > 0;
 
 		int numValidMoves = 0;
 		if (canMoveFighter) numValidMoves++;
 		if (canMoveBuilder) numValidMoves++;
 		if (canBuildFactory) numValidMoves++;
 		if (canMoveMiner) numValidMoves++;
-		std::uniform_int_distribution<> factoryTypeDistrib(1, 3);
+		// Only valid moves get a chance, so there is always something to pick when numValidMoves > 0
+		int moveWeights[4];
+		moveWeights[moveFighter] = canMoveFighter ? profile.moveWeights_[moveFighter] : 0;
+		moveWeights[moveBuilder] = canMoveBuilder ? profile.moveWeights_[moveBuilder] : 0;
+		moveWeights[buildFactory] = canBuildFactory ? profile.moveWeights_[buildFactory] : 0;
+		moveWeights[moveMiner] = canMoveMiner ? profile.moveWeights_[moveMiner] : 0;
+		auto fighterScore = [&](const tile* tilePtr)
+		{
+			return profile.fighterPressure_ * enemyPressure(w, this, tilePtr) + profile.fighterCoverage_ * factoryCoverage(w, this, tilePtr);
+		};
+		auto builderScore = [&](const tile* tilePtr)
+		{
+			return profile.builderResources_ * resourceProximity(w, tilePtr) + profile.builderPressure_ * enemyPressure(w, this, tilePtr) + profile.builderCoverage_ * factoryCoverage(w, this, tilePtr);
+		};
 
-PICK_A_MOVE:
-		std::uniform_int_distribution<> distrib(0, 3);
-		int movePicker = distrib(gen);
+		int movePicker = -1;
+		if (numValidMoves > 0) movePicker = weightedPick(moveWeights, 4, gen);
 		switch (movePicker) 
 		{
 		case(moveFighter):
 			if (canMoveFighter)
 			{
-				std::list<unit*> pickedFighter;
-				std::list<tile*> pickedTile;
-				std::sample(fighters.begin(), fighters.end(), std::back_inserter(pickedFighter), 1, gen);
-				std::sample(openTiles.begin(), openTiles.end(), std::back_inserter(pickedTile), 1, gen);
-				if(pickedFighter.size() > 0 && pickedTile.size() > 0) pickedFighter.back()->navigate(tiles, units, pickedTile.back(), winSurface, window);
-				if (pickedFighter.size() == 0) std::cout << "Could not pick a fighter when trying to move fighter" << std::endl;
-				if (pickedTile.size() == 0) std::cout << "Could not pick a tile when trying to move fighter" << std::endl;
+				unit* pickedFighter = pickOne(fighters, gen);
+				tile* pickedTile = exploreTarget(pickedFighter);
+				if (pickedTile == NULL && profile.useInfluence_) pickedTile = sampleBestReachable(openTiles, pickedFighter->tileAt_, gen, fighterScore, deadline_);
+				else if (pickedTile == NULL) pickedTile = sampleReachable(openTiles, pickedFighter->tileAt_, gen);
+				if (pickedTile != NULL) pickedFighter->navigate(w, pickedTile);
+				else if (w.verbose_) std::cout << "Could not pick a reachable tile when trying to move fighter" << std::endl;
 			}
-			else goto PICK_A_MOVE;
 			break;
 		case(moveBuilder):
 			if (canMoveBuilder)
 			{
-				std::list<unit*> pickedBuilder;
-				std::list<tile*> pickedTile;
-				std::sample(builders.begin(), builders.end(), std::back_inserter(pickedBuilder), 1, gen);
-				std::sample(openTiles.begin(), openTiles.end(), std::back_inserter(pickedTile), 1, gen);
-				if(pickedBuilder.size() > 0 && pickedTile.size() > 0) pickedBuilder.back()->navigate(tiles, units, pickedTile.back(), winSurface, window);
-				if (pickedBuilder.size() == 0) std::cout << "Could not pick a builder while trying to move builder" << std::endl;
-				if (pickedTile.size() == 0) std::cout << "Could not pick a tile while trying to move builder" << std::endl;
+				unit* pickedBuilder = pickOne(builders, gen);
+				tile* pickedTile = exploreTarget(pickedBuilder);
+				if (pickedTile == NULL && profile.useInfluence_) pickedTile = sampleBestReachable(openTiles, pickedBuilder->tileAt_, gen, builderScore, deadline_);
+				else if (pickedTile == NULL) pickedTile = sampleReachable(openTiles, pickedBuilder->tileAt_, gen);
+				if (pickedTile != NULL) pickedBuilder->navigate(w, pickedTile);
+				else if (w.verbose_) std::cout << "Could not pick a reachable tile while trying to move builder" << std::endl;
 			}
-			else goto PICK_A_MOVE;
 			break;
 		case(buildFactory):
 			if (canBuildFactory)
 			{
-				std::list<unit*> pickedBuilder;
-				std::sample(builders.begin(), builders.end(), std::back_inserter(pickedBuilder), 1, gen);
-				int factoryType = factoryTypeDistrib(gen);
-				if(pickedBuilder.size()>0) pickedBuilder.back()->buildFactory(units, tiles, factories, winSurface, window, factoryType);
-				if (pickedBuilder.size() == 0) std::cout << "Could not pick a builder while trying to build factory" << std::endl;
+				unit* pickedBuilder = pickOne(builders, gen);
+				int factoryType = weightedPick(profile.factoryWeights_, 3, gen) + 1;
+				if (factoryType > 0) pickedBuilder->buildFactory(w, factoryType);
 			}
-			else goto PICK_A_MOVE;
 			break;
 		case(moveMiner):
-			if (canMoveMiner)
+			if (canMoveMiner && profile.assignMiners_)
+			{
+				// Every idle miner at once, matched to the closest free resources without two heading for the same one
+				assignMiners(w, this, deadline_);
+			}
+			else if (canMoveMiner)
 			{
-				std::list<unit*> pickedMiner;
-				std::list<tile*> pickedOpenResource;
-				std::sample(miners.begin(), miners.end(), std::back_inserter(pickedMiner), 1, gen);
-				std::sample(openResources.begin(), openResources.end(), std::back_inserter(pickedOpenResource), 1, gen);
-				if(pickedMiner.size() > 0 && pickedOpenResource.size() > 0) pickedMiner.back()->navigate(tiles, units, pickedOpenResource.back(), winSurface, window);
-				if (pickedMiner.size() == 0) std::cout << "Could not pick a miner while trying to move miner" << std::endl;
-				if (pickedOpenResource.size() == 0) std::cout << "Could not pick an open resource while trying to move miner" << std::endl;
+				unit* pickedMiner = pickOne(miners, gen);
+				tile* pickedOpenResource = sampleReachable(openResources, pickedMiner->tileAt_, gen);
+				if (pickedOpenResource != NULL) pickedMiner->navigate(w, pickedOpenResource);
+				else if (w.verbose_) std::cout << "Could not pick a reachable open resource while trying to move miner" << std::endl;
 			}
 		}
 		if (units_.size() == 1)
 		{
 			unit* unitPtr = units_.back();
-			if (unitPtr->type_ == 0) unitPtr->buildFactory(units, tiles, factories, winSurface, window, 2);
+			if (unitPtr->type_ == unitMain) unitPtr->buildFactory(w, unitBuilder);
 		}
 
 		/*
@@ -228,7 +472,7 @@ PICK_A_MOVE:
 						std::vector<std::vector<tile*>> paths;
 						for (std::list<tile*>::iterator resourceit = resourceTiles.begin(); resourceit != resourceTiles.end(); resourceit++)
 						{
-							std::vector<tile*> path = astar(winSurface, window, tiles, units, (*it)->tileAt_, *resourceit);
+							std::vector<tile*> path = astar(winSurface, window, tiles, (*it)->tileAt_, *resourceit);
 							if (path.size() == 0)
 							{
 								//std::cout << "Invalid AI miner path: empty" << std::endl;
@@ -273,7 +517,6 @@ PICK_A_MOVE:
 			std::system("pause");
 			exit(1);
 		}*/
-		break;
 	}
 }
 
@@ -1,17 +1,63 @@
+#pragma once
 #include "main.h"
+#include "influence.h"
+#include "fog.h"
+#include "archetype.h"
 struct unit;
 struct tile;
-enum Strategy { random, turtle, balanced, aggro };
+struct world;
+struct player;
+enum class Strategy { random, turtle, balanced, aggro, mcts };
+const int strategyCount = (int)Strategy::mcts + 1;
+const char* strategyName(Strategy strat);
+bool parseStrategy(const std::string& name, Strategy& strat);
+// One line per AI player: decisions, mean and worst latency, budget overruns
+void printAiStats(const std::vector<player*>& players);
+
+// How long a player's decisions took, measured by stepWorld around every act
+struct aiStats
+{
+	aiStats();
+	void record(double us, int budgetUs);
+	Uint64 decisions_;
+	Uint64 overruns_; // decisions that took longer than the budget
+	double totalUs_;
+	double worstUs_;
+};
+
+// Buffers player::act refills on every call, kept on the world so deciding doesn't allocate
+struct actScratch
+{
+	std::vector<tile*> openTiles_;
+	std::vector<tile*> openResources_;
+	std::vector<tile*> frontier_; // open tiles at the edge of explored ground
+};
+
+// Time an AI player may spend per act unless told otherwise
+const int aiDefaultBudgetUs = 20000;
 
 struct player // Parallel definitions in unit.cpp, tile.cpp, player.h
 {
 	bool human_;
+	int team_; // team number the color was picked from
 	player(int team, SDL_Surface &winSurface, bool human);
+	~player();
 	Uint32 teamColor(int team, SDL_Surface &winSurface);
 	Strategy strat_;
-	void act(std::list<unit*>& units, std::list<tile*>& factories, std::vector<std::vector<tile*>>& tiles, SDL_Surface* winSurface, SDL_Window* window);
+	void act(world& w);
 	int resources_;
 	int maxResources_;
 	Uint32 color_;
 	std::list<unit*> units_;
+	std::vector<unit*> ofType_[unitTypeCount]; // units_ split by type, each in the same order as in units_
+	// Keep units_ and ofType_ in step, unitLeft returns false if the unit wasn't on this team
+	void unitJoined(unit* unitPtr);
+	bool unitLeft(unit* unitPtr);
+	playerInfluence influence_;
+	playerFog fog_;
+	int budgetUs_; // time each act may take, past it the AI issues the best order it has found so far
+	Uint64 deadline_; // performance counter value the current act has to finish by
+	aiStats stats_;
+	world* searchWorld_; // what mcts plays rollouts in, kept between decisions so its memory is reused. NULL until the
+	                     // first search, never shared: cloneWorld gives each copied player its own.
 };
\ No newline at end of file
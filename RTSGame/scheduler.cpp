@@ -0,0 +1,168 @@
+#include "scheduler.h"
+
+workStealingPool::workStealingPool(int workers)
+{
+	pending_.store(0);
+	steals_.store(0);
+	for (int i = 0; i < std::max(1, workers); i++) deques_.push_back(std::unique_ptr<taskDeque>(new taskDeque()));
+	nextDeque_.store(0);
+	stopping_ = false;
+}
+
+workStealingPool::~workStealingPool()
+{
+	stop();
+}
+
+int workStealingPool::workers() const
+{
+	return deques_.size();
+}
+
+void workStealingPool::push(const poolTask& task, int worker)
+{
+	if (worker < 0 || worker >= (int)deques_.size()) worker = nextDeque_.fetch_add(1, std::memory_order_relaxed) % deques_.size();
+	// Counted before it is visible, so no worker can see the pool empty while the task is on its way in
+	pending_.fetch_add(1);
+	{
+		std::lock_guard<std::mutex> guard(deques_[worker]->lock_);
+		deques_[worker]->tasks_.push_back(task);
+	}
+	if (threads_.size() > 0)
+	{
+		// A started worker checks pending_ under idleLock_ before it sleeps, so it either sees the task or gets woken
+		{
+			std::lock_guard<std::mutex> guard(idleLock_);
+		}
+		idle_.notify_one();
+	}
+}
+
+bool workStealingPool::take(int worker, poolTask& task)
+{
+	{
+		taskDeque& own = *deques_[worker];
+		std::lock_guard<std::mutex> guard(own.lock_);
+		if (own.tasks_.size() > 0)
+		{
+			task = std::move(own.tasks_.back());
+			own.tasks_.pop_back();
+			return true;
+		}
+	}
+	// Victims are tried starting next door, so thieves spread out instead of all hitting worker 0
+	int count = deques_.size();
+	for (int i = 1; i < count; i++)
+	{
+		taskDeque& victim = *deques_[(worker + i) % count];
+		std::lock_guard<std::mutex> guard(victim.lock_);
+		if (victim.tasks_.size() > 0)
+		{
+			task = std::move(victim.tasks_.front());
+			victim.tasks_.pop_front();
+			steals_.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+void workStealingPool::run()
+{
+	std::vector<std::thread> threads;
+	for (int worker = 0; worker < (int)deques_.size(); worker++)
+	{
+		threads.push_back(std::thread([this, worker]()
+		{
+			poolTask task;
+			while (pending_.load() > 0)
+			{
+				if (take(worker, task))
+				{
+					task(worker);
+					task = poolTask();
+					pending_.fetch_sub(1);
+				}
+				else std::this_thread::yield();
+			}
+		}));
+	}
+	for (auto& thread : threads) thread.join();
+}
+
+void workStealingPool::start()
+{
+	stopping_ = false;
+	for (int worker = 0; worker < (int)deques_.size(); worker++)
+	{
+		threads_.push_back(std::thread([this, worker]()
+		{
+			poolTask task;
+			while (true)
+			{
+				if (take(worker, task))
+				{
+					task(worker);
+					task = poolTask();
+					pending_.fetch_sub(1);
+					continue;
+				}
+				std::unique_lock<std::mutex> guard(idleLock_);
+				if (stopping_) break;
+				// Pending but not takeable means someone is still running it, look again rather than sleep
+				if (pending_.load() == 0) idle_.wait(guard);
+				else
+				{
+					guard.unlock();
+					std::this_thread::yield();
+				}
+			}
+		}));
+	}
+}
+
+void workStealingPool::stop()
+{
+	{
+		std::lock_guard<std::mutex> guard(idleLock_);
+		stopping_ = true;
+	}
+	idle_.notify_all();
+	for (auto& thread : threads_) thread.join();
+	threads_.clear();
+}
+
+// Shared by the caller and the helper tasks of one parallelFor, a helper that starts late finds every index taken
+struct parallelBatch
+{
+	std::function<void(int index)> body_;
+	int count_;
+	std::atomic<int> next_;
+	std::atomic<int> done_;
+};
+
+static void workOnBatch(parallelBatch& batch)
+{
+	for (int index = batch.next_.fetch_add(1); index < batch.count_; index = batch.next_.fetch_add(1))
+	{
+		batch.body_(index);
+		batch.done_.fetch_add(1);
+	}
+}
+
+void workStealingPool::parallelFor(int count, const std::function<void(int index)>& body, int worker)
+{
+	if (count <= 1)
+	{
+		if (count == 1) body(0);
+		return;
+	}
+	std::shared_ptr<parallelBatch> batch = std::make_shared<parallelBatch>();
+	batch->body_ = body;
+	batch->count_ = count;
+	batch->next_.store(0);
+	batch->done_.store(0);
+	for (int i = 1; i < count; i++) push([batch](int) { workOnBatch(*batch); }, worker);
+	workOnBatch(*batch);
+	while (batch->done_.load() < count) std::this_thread::yield();
+}
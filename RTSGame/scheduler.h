@@ -0,0 +1,53 @@
+#pragma once
+#include "main.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/* Work-stealing task pool
+Every worker thread owns a deque of tasks. A worker takes its own tasks from the back, newest first, so a task that
+queues its own continuation keeps running on the core whose cache already holds its data. A worker whose deque is
+empty steals the oldest task from the front of another worker's deque, which is where the biggest untouched work sits.
+Each deque has its own lock, so workers only ever contend when one of them steals.
+The pool either runs a batch to completion with run(), as the match server does, or keeps its workers around with
+start() so a running match can hand it small jobs such as combat stripes every frame without starting threads.
+*/
+typedef std::function<void(int worker)> poolTask;
+
+struct taskDeque
+{
+	std::mutex lock_;
+	std::deque<poolTask> tasks_;
+};
+
+struct workStealingPool
+{
+	workStealingPool(int workers);
+	~workStealingPool();
+	// From a running task, pass the worker it was given so the task lands on that worker's own deque.
+	// Otherwise tasks are dealt round robin.
+	void push(const poolTask& task, int worker = -1);
+	// Runs on workers threads until every task is done, including tasks pushed by tasks
+	void run();
+	// Starts workers threads that stay until stop, taking tasks as they are pushed and sleeping while there are none
+	void start();
+	void stop();
+	// Calls body(0) to body(count - 1) spread over the pool and returns once every call is done. The caller takes
+	// indices too, so it finishes even if no worker gets around to helping, and may be called from inside a task.
+	// worker is the calling worker, or -1 from a thread outside the pool.
+	void parallelFor(int count, const std::function<void(int index)>& body, int worker = -1);
+	bool take(int worker, poolTask& task);
+	int workers() const;
+	std::vector<std::unique_ptr<taskDeque>> deques_;
+	std::atomic<Uint64> pending_; // pushed and not yet finished
+	std::atomic<Uint64> steals_;
+	std::atomic<int> nextDeque_;
+	std::vector<std::thread> threads_; // workers started by start
+	std::mutex idleLock_;
+	std::condition_variable idle_; // started workers wait here while nothing is pending
+	bool stopping_;
+};
@@ -0,0 +1,271 @@
+#include "selfcheck.h"
+#include "world.h"
+#include "tile.h"
+#include "unit.h"
+#include "player.h"
+#include "mapfile.h"
+#include "simulation.h"
+#include "snapshot.h"
+#include "fog.h"
+#include "components.h"
+
+static int failedChecks = 0;
+
+static void check(bool passed, const char* what)
+{
+	if (passed) return;
+	std::cout << "Self check failed: " << what << std::endl;
+	failedChecks++;
+}
+
+// Ground inside a ring of walls, with two human players so nobody acts on their own
+static void openArena(world& w, SDL_Surface* surface, int size, Uint8 ground = 0)
+{
+	w.surface_ = surface;
+	w.verbose_ = false;
+	std::vector<Uint8> states(size * size, ground);
+	for (int i = 0; i < size; i++)
+	{
+		states[i] = 1;
+		states[(size - 1) * size + i] = 1;
+		states[i * size] = 1;
+		states[i * size + size - 1] = 1;
+	}
+	allocateTiles(w.tiles_, states.data(), size, size);
+	terrainLoaded(w);
+	addPlayer(w, true, 2, 2);
+	addPlayer(w, true, size - 3, size - 3);
+}
+
+// A fighter hits a unit that was placed next to it and never moved, once per frame until it dies
+static void checkStationaryTarget(SDL_Surface* surface)
+{
+	world w;
+	openArena(w, surface, 12);
+	unit* fighter = addUnit(w, w.players_[0], unitFighter, 5, 5);
+	unit* miner = addUnit(w, w.players_[1], unitMiner, 5, 6);
+	check(w.tiles_[5][6]->unitAt_ == miner, "a placed unit is registered on its tile");
+	stepWorld(w, tickFlags());
+	check(miner->health_ == unitArchetypes[unitMiner].health_ - 1, "a stationary enemy next to a fighter loses health");
+	for (int frame = 1; frame < unitArchetypes[unitMiner].health_; frame++) stepWorld(w, tickFlags());
+	check(w.players_[1]->ofType_[unitMiner].size() == 0 && w.tiles_[5][6]->unitAt_ == NULL, "a stationary enemy dies after as many frames as it has health");
+	check(fighter->health_ == unitArchetypes[unitFighter].health_, "a miner does not hit back");
+	clearWorld(w);
+}
+
+// A* goes around a unit that was placed and never moved
+static void checkPathAroundStationaryUnit(SDL_Surface* surface)
+{
+	world w;
+	openArena(w, surface, 12);
+	addUnit(w, w.players_[1], unitMiner, 5, 6);
+	std::vector<tile*> path;
+	bool found = astar(w.surface_, w.window_, w.tiles_, w.tiles_[5][5], w.tiles_[5][7], path);
+	check(found, "a path exists around a stationary unit");
+	check(std::find(path.begin(), path.end(), w.tiles_[5][6]) == path.end(), "a path does not go through a stationary unit");
+	clearWorld(w);
+}
+
+// A factory spawns each unit on a different free neighbour
+static void checkSpawnsDoNotStack(SDL_Surface* surface)
+{
+	world w;
+	openArena(w, surface, 12);
+	unit* builder = addUnit(w, w.players_[0], unitBuilder, 5, 5);
+	builder->buildFactory(w, unitFighter);
+	tile* factory = w.tiles_[5][5];
+	check(factory->state_ == 3 && w.factories_.size() == 1, "a builder turns its tile into a factory");
+	w.players_[0]->resources_ = 100;
+	factory->spawnUnit(w);
+	factory->spawnUnit(w);
+	std::vector<tile*> spawned;
+	for (auto fighter : w.players_[0]->ofType_[unitFighter]) spawned.push_back(fighter->tileAt_);
+	check(spawned.size() == 2 && spawned[0] != spawned[1], "two spawns from one factory land on different tiles");
+	for (auto at : spawned) check(at->unitAt_ != NULL, "a spawned unit is registered on its tile");
+	clearWorld(w);
+}
+
+// A snapshot cut short anywhere is rejected and leaves the match being played as it was, a whole one loads with its factory owners
+static void checkTruncatedSnapshot(SDL_Surface* surface)
+{
+	world w;
+	openArena(w, surface, 12);
+	addUnit(w, w.players_[0], unitFighter, 5, 5);
+	addUnit(w, w.players_[1], unitMiner, 7, 7);
+	addUnit(w, w.players_[1], unitBuilder, 8, 3)->buildFactory(w, unitFighter);
+	std::vector<Uint8> buffer;
+	writeSnapshot(w, buffer);
+	Uint64 checksum = worldChecksum(w);
+	std::cout.setstate(std::ios::failbit); // every rejected cut prints why
+	bool rejected = true;
+	for (size_t cut = 0; cut < buffer.size(); cut += 7) rejected = !readSnapshot(w, buffer.data(), cut, surface, NULL) && rejected;
+	std::cout.clear();
+	check(rejected, "a truncated snapshot is rejected");
+	check(worldChecksum(w) == checksum && w.tiles_.size() == 12, "a rejected snapshot leaves the match untouched");
+	check(readSnapshot(w, buffer.data(), buffer.size(), surface, NULL) && worldChecksum(w) == checksum, "a whole snapshot loads the same match");
+	check(w.factories_.size() == 1 && w.tiles_[8][3]->claimedBy_ == w.players_[1], "a factory keeps its owner through a snapshot");
+	clearWorld(w);
+}
+
+// The frontier is the edge of what a player has seen, and what it has seen survives a snapshot
+static void checkExploredFrontier(SDL_Surface* surface)
+{
+	world w;
+	openArena(w, surface, 30);
+	updateFog(w);
+	player* first = w.players_[0];
+	check(isExplored(first, w.tiles_[2][2 + sightRadius]) && !isExplored(first, w.tiles_[20][20]), "a player explores around its commander and not beyond");
+	check(onFrontier(w, first, w.tiles_[2][2 + sightRadius]) && !onFrontier(w, first, w.tiles_[2][2]), "the frontier is the edge of explored ground");
+	std::vector<Uint8> buffer;
+	writeSnapshot(w, buffer);
+	check(readSnapshot(w, buffer.data(), buffer.size(), surface, NULL), "a snapshot with explored ground loads");
+	first = w.players_[0];
+	check(isExplored(first, w.tiles_[2][2 + sightRadius]) && !isExplored(first, w.tiles_[20][20]), "explored ground survives a snapshot");
+	updateFog(w);
+	check(isExplored(first, w.tiles_[2][2 + sightRadius]) && isVisible(first, w.tiles_[2][2]), "visibility comes back after a snapshot");
+	clearWorld(w);
+}
+
+// A unit saved halfway through a cooperative walk, with only its current window in path_, still gets where it was going
+static void checkResumedWalk(SDL_Surface* surface)
+{
+	world w;
+	openArena(w, surface, 40);
+	unit* walker = addUnit(w, w.players_[0], unitFighter, 5, 5);
+	int id = walker->id_;
+	walker->navigate(w, w.tiles_[5][35]);
+	tickFlags moveTick;
+	moveTick.unitMoveTimerDone = true;
+	for (int tick = 0; tick < 3; tick++) stepWorld(w, moveTick);
+	check(walker->path_.size() < 27, "a cooperative path holds only its window");
+	std::vector<Uint8> buffer;
+	writeSnapshot(w, buffer);
+	check(readSnapshot(w, buffer.data(), buffer.size(), surface, NULL), "a snapshot taken mid-walk loads");
+	walker = NULL;
+	for (auto unitPtr : w.units_)
+	{
+		if (unitPtr->id_ == id) walker = unitPtr;
+	}
+	int ticks = 0;
+	while (walker != NULL && walker->tileAt_ != w.tiles_[5][35] && ticks < 100)
+	{
+		stepWorld(w, moveTick);
+		ticks++;
+	}
+	check(walker != NULL && walker->tileAt_ == w.tiles_[5][35], "a walk saved halfway finishes after loading");
+	clearWorld(w);
+}
+
+// A chunk that is wall throughout shares one tile, and searches, labels, clones and snapshots go around it
+static void checkImplicitWalls(SDL_Surface* surface)
+{
+	world w;
+	w.surface_ = surface;
+	w.verbose_ = false;
+	int size = 3 * chunkSize;
+	std::vector<Uint8> states(size * size, 0);
+	for (int r = chunkSize; r < 2 * chunkSize; r++)
+	{
+		for (int c = chunkSize; c < 2 * chunkSize; c++) states[r * size + c] = 1;
+	}
+	allocateTiles(w.tiles_, states.data(), size, size);
+	terrainLoaded(w);
+	addPlayer(w, true, 2, 2);
+	addPlayer(w, true, size - 3, size - 3);
+	int middle = chunkSize + chunkSize / 2;
+	check(isImplicitWall(w.tiles_[middle][middle]) && !isImplicitWall(w.tiles_[chunkSize - 1][middle]), "only the tiles of an all-wall chunk share the implicit wall");
+	check(w.chunks_.at(1, 1).allWall() && w.chunks_.at(1, 1).area_ == chunkSize * chunkSize, "an all-wall chunk is counted by position");
+	check(sameComponent(w.tiles_[middle][2], w.tiles_[middle][size - 3]) && w.tiles_[middle][middle]->component_ == -1, "labels go around an all-wall chunk");
+	size_t players = w.players_.size();
+	check(addPlayer(w, false, middle, middle) == NULL && w.players_.size() == players && implicitWall.unitAt_ == NULL, "no player starts inside an all-wall chunk");
+	check(addUnit(w, w.players_[0], unitFighter, middle, middle) == NULL && addUnit(w, w.players_[0], unitFighter, -1, 0) == NULL && implicitWall.unitAt_ == NULL, "no unit is placed in a wall or off the map");
+	std::vector<tile*> path;
+	bool found = astar(w.surface_, w.window_, w.tiles_, w.tiles_[middle][2], w.tiles_[middle][size - 3], path);
+	bool clear = true;
+	for (auto step : path) clear = clear && !isImplicitWall(step) && step->state_ != 1;
+	check(found && clear, "a path goes around an all-wall chunk");
+	check(!astar(w.surface_, w.window_, w.tiles_, w.tiles_[2][2], w.tiles_[middle][middle], path), "no path ends inside an all-wall chunk");
+	world copy;
+	cloneWorld(w, copy);
+	check(isImplicitWall(copy.tiles_[middle][middle]) && worldChecksum(copy) == worldChecksum(w), "a clone keeps the all-wall chunk implicit");
+	clearWorld(copy);
+	Uint64 checksum = worldChecksum(w);
+	std::vector<Uint8> buffer;
+	writeSnapshot(w, buffer);
+	check(readSnapshot(w, buffer.data(), buffer.size(), surface, NULL) && worldChecksum(w) == checksum && isImplicitWall(w.tiles_[middle][middle]), "a snapshot keeps the all-wall chunk implicit");
+	clearWorld(w);
+}
+
+// Closing the only gap in a wall splits the labels in two, and the side the first neighbour is on keeps its label
+static void checkSplitLabels(SDL_Surface* surface)
+{
+	world w;
+	openArena(w, surface, 12);
+	for (int r = 1; r < 11; r++)
+	{
+		if (r != 5) setTileState(w, w.tiles_[r][5], 1);
+	}
+	publishTileChanges(w);
+	check(sameComponent(w.tiles_[5][4], w.tiles_[5][6]), "a gap in a wall joins both sides");
+	int kept = w.tiles_[4][6]->component_;
+	size_t labels = w.componentSizes_.size();
+	setTileState(w, w.tiles_[5][5], 3);
+	publishTileChanges(w);
+	check(!sameComponent(w.tiles_[5][4], w.tiles_[5][6]), "closing the gap splits the labels");
+	check(w.tiles_[5][6]->component_ == kept && w.componentSizes_.size() == labels + 1, "a split floods only the side that leaves");
+	clearWorld(w);
+}
+
+// Move ticks a fighter needs to walk ten tiles straight across ground, planning cooperatively or not
+static int walkTicks(SDL_Surface* surface, Uint8 ground, bool cooperative)
+{
+	world w;
+	w.cooperative_ = cooperative;
+	openArena(w, surface, 20, ground);
+	unit* walker = addUnit(w, w.players_[0], unitFighter, 5, 5);
+	walker->navigate(w, w.tiles_[5][15]);
+	tickFlags moveTick;
+	moveTick.unitMoveTimerDone = true;
+	int ticks = 0;
+	while (walker->tileAt_ != w.tiles_[5][15] && ticks < 100)
+	{
+		stepWorld(w, moveTick);
+		ticks++;
+	}
+	clearWorld(w);
+	return ticks;
+}
+
+// A step takes as long as its cost: a tick per step on open ground, two on slow ground, half of one on road
+static void checkTravelTime(SDL_Surface* surface)
+{
+	for (int cooperative = 0; cooperative < 2; cooperative++)
+	{
+		check(walkTicks(surface, 0, cooperative) == 10, "ten straight steps on open ground take ten move ticks");
+		check(walkTicks(surface, 4, cooperative) == 20, "ten straight steps on slow ground take twenty move ticks");
+		check(walkTicks(surface, 5, cooperative) == 5, "ten straight steps on road take five move ticks");
+	}
+}
+
+int runSelfCheck()
+{
+	SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, 1, 1, 32, SDL_PIXELFORMAT_RGB888);
+	failedChecks = 0;
+	checkStationaryTarget(surface);
+	checkPathAroundStationaryUnit(surface);
+	checkSpawnsDoNotStack(surface);
+	checkTruncatedSnapshot(surface);
+	checkExploredFrontier(surface);
+	checkResumedWalk(surface);
+	checkTravelTime(surface);
+	checkImplicitWalls(surface);
+	checkSplitLabels(surface);
+	SDL_FreeSurface(surface);
+	if (failedChecks > 0)
+	{
+		std::cout << failedChecks << " self checks failed" << std::endl;
+		return 1;
+	}
+	std::cout << "Self check passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include "main.h"
+
+// --self-check
+// Plays small hand-built scenarios headless and checks the simulation rules they pin down, such as fighters hitting
+// units that never moved and paths going around them. Prints every failed check, returns 1 if there was one.
+int runSelfCheck();
@@ -0,0 +1,287 @@
+#include "server.h"
+#include "scheduler.h"
+#include "world.h"
+#include "tile.h"
+#include "player.h"
+#include "simulation.h"
+#include "mapfile.h"
+#include <map>
+#include <sstream>
+#include <thread>
+
+// Terrain of one map file, read once and shared by every match played on it
+struct serverMap
+{
+	std::string path_;
+	std::vector<Uint8> states_;
+	int width_;
+	int height_;
+};
+
+struct serverJob
+{
+	const serverMap* map_;
+	std::vector<Strategy> strategies_;
+	int count_;
+	Uint32 seed_;
+	int maxTicks_;
+	double budgetMs_; // 0 for no limit
+};
+
+// Everything a match needs while it is being played, created by its first slice
+struct matchInstance
+{
+	matchInstance() : timers_(0)
+	{
+		now_ = 0;
+	}
+	world world_;
+	simTimers timers_;
+	Uint64 now_;
+};
+
+struct serverMatch
+{
+	int job_;
+	int index_; // within its job
+	Uint32 seed_;
+	matchInstance* instance_;
+	int ticks_;
+	double usedMs_;
+};
+
+struct serverContext
+{
+	std::vector<serverJob> jobs_;
+	std::vector<serverMatch> matches_;
+	SDL_Surface* surface_; // player colors need a pixel format, only ever read, so every match on every worker shares it
+	int slice_;
+	workStealingPool* pool_;
+	std::mutex outLock_;
+	std::ofstream out_;
+	std::atomic<Uint64> ticks_;
+	std::atomic<int> finished_;
+};
+
+static bool parseStrategies(const std::string& list, std::vector<Strategy>& strategies)
+{
+	strategies.clear();
+	size_t begin = 0;
+	while (begin <= list.size())
+	{
+		size_t end = std::min(list.find(',', begin), list.size());
+		Strategy strat;
+		if (!parseStrategy(list.substr(begin, end - begin), strat))
+		{
+			std::cout << "Unknown strategy " << list.substr(begin, end - begin) << std::endl;
+			return false;
+		}
+		strategies.push_back(strat);
+		begin = end + 1;
+	}
+	return true;
+}
+
+static bool readJobs(const std::string& path, std::map<std::string, serverMap>& maps, std::vector<serverJob>& jobs)
+{
+	std::ifstream in(path);
+	if (!in)
+	{
+		std::cout << "Could not open jobs file " << path << std::endl;
+		return false;
+	}
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(in, line))
+	{
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+		std::istringstream fields(line);
+		std::string mapPath;
+		std::string strategies;
+		if (!(fields >> mapPath)) continue;
+		serverJob job;
+		job.count_ = 1;
+		job.seed_ = 1;
+		job.maxTicks_ = 24000;
+		job.budgetMs_ = 0;
+		if (!(fields >> strategies) || !parseStrategies(strategies, job.strategies_))
+		{
+			std::cout << "Line " << lineNumber << " of " << path << " needs a map and a list of strategies" << std::endl;
+			return false;
+		}
+		fields >> job.count_ >> job.seed_ >> job.maxTicks_ >> job.budgetMs_;
+		job.count_ = std::max(1, job.count_);
+		job.maxTicks_ = std::max(1, job.maxTicks_);
+
+		if (maps.count(mapPath) == 0)
+		{
+			world base;
+			if (!loadWorldMap(base, mapPath)) return false;
+			serverMap& terrain = maps[mapPath];
+			terrain.path_ = mapPath;
+			terrain.height_ = base.tiles_.size();
+			terrain.width_ = base.tiles_[0].size();
+			terrain.states_.resize(terrain.width_ * terrain.height_);
+			for (int r = 0; r < terrain.height_; r++)
+			{
+				for (int c = 0; c < terrain.width_; c++) terrain.states_[r * terrain.width_ + c] = base.tiles_[r][c]->state_;
+			}
+			clearWorld(base);
+		}
+		job.map_ = &maps[mapPath];
+		jobs.push_back(job);
+	}
+	return true;
+}
+
+// Sets up the world, returns false if the map has no room for every player
+static bool startMatch(serverContext& server, serverMatch& match)
+{
+	const serverJob& job = server.jobs_[match.job_];
+	match.instance_ = new matchInstance();
+	world& w = match.instance_->world_;
+	w.surface_ = server.surface_;
+	w.verbose_ = false;
+	w.rng_.seed(match.seed_);
+	allocateTiles(w.tiles_, job.map_->states_.data(), job.map_->width_, job.map_->height_);
+	terrainLoaded(w);
+	std::vector<tile*> starts;
+	if (!pickStartTiles(w, job.strategies_.size(), starts)) return false;
+	for (int i = 0; i < (int)starts.size(); i++) addPlayer(w, false, starts[i]->y_, starts[i]->x_)->strat_ = job.strategies_[i];
+	return true;
+}
+
+static void finishMatch(serverContext& server, serverMatch& match, const char* end, const player* winner)
+{
+	const serverJob& job = server.jobs_[match.job_];
+	std::ostringstream row;
+	row << match.job_ << "," << match.index_ << "," << job.map_->path_ << "," << match.seed_ << ",";
+	for (int i = 0; i < (int)job.strategies_.size(); i++) row << (i > 0 ? ";" : "") << strategyName(job.strategies_[i]);
+	row << "," << (winner == NULL ? -1 : winner->team_) << "," << (winner == NULL ? "none" : strategyName(winner->strat_)) << "," << match.ticks_ << "," << match.usedMs_ << "," << end;
+	{
+		std::lock_guard<std::mutex> guard(server.outLock_);
+		if (server.out_.is_open()) server.out_ << row.str() << std::endl;
+		else std::cout << row.str() << std::endl;
+	}
+	if (match.instance_ != NULL) clearWorld(match.instance_->world_);
+	delete match.instance_;
+	match.instance_ = NULL;
+	server.ticks_.fetch_add(match.ticks_, std::memory_order_relaxed);
+	server.finished_.fetch_add(1);
+}
+
+static void runSlice(serverContext& server, int matchIndex, int worker)
+{
+	serverMatch& match = server.matches_[matchIndex];
+	const serverJob& job = server.jobs_[match.job_];
+	if (match.instance_ == NULL && !startMatch(server, match))
+	{
+		finishMatch(server, match, "no_room", NULL);
+		return;
+	}
+	matchInstance& instance = *match.instance_;
+	world& w = instance.world_;
+	// Slices move between workers, combat stripes go on the deque of whichever one runs this slice
+	w.pool_ = server.pool_;
+	w.poolWorker_ = worker;
+	double frequency = double(SDL_GetPerformanceFrequency());
+	Uint64 sliceStart = SDL_GetPerformanceCounter();
+	const char* end = NULL;
+	player* winner = NULL;
+	for (int i = 0; i < server.slice_ && end == NULL; i++)
+	{
+		instance.now_ += headlessFrameMs;
+		winner = stepWorld(w, instance.timers_.poll(instance.now_));
+		match.ticks_++;
+		if (winner != NULL) end = "won";
+		else if (w.players_.size() == 0) end = "all_dead";
+		else if (match.ticks_ >= job.maxTicks_) end = "tick_limit";
+		else if (job.budgetMs_ > 0 && match.usedMs_ + (SDL_GetPerformanceCounter() - sliceStart) * 1000 / frequency >= job.budgetMs_) end = "time_budget";
+	}
+	match.usedMs_ += (SDL_GetPerformanceCounter() - sliceStart) * 1000 / frequency;
+	if (end != NULL)
+	{
+		finishMatch(server, match, end, winner);
+		return;
+	}
+	server.pool_->push([&server, matchIndex](int next) { runSlice(server, matchIndex, next); }, worker);
+}
+
+int runServer(int argc, char** args, int first)
+{
+	if (first >= argc)
+	{
+		std::cout << "--serve needs a jobs file" << std::endl;
+		return 1;
+	}
+	std::string jobsPath = args[first];
+	int threadCount = std::max(1u, std::thread::hardware_concurrency());
+	std::string outPath;
+	serverContext server;
+	server.slice_ = 200;
+	server.ticks_.store(0);
+	server.finished_.store(0);
+	for (int i = first + 1; i < argc; i++)
+	{
+		std::string arg = args[i];
+		if (i + 1 >= argc)
+		{
+			std::cout << "Missing value for " << arg << std::endl;
+			return 1;
+		}
+		std::string value = args[++i];
+		if (arg == "--threads") threadCount = std::max(1, std::stoi(value));
+		else if (arg == "--out") outPath = value;
+		else if (arg == "--slice") server.slice_ = std::max(1, std::stoi(value));
+		else
+		{
+			std::cout << "Unknown server option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	std::map<std::string, serverMap> maps;
+	if (!readJobs(jobsPath, maps, server.jobs_)) return 1;
+	for (int j = 0; j < (int)server.jobs_.size(); j++)
+	{
+		for (int i = 0; i < server.jobs_[j].count_; i++)
+		{
+			serverMatch match;
+			match.job_ = j;
+			match.index_ = i;
+			match.seed_ = server.jobs_[j].seed_ + i;
+			match.instance_ = NULL;
+			match.ticks_ = 0;
+			match.usedMs_ = 0;
+			server.matches_.push_back(match);
+		}
+	}
+	if (outPath.size() > 0)
+	{
+		server.out_.open(outPath);
+		if (!server.out_)
+		{
+			std::cout << "Could not open " << outPath << " for writing" << std::endl;
+			return 1;
+		}
+	}
+	const char* header = "job,match,map,seed,strategies,winner_team,winner,ticks,ms,end";
+	if (server.out_.is_open()) server.out_ << header << std::endl;
+	else std::cout << header << std::endl;
+
+	workStealingPool pool(threadCount);
+	server.pool_ = &pool;
+	server.surface_ = SDL_CreateRGBSurfaceWithFormat(0, 1, 1, 32, SDL_PIXELFORMAT_RGB888);
+	for (int i = 0; i < (int)server.matches_.size(); i++) pool.push([&server, i](int worker) { runSlice(server, i, worker); });
+	std::cout << "Serving " << server.matches_.size() << " matches from " << jobsPath << " on " << threadCount << " threads" << std::endl;
+	Uint64 start = SDL_GetPerformanceCounter();
+	pool.run();
+	double elapsed = (SDL_GetPerformanceCounter() - start) / double(SDL_GetPerformanceFrequency());
+	SDL_FreeSurface(server.surface_);
+
+	Uint64 ticks = server.ticks_.load();
+	std::cout << server.finished_.load() << " matches, " << ticks << " ticks in " << elapsed << " s (" << (elapsed > 0 ? ticks / elapsed : 0) << " ticks/s), "
+		<< pool.steals_.load() << " slices stolen" << std::endl;
+	return 0;
+}
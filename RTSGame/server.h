@@ -0,0 +1,16 @@
+#pragma once
+#include "main.h"
+
+/* Match server
+--serve <jobs file> [--threads n] [--out file] [--slice ticks]
+Hosts every match of a batch in one process, each an isolated world with its own timers and random generator, spread
+over all cores by a work-stealing pool. A match runs slice ticks at a time and then queues its own continuation, so
+long matches get split up and idle cores can steal what is left of them.
+Each line of the jobs file describes matches as columns, # starts a comment:
+	map strategies [count] [seed] [max ticks] [budget ms]
+e.g. "map.txt balanced,aggro 100 1 24000 5000" plays 100 matches with seeds 1 to 100, each ending in a draw after
+24000 ticks or once its slices have taken 5 s of wall time. strategies lists one strategy per player, comma separated.
+Results are written, one CSV row per match, as soon as that match ends. As in a tournament, a match plays out the
+same on any number of threads unless a player runs into its time budget.
+*/
+int runServer(int argc, char** args, int first);
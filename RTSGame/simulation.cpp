@@ -0,0 +1,295 @@
+#include "simulation.h"
+#include "world.h"
+#include "tile.h"
+#include "unit.h"
+#include "player.h"
+#include "commandlog.h"
+#include "fog.h"
+#include "trace.h"
+#include "metrics.h"
+#include "influence.h"
+#include "scheduler.h"
+
+tickFlags::tickFlags()
+{
+	miningTimerDone = false;
+	unitSpawnTimerDone = false;
+	unitMoveTimerDone = false;
+	aiActTimerDone = false;
+}
+
+simTimers::simTimers(Uint64 now)
+{
+	// Initialize resource timer
+	resourceMineInterval = 500;
+	resourceTimer = now % resourceMineInterval;
+
+	// Initializing spawning timer
+	unitSpawnInterval = 10000;
+	unitSpawnTimer = now % unitSpawnInterval;
+
+	// Init move timer
+	unitMoveInterval = 75;
+	unitMoveTimer = now % unitMoveInterval;
+
+	// Init AI acting timer
+	aiActInterval = 300;
+	aiActTimer = now % aiActInterval;
+}
+
+// A timer is done once the time wraps around its interval
+static bool timerDone(Uint64& timer, Uint64 now, int interval)
+{
+	bool done = timer > now % interval;
+	timer = now % interval;
+	return done;
+}
+
+tickFlags simTimers::poll(Uint64 now)
+{
+	tickFlags flags;
+	// done separate from searching every unit, so every unit only has to be searched once
+	flags.miningTimerDone = timerDone(resourceTimer, now, resourceMineInterval);
+	flags.unitSpawnTimerDone = timerDone(unitSpawnTimer, now, unitSpawnInterval);
+	flags.unitMoveTimerDone = timerDone(unitMoveTimer, now, unitMoveInterval);
+	flags.aiActTimerDone = timerDone(aiActTimer, now, aiActInterval);
+	return flags;
+}
+
+// Read only: what one attacking unit does this frame, appended to its stripe
+static void attackerIntents(const world& w, const unit* attacker, combatStripe& stripe)
+{
+	static const int offsets[4][2] = { { -1, 0 }, { 0, -1 }, { 0, 1 }, { 1, 0 } };
+	int height = w.tiles_.size();
+	int width = w.tiles_[0].size();
+	for (auto& offset : offsets)
+	{
+		int r = attacker->tileAt_->y_ + offset[0];
+		int c = attacker->tileAt_->x_ + offset[1];
+		if (r < 0 || c < 0 || r >= height || c >= width) continue;
+		tile* near = w.tiles_[r][c];
+		if (near->unitAt_ != NULL && near->unitAt_->team_ != attacker->team_) stripe.hits_.push_back(near->unitAt_);
+		if (near->state_ == 3 && near->claimedBy_ != attacker->team_) stripe.razed_.push_back(near);
+	}
+}
+
+static void stripeIntents(const world& w, combatStripe& stripe)
+{
+	stripe.hits_.clear();
+	stripe.razed_.clear();
+	for (auto attacker : stripe.attackers_) attackerIntents(w, attacker, stripe);
+}
+
+static bool unitIdLess(const unit* a, const unit* b)
+{
+	return a->id_ < b->id_;
+}
+
+static bool tileOrderLess(const tile* a, const tile* b)
+{
+	return a->y_ < b->y_ || (a->y_ == b->y_ && a->x_ < b->x_);
+}
+
+int resolveCombat(world& w, std::vector<unit*>& deadUnits)
+{
+	combatScratch& scratch = w.combat_;
+	int height = w.tiles_.size();
+	int attackers = 0;
+	for (auto playerPtr : w.players_)
+	{
+		for (int type = 0; type < unitTypeCount; type++)
+		{
+			if (unitArchetypes[type].attacks_) attackers += playerPtr->ofType_[type].size();
+		}
+	}
+	if (attackers == 0) return 0;
+
+	// Rows are cut into one stripe per pool worker plus the stepping thread, a stripe only pays off once it has plenty of attackers to look at
+	int threads = w.pool_ == NULL ? 1 : w.pool_->workers() + 1;
+	int stripes = std::min(threads, std::max(1, attackers / combatStripeAttackers));
+	if ((int)scratch.stripes_.size() < stripes) scratch.stripes_.resize(stripes);
+	for (int s = 0; s < stripes; s++) scratch.stripes_[s].attackers_.clear();
+	for (auto playerPtr : w.players_)
+	{
+		for (int type = 0; type < unitTypeCount; type++)
+		{
+			if (!unitArchetypes[type].attacks_) continue;
+			for (auto attacker : playerPtr->ofType_[type]) scratch.stripes_[attacker->tileAt_->y_ * stripes / height].attackers_.push_back(attacker);
+		}
+	}
+
+	// Intents, in parallel. Nothing in the world changes until every stripe is done.
+	if (stripes == 1) stripeIntents(w, scratch.stripes_[0]);
+	else w.pool_->parallelFor(stripes, [&](int s) { stripeIntents(w, scratch.stripes_[s]); }, w.poolWorker_);
+	countMetric(w.metrics_.combatChecks_, 4 * attackers);
+
+	// Apply. Damage adds up the same in any order, deaths and razed factories are put in a fixed order before acting on them.
+	size_t firstDead = deadUnits.size();
+	int damage = 0;
+	std::vector<tile*>& razed = scratch.razed_;
+	razed.clear();
+	for (int s = 0; s < stripes; s++)
+	{
+		for (auto target : scratch.stripes_[s].hits_)
+		{
+			if (target->health_ < 1) continue;
+			damage++;
+			if (--target->health_ < 1) deadUnits.push_back(target);
+		}
+		razed.insert(razed.end(), scratch.stripes_[s].razed_.begin(), scratch.stripes_[s].razed_.end());
+	}
+	std::sort(deadUnits.begin() + firstDead, deadUnits.end(), unitIdLess);
+	std::sort(razed.begin(), razed.end(), tileOrderLess);
+	razed.erase(std::unique(razed.begin(), razed.end()), razed.end());
+	for (auto targetPtr : razed)
+	{
+		influenceFactoryChanged(w, targetPtr, targetPtr->claimedBy_, false);
+		setTileOwner(w, targetPtr, NULL);
+		targetPtr->factoryType = 0;
+		setTileState(w, targetPtr, 0);
+		w.factories_.erase(std::find(w.factories_.begin(), w.factories_.end(), targetPtr));
+	}
+	return damage;
+}
+
+player* stepWorld(world& w, const tickFlags& flags)
+{
+	traceScope stepScope("stepWorld");
+	if (w.log_ != NULL) w.log_->frame(flags);
+	std::list<unit*>& units = w.units_;
+	std::list<tile*>& factories = w.factories_;
+	std::vector<player*>& players = w.players_;
+
+	Uint64 phaseStart = SDL_GetPerformanceCounter();
+	traceScope spawnScope("spawn");
+	for (auto factory : factories)
+	{
+		if (flags.unitSpawnTimerDone)
+		{
+			factory->spawnUnit(w);
+		}
+	}
+
+	spawnScope.close();
+	phaseStart = metricsPhaseDone(w, phaseSpawn, phaseStart);
+
+	// Cycle through every player, tell non-humans to perform AI actions
+	traceScope aiScope("ai");
+	if (w.replay_ != NULL)
+	{
+		// AI orders were recorded along with everything else, replay them instead of deciding again
+		w.replay_->applyOrders(w);
+	}
+	else if (flags.aiActTimerDone)
+	{
+		updateInfluence(w);
+		double frequency = double(SDL_GetPerformanceFrequency());
+		for (auto playerPtr : players)
+		{
+			if (!playerPtr->human_)
+			{
+				// Each AI gets its own budget, so one slow player can't eat everyone else's time
+				Uint64 start = SDL_GetPerformanceCounter();
+				playerPtr->deadline_ = start + (Uint64)(playerPtr->budgetUs_ * frequency / 1000000);
+				playerPtr->act(w);
+				playerPtr->stats_.record((SDL_GetPerformanceCounter() - start) * 1000000 / frequency, playerPtr->budgetUs_);
+			}
+		}
+	}
+
+	aiScope.close();
+	phaseStart = metricsPhaseDone(w, phaseAi, phaseStart);
+
+	// Every attacking unit strikes from where it stood at the start of the frame
+	traceScope combatScope("combat");
+	std::vector<unit*>& deadUnits = w.deadUnits_;
+	deadUnits.clear();
+	resolveCombat(w, deadUnits);
+	combatScope.close();
+	phaseStart = metricsPhaseDone(w, phaseCombat, phaseStart);
+
+	// Cycle through every unit, compute mining and moving. The dead stay where they fell until they are removed.
+	traceScope unitScope("units");
+	if (flags.miningTimerDone)
+	{
+		for (auto playerPtr : players)
+		{
+			for (auto miner : playerPtr->ofType_[unitMiner]) miner->resourceMineFlag = true;
+		}
+	}
+	if (flags.unitMoveTimerDone && w.coop_.slots_.size() > 0) coopReplan(w);
+	for (auto unitPtr : units)
+	{
+		if (unitPtr->health_ < 1) continue;
+		if (flags.unitMoveTimerDone)
+		{
+			unitPtr->unitMoveFlag = true;
+			unitPtr->moveCredit_ += moveTickCredit;
+		}
+		else if (w.coop_.slots_.size() > 0 && coopMoving(w, unitPtr->id_)) unitPtr->unitMoveFlag = false; // plans are made in whole move ticks, so no stepping in between
+		unitPtr->advance(w);
+	}
+
+	unitScope.close();
+	phaseStart = metricsPhaseDone(w, phaseUnits, phaseStart);
+
+	// Kill units that died during this frame, avoids modifying actively iterated lists
+	traceScope deathScope("deaths");
+	for (auto deadPtr : deadUnits)
+	{
+		removeUnit(w, deadPtr);
+	}
+
+	if (flags.unitMoveTimerDone) w.moveTick_++;
+	// Nothing touches the tiles after this, so what is derived from them catches up with the whole frame at once
+	publishTileChanges(w);
+	deathScope.close();
+	phaseStart = metricsPhaseDone(w, phaseDeaths, phaseStart);
+
+	traceScope fogScope("fog");
+	updateFog(w);
+	fogScope.close();
+	phaseStart = metricsPhaseDone(w, phaseFog, phaseStart);
+
+	traceScope winScope("win");
+	// Win conditions: if player has no factories or units, it is a dead player, and if only one player left and has units and factories, that player wins
+	std::vector<player*>& deadPlayers = w.deadPlayers_;
+	deadPlayers.clear();
+	for (auto playerPtr : players)
+	{
+		bool hasNoFactories = true;
+		for (auto factoryPtr : factories)
+		{
+			if (factoryPtr->claimedBy_ == playerPtr) hasNoFactories = false;
+		}
+		if (playerPtr->units_.size() == 0 && hasNoFactories)
+		{
+			deadPlayers.push_back(playerPtr);
+		}
+	}
+	for (auto playerPtr : deadPlayers)
+	{
+		players.erase(std::find(players.begin(), players.end(), playerPtr));
+		delete playerPtr;
+	}
+	player* winner = NULL;
+	if (players.size() == 1)
+	{
+		for (auto playerPtr : players)
+		{
+			bool hasNoFactories = true;
+			for (auto factoryPtr : factories)
+			{
+				if (factoryPtr->claimedBy_ == playerPtr) hasNoFactories = false;
+			}
+			if (playerPtr->units_.size() != 0 && !hasNoFactories)
+			{
+				winner = playerPtr;
+			}
+		}
+	}
+	if (w.log_ != NULL) w.log_->frameEnd();
+	metricsPhaseDone(w, phaseWin, phaseStart);
+	metricsFrameDone(w);
+	return winner;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "main.h"
+struct world;
+struct player;
+struct unit;
+struct tile;
+
+const int combatStripeAttackers = 2048; // attacking units per stripe, below this combat stays on the calling thread
+
+// One stripe of rows: the attacking units standing in it and what they hit this frame
+struct combatStripe
+{
+	std::vector<unit*> attackers_;
+	std::vector<unit*> hits_; // once per point of damage
+	std::vector<tile*> razed_; // enemy factories next to an attacker, may repeat
+};
+
+struct combatScratch
+{
+	std::vector<combatStripe> stripes_;
+	std::vector<tile*> razed_;
+};
+
+// Which timers ran out since the last frame
+struct tickFlags
+{
+	tickFlags();
+	bool miningTimerDone;
+	bool unitSpawnTimerDone;
+	bool unitMoveTimerDone;
+	bool aiActTimerDone;
+};
+
+// Game timers, polled once per frame with the current time in ms
+struct simTimers
+{
+	simTimers(Uint64 now);
+	tickFlags poll(Uint64 now);
+	int resourceMineInterval;
+	int unitSpawnInterval;
+	int unitMoveInterval;
+	int aiActInterval;
+	Uint64 resourceTimer;
+	Uint64 unitSpawnTimer;
+	Uint64 unitMoveTimer;
+	Uint64 aiActTimer;
+};
+
+// Headless runs advance simulated time by this much per frame, every interval above is a multiple of it
+const int headlessFrameMs = 25;
+
+// One frame of simulation: spawning, AI, combat, mining, movement, cleanup. Returns the winning player, or NULL while the match goes on
+player* stepWorld(world& w, const tickFlags& flags);
+// Attacks for one frame by every unit whose archetype attacks: each adjacent enemy unit loses a point of health per
+// attacker next to it and adjacent enemy factories are destroyed. Resolved in two steps, so the outcome doesn't depend
+// on the order of units: first every attacker's targets are collected from the untouched world, in parallel over
+// stripes of rows on w.pool_ once there are enough attackers, then the damage is applied. Units dropping below one health are appended to deadUnits in
+// id order, for removal once every unit had its turn. Returns the points of damage dealt.
+int resolveCombat(world& w, std::vector<unit*>& deadUnits);
@@ -0,0 +1,347 @@
+#include "snapshot.h"
+#include "world.h"
+#include "tile.h"
+#include "unit.h"
+#include "player.h"
+#include "mapfile.h"
+#include "bytestream.h"
+#include "components.h"
+#include <unordered_map>
+
+static Sint32 tileIndex(const world& w, const tile* tilePtr)
+{
+	if (tilePtr == NULL) return -1;
+	return tilePtr->y_ * w.tiles_[0].size() + tilePtr->x_;
+}
+
+void writeSnapshot(const world& w, std::vector<Uint8>& buffer)
+{
+	buffer.clear();
+	byteWriter out(buffer);
+	int height = w.tiles_.size();
+	int width = height > 0 ? w.tiles_[0].size() : 0;
+
+	std::unordered_map<const player*, Sint32> playerIndex;
+	for (Sint32 i = 0; i < (Sint32)w.players_.size(); i++) playerIndex[w.players_[i]] = i;
+	std::unordered_map<const unit*, Sint32> unitIndex;
+	Sint32 nextUnit = 0;
+	for (auto unitPtr : w.units_) unitIndex[unitPtr] = nextUnit++;
+
+	out.put<char>('R');
+	out.put<char>('T');
+	out.put<char>('S');
+	out.put<char>('S');
+	out.put<Uint32>(snapshotVersion);
+	out.put<Uint32>(width);
+	out.put<Uint32>(height);
+	out.put<Uint32>(w.players_.size());
+	out.put<Uint32>(w.units_.size());
+	out.put<Uint32>(w.factories_.size());
+	out.put<Sint32>(w.currentunit_ == NULL ? -1 : unitIndex[w.currentunit_]);
+	out.put<Sint32>(w.nextUnitId_);
+
+	// Tiles: state and factory type, owners go with the factory list since only factories have one
+	for (int r = 0; r < height; r++)
+	{
+		for (int c = 0; c < width; c++)
+		{
+			tile* tilePtr = w.tiles_[r][c];
+			out.put<Uint8>(tilePtr->state_);
+			out.put<Uint8>(tilePtr->factoryType);
+		}
+	}
+	// Occupied tiles, stored separately since most tiles are empty
+	Uint32 occupied = 0;
+	for (auto& row : w.tiles_)
+	{
+		for (auto tilePtr : row)
+		{
+			if (tilePtr->unitAt_ != NULL) occupied++;
+		}
+	}
+	out.put<Uint32>(occupied);
+	for (auto& row : w.tiles_)
+	{
+		for (auto tilePtr : row)
+		{
+			if (tilePtr->unitAt_ == NULL) continue;
+			out.put<Sint32>(tileIndex(w, tilePtr));
+			out.put<Sint32>(unitIndex[tilePtr->unitAt_]);
+		}
+	}
+
+	for (auto playerPtr : w.players_)
+	{
+		out.put<Sint32>(playerPtr->team_);
+		out.put<Uint8>(playerPtr->human_);
+		out.put<Uint8>((Uint8)playerPtr->strat_);
+		out.put<Sint32>(playerPtr->resources_);
+		out.put<Sint32>(playerPtr->maxResources_);
+		out.put<Uint32>(playerPtr->units_.size());
+		for (auto unitPtr : playerPtr->units_) out.put<Sint32>(unitIndex[unitPtr]);
+		// Explored ground, empty before the player's first fog update. Visibility is recomputed from the units.
+		out.put<Uint32>(playerPtr->fog_.explored_.size());
+		for (auto word : playerPtr->fog_.explored_) out.put<Uint64>(word);
+	}
+
+	for (auto unitPtr : w.units_)
+	{
+		out.put<Sint32>(unitPtr->id_);
+		out.put<Sint32>(playerIndex[unitPtr->team_]);
+		out.put<Uint8>(unitPtr->type_);
+		out.put<Sint32>(unitPtr->health_);
+		out.put<Sint32>(tileIndex(w, unitPtr->tileAt_));
+		out.put<Uint8>(unitPtr->resourceMineFlag);
+		out.put<Uint8>(unitPtr->unitMoveFlag);
+		out.put<Sint32>(unitPtr->moveCredit_);
+		out.put<Uint32>(unitPtr->path_.size());
+		// Walking order, path_ keeps it the other way around
+		for (std::vector<tile*>::const_reverse_iterator step = unitPtr->path_.rbegin(); step != unitPtr->path_.rend(); step++) out.put<Sint32>(tileIndex(w, *step));
+		// A cooperative path only runs to the end of its window, the goal lets the walk be planned again on load
+		out.put<Sint32>(tileIndex(w, coopGoal(w, unitPtr->id_)));
+	}
+
+	// Factories: tile and owner
+	for (auto factoryPtr : w.factories_)
+	{
+		out.put<Sint32>(tileIndex(w, factoryPtr));
+		out.put<Sint32>(factoryPtr->claimedBy_ == NULL ? -1 : playerIndex[factoryPtr->claimedBy_]);
+	}
+}
+
+// Parses a snapshot into w, which has to be empty. Leaves whatever was parsed so far in w when it fails.
+// Units that were moving cooperatively are listed in resumed with their goal, to be planned again once w is in place.
+static bool parseSnapshot(world& w, const Uint8* data, size_t size, SDL_Surface* winSurface, SDL_Window* window, std::vector<std::pair<unit*, tile*>>& resumed)
+{
+	byteReader in(data, size);
+	char magic[4];
+	for (int i = 0; i < 4; i++) magic[i] = in.get<char>();
+	if (memcmp(magic, "RTSS", 4) != 0 || in.get<Uint32>() != snapshotVersion)
+	{
+		std::cout << "Not a version " << snapshotVersion << " snapshot" << std::endl;
+		return false;
+	}
+	Uint32 width = in.get<Uint32>();
+	Uint32 height = in.get<Uint32>();
+	Uint32 playerCount = in.get<Uint32>();
+	Uint32 unitCount = in.get<Uint32>();
+	Uint32 factoryCount = in.get<Uint32>();
+	Sint32 currentIndex = in.get<Sint32>();
+	Sint32 nextUnitId = in.get<Sint32>();
+	size_t tileCount = (size_t)width * height;
+	// State and factory type bytes per tile
+	if (in.failed_ || tileCount == 0 || (size - in.offset_) / 2 < tileCount)
+	{
+		std::cout << "Snapshot is truncated" << std::endl;
+		return false;
+	}
+
+	std::vector<Uint8> states(tileCount);
+	std::vector<Uint8> factoryTypes(tileCount);
+	for (size_t i = 0; i < tileCount; i++)
+	{
+		states[i] = in.get<Uint8>();
+		factoryTypes[i] = in.get<Uint8>();
+		if (states[i] >= tileStateCount || factoryTypes[i] >= unitTypeCount)
+		{
+			std::cout << "Snapshot has an unknown state or factory type on tile " << i << std::endl;
+			return false;
+		}
+	}
+	allocateTiles(w.tiles_, states.data(), width, height);
+	auto tileAt = [&](Sint32 index) -> tile*
+	{
+		if (index < 0 || (size_t)index >= tileCount) return NULL;
+		// Nothing stands on or is built in a wall, and the walls of an all-wall chunk share one tile that must not be written
+		tile* tilePtr = w.tiles_[index / width][index % width];
+		return isImplicitWall(tilePtr) ? NULL : tilePtr;
+	};
+	// Counts are checked against what is left of the data before anything is sized by them
+	Uint32 occupiedCount = in.get<Uint32>();
+	if (in.failed_ || occupiedCount > (size - in.offset_) / 8)
+	{
+		std::cout << "Snapshot is truncated" << std::endl;
+		return false;
+	}
+	std::vector<std::pair<Sint32, Sint32>> occupied(occupiedCount);
+	for (auto& entry : occupied)
+	{
+		entry.first = in.get<Sint32>();
+		entry.second = in.get<Sint32>();
+	}
+
+	std::vector<std::vector<Sint32>> playerUnits;
+	for (Uint32 i = 0; i < playerCount && !in.failed_; i++)
+	{
+		Sint32 team = in.get<Sint32>();
+		bool human = in.get<Uint8>() != 0;
+		Uint8 strat = in.get<Uint8>();
+		if (strat >= strategyCount)
+		{
+			in.failed_ = true;
+			break;
+		}
+		player* playerPtr = new player(team, *winSurface, human);
+		w.players_.push_back(playerPtr);
+		playerPtr->strat_ = (Strategy)strat;
+		playerPtr->resources_ = in.get<Sint32>();
+		playerPtr->maxResources_ = in.get<Sint32>();
+		Uint32 ownUnits = in.get<Uint32>();
+		if (ownUnits > (size - in.offset_) / 4)
+		{
+			in.failed_ = true;
+			break;
+		}
+		playerUnits.push_back(std::vector<Sint32>(ownUnits));
+		for (auto& index : playerUnits.back()) index = in.get<Sint32>();
+		Uint32 exploredWords = in.get<Uint32>();
+		Uint32 wordsPerRow = (width + 63) / 64;
+		if (exploredWords != 0 && (exploredWords != (size_t)wordsPerRow * height || exploredWords > (size - in.offset_) / 8))
+		{
+			in.failed_ = true;
+			break;
+		}
+		if (exploredWords == 0) continue;
+		playerFog& fog = playerPtr->fog_;
+		fog.wordsPerRow_ = wordsPerRow;
+		fog.explored_.resize(exploredWords);
+		for (auto& word : fog.explored_) word = in.get<Uint64>();
+		fog.visible_.assign(exploredWords, 0);
+		fog.rowTouched_.assign(height, 0);
+		fog.dirty_ = true;
+	}
+
+	std::vector<unit*> units;
+	for (Uint32 i = 0; i < unitCount && !in.failed_; i++)
+	{
+		Sint32 id = in.get<Sint32>();
+		Sint32 team = in.get<Sint32>();
+		int type = in.get<Uint8>();
+		int health = in.get<Sint32>();
+		tile* at = tileAt(in.get<Sint32>());
+		if (team < 0 || (Uint32)team >= w.players_.size() || type >= unitTypeCount || at == NULL)
+		{
+			in.failed_ = true;
+			break;
+		}
+		unit* unitPtr = w.unitPool_.create(w.players_[team], w.tiles_, type, at->y_, at->x_, window, winSurface);
+		units.push_back(unitPtr);
+		w.units_.push_back(unitPtr);
+		unitPtr->id_ = id;
+		unitPtr->health_ = health;
+		unitPtr->resourceMineFlag = in.get<Uint8>() != 0;
+		unitPtr->unitMoveFlag = in.get<Uint8>() != 0;
+		unitPtr->moveCredit_ = in.get<Sint32>();
+		Uint32 pathLength = in.get<Uint32>();
+		for (Uint32 j = 0; j < pathLength && !in.failed_; j++)
+		{
+			tile* step = tileAt(in.get<Sint32>());
+			if (step != NULL) unitPtr->path_.push_back(step);
+		}
+		std::reverse(unitPtr->path_.begin(), unitPtr->path_.end());
+		tile* goal = tileAt(in.get<Sint32>());
+		if (goal != NULL) resumed.push_back(std::make_pair(unitPtr, goal));
+	}
+	auto unitAt = [&](Sint32 index) -> unit*
+	{
+		if (index < 0 || (size_t)index >= units.size()) return NULL;
+		return units[index];
+	};
+
+	for (Uint32 i = 0; i < factoryCount && !in.failed_; i++)
+	{
+		tile* factoryPtr = tileAt(in.get<Sint32>());
+		Sint32 owner = in.get<Sint32>();
+		if (owner < -1 || (owner >= 0 && (Uint32)owner >= playerCount))
+		{
+			in.failed_ = true;
+			break;
+		}
+		if (factoryPtr == NULL) continue;
+		w.factories_.push_back(factoryPtr);
+		if (owner >= 0) factoryPtr->claimedBy_ = w.players_[owner];
+	}
+	if (in.failed_)
+	{
+		std::cout << "Snapshot is truncated or corrupt" << std::endl;
+		return false;
+	}
+
+	// Resolve indices back into pointers
+	for (size_t i = 0; i < tileCount; i++)
+	{
+		tile* tilePtr = tileAt(i);
+		if (tilePtr == NULL) continue;
+		tilePtr->factoryType = factoryTypes[i];
+	}
+	for (auto& entry : occupied)
+	{
+		tile* tilePtr = tileAt(entry.first);
+		if (tilePtr != NULL) tilePtr->unitAt_ = unitAt(entry.second);
+	}
+	for (Uint32 i = 0; i < playerCount; i++)
+	{
+		for (auto index : playerUnits[i])
+		{
+			unit* unitPtr = unitAt(index);
+			if (unitPtr != NULL) w.players_[i]->unitJoined(unitPtr);
+		}
+	}
+	w.currentunit_ = unitAt(currentIndex);
+	w.nextUnitId_ = nextUnitId;
+	return true;
+}
+
+bool readSnapshot(world& w, const Uint8* data, size_t size, SDL_Surface* winSurface, SDL_Window* window)
+{
+	// Parsed into a world of its own, so a bad file can't take down the match that is being played
+	world loaded;
+	std::vector<std::pair<unit*, tile*>> resumed;
+	if (!parseSnapshot(loaded, data, size, winSurface, window, resumed))
+	{
+		clearWorld(loaded);
+		return false;
+	}
+	clearWorld(w);
+	std::swap(w.tiles_, loaded.tiles_);
+	std::swap(w.units_, loaded.units_);
+	std::swap(w.unitPool_.slabs_, loaded.unitPool_.slabs_);
+	std::swap(w.unitPool_.free_, loaded.unitPool_.free_);
+	std::swap(w.factories_, loaded.factories_);
+	std::swap(w.players_, loaded.players_);
+	w.currentunit_ = loaded.currentunit_;
+	w.nextUnitId_ = loaded.nextUnitId_;
+	terrainLoaded(w);
+	// Units and tiles keep their addresses through the swaps. Planned in unit order, as their reservations depend on it.
+	for (auto& walk : resumed)
+	{
+		if (sameComponent(walk.first->tileAt_, walk.second)) walk.first->planRoute(w, walk.second);
+	}
+	return true;
+}
+
+bool saveSnapshot(const world& w, const std::string& path)
+{
+	std::vector<Uint8> buffer;
+	writeSnapshot(w, buffer);
+	std::ofstream out(path, std::ios::binary);
+	if (!out)
+	{
+		std::cout << "Could not open " << path << " for writing" << std::endl;
+		return false;
+	}
+	out.write((const char*)buffer.data(), buffer.size());
+	return out.good();
+}
+
+bool loadSnapshot(world& w, const std::string& path, SDL_Surface* winSurface, SDL_Window* window)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+	{
+		std::cout << "Could not open snapshot " << path << std::endl;
+		return false;
+	}
+	std::vector<Uint8> buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	return readSnapshot(w, buffer.data(), buffer.size(), winSurface, window);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "main.h"
+struct world;
+
+/* Binary snapshot of a whole match (.rtss)
+Pointers are stored as indices: tiles by row-major index, players by position in players_, units by position in units_.
+-1 stands for NULL.
+*/
+const Uint32 snapshotVersion = 7;
+
+void writeSnapshot(const world& w, std::vector<Uint8>& buffer);
+// Replaces the match in w, which is left untouched if the snapshot turns out to be truncated or corrupt
+bool readSnapshot(world& w, const Uint8* data, size_t size, SDL_Surface* winSurface, SDL_Window* window);
+bool saveSnapshot(const world& w, const std::string& path);
+bool loadSnapshot(world& w, const std::string& path, SDL_Surface* winSurface, SDL_Window* window);
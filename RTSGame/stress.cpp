@@ -0,0 +1,333 @@
+#include "stress.h"
+#include "world.h"
+#include "tile.h"
+#include "unit.h"
+#include "player.h"
+#include "simulation.h"
+#include "mapfile.h"
+#include "mapgen.h"
+#include "influence.h"
+#include "metrics.h"
+#include "scheduler.h"
+#include <iomanip>
+#include <sstream>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+struct stressScenario
+{
+	stressScenario();
+	std::string mapPath_; // generated from size_ when empty
+	int width_;
+	int height_;
+	int players_;
+	int units_; // per unit type and player
+	int factories_; // per factory type and player
+	int resources_; // each player starts with this much
+	int ticks_;
+	Uint32 seed_;
+	Strategy strat_;
+	std::string csvPath_;
+};
+
+stressScenario::stressScenario()
+{
+	width_ = 128;
+	height_ = 128;
+	players_ = 4;
+	units_ = 10;
+	factories_ = 1;
+	resources_ = 0;
+	ticks_ = 2000;
+	seed_ = 1;
+	strat_ = Strategy::balanced;
+}
+
+static bool setStressOption(stressScenario& scenario, const std::string& key, const std::string& value)
+{
+	if (key == "map") scenario.mapPath_ = value;
+	else if (key == "size")
+	{
+		size_t split = value.find('x');
+		scenario.width_ = std::stoi(value.substr(0, split));
+		scenario.height_ = split == std::string::npos ? scenario.width_ : std::stoi(value.substr(split + 1));
+	}
+	else if (key == "players") scenario.players_ = std::max(1, std::stoi(value));
+	else if (key == "units") scenario.units_ = std::max(0, std::stoi(value));
+	else if (key == "factories") scenario.factories_ = std::max(0, std::stoi(value));
+	else if (key == "resources") scenario.resources_ = std::max(0, std::stoi(value));
+	else if (key == "ticks") scenario.ticks_ = std::max(1, std::stoi(value));
+	else if (key == "seed") scenario.seed_ = std::stoul(value);
+	else if (key == "strategy")
+	{
+		if (!parseStrategy(value, scenario.strat_))
+		{
+			std::cout << "Unknown strategy " << value << std::endl;
+			return false;
+		}
+	}
+	else if (key == "csv") scenario.csvPath_ = value;
+	else
+	{
+		std::cout << "Unknown stress option " << key << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static bool readStressScenario(const std::string& path, stressScenario& scenario)
+{
+	std::ifstream in(path);
+	if (!in)
+	{
+		std::cout << "Could not open scenario " << path << std::endl;
+		return false;
+	}
+	std::string line;
+	while (std::getline(in, line))
+	{
+		line = line.substr(0, line.find('#'));
+		std::istringstream fields(line);
+		std::string key;
+		std::string value;
+		if (!(fields >> key)) continue;
+		if (!(fields >> value))
+		{
+			std::cout << "Missing value for " << key << " in " << path << std::endl;
+			return false;
+		}
+		if (!setStressOption(scenario, key, value)) return false;
+	}
+	return true;
+}
+
+// Peak resident memory of the whole process so far
+static Uint64 peakMemoryBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+	return (Uint64)usage.ru_maxrss * 1024;
+#endif
+}
+
+// Open and free, with open ground on all eight sides, so the factory spawns freely and walls nothing in
+static bool canPlaceFactory(const world& w, const tile* tilePtr)
+{
+	int r = tilePtr->y_;
+	int c = tilePtr->x_;
+	if (r < 1 || c < 1 || r >= (int)w.tiles_.size() - 1 || c >= (int)w.tiles_[0].size() - 1) return false;
+	for (int i = -1; i <= 1; i++)
+	{
+		for (int j = -1; j <= 1; j++)
+		{
+			const tile* near = w.tiles_[r + i][c + j];
+			if (near->state_ != 0 || near->unitAt_ != NULL) return false;
+		}
+	}
+	return true;
+}
+
+static void placeFactory(world& w, player* owner, tile* tilePtr, int type)
+{
+	setTileOwner(w, tilePtr, owner);
+	setTileState(w, tilePtr, 3);
+	tilePtr->factoryType = type;
+	w.factories_.push_back(tilePtr);
+	influenceFactoryChanged(w, tilePtr, owner, true);
+}
+
+// Fills the open tiles nearest to the player's commander, breadth first, factories first since they need more room.
+// Returns how many units could not be placed.
+static int populatePlayer(world& w, player* owner, const stressScenario& scenario, std::vector<int>& seen, int mark)
+{
+	int width = w.tiles_[0].size();
+	tile* start = owner->units_.front()->tileAt_;
+	std::vector<tile*> queue(1, start);
+	seen[start->y_ * width + start->x_] = mark;
+	int factories = scenario.factories_ * 3;
+	int units = scenario.units_ * 3;
+	for (size_t next = 0; next < queue.size() && (factories > 0 || units > 0); next++)
+	{
+		tile* current = queue[next];
+		if (current->state_ == 0 && current->unitAt_ == NULL)
+		{
+			if (factories > 0 && canPlaceFactory(w, current))
+			{
+				// Types 1, 2, 3 in turn, so every type is close to the commander
+				placeFactory(w, owner, current, 1 + factories % 3);
+				factories--;
+			}
+			else if (units > 0)
+			{
+				addUnit(w, owner, 1 + units % 3, current->y_, current->x_);
+				units--;
+			}
+		}
+		for (int i = -1; i <= 1; i++)
+		{
+			for (int j = -1; j <= 1; j++)
+			{
+				int r = current->y_ + i;
+				int c = current->x_ + j;
+				if (r < 0 || c < 0 || r >= (int)w.tiles_.size() || c >= width) continue;
+				tile* near = w.tiles_[r][c];
+				if (seen[r * width + c] == mark || near->state_ == 1 || near->state_ == 3) continue;
+				seen[r * width + c] = mark;
+				queue.push_back(near);
+			}
+		}
+	}
+	return units + factories;
+}
+
+static bool appendStressCsv(const std::string& path, const stressScenario& scenario, const world& w, int units, int ticks, double seconds, Uint64 peakUnits, const double* phaseMs, Uint64 peakBytes)
+{
+	bool fresh = !std::ifstream(path).good();
+	std::ofstream out(path, std::ios::app);
+	if (!out)
+	{
+		std::cout << "Could not open " << path << " for writing" << std::endl;
+		return false;
+	}
+	if (fresh)
+	{
+		out << "width,height,players,units_start,units_peak,units_end,factories,ticks,seconds,ticks_per_s";
+		for (int phase = 0; phase < simPhaseCount; phase++) out << ",ms_" << simPhaseNames[phase];
+		out << ",peak_mb" << std::endl;
+	}
+	out << w.tiles_[0].size() << "," << w.tiles_.size() << "," << scenario.players_ << "," << units << "," << peakUnits << "," << w.units_.size()
+		<< "," << w.factories_.size() << "," << ticks << "," << seconds << "," << ticks / seconds;
+	for (int phase = 0; phase < simPhaseCount; phase++) out << "," << phaseMs[phase];
+	out << "," << peakBytes / 1048576.0 << std::endl;
+	return out.good();
+}
+
+int runStress(int argc, char** args, int first)
+{
+	stressScenario scenario;
+	if (first < argc && std::string(args[first]).compare(0, 2, "--") != 0)
+	{
+		if (!readStressScenario(args[first], scenario)) return 1;
+		first++;
+	}
+	for (int i = first; i < argc; i++)
+	{
+		std::string arg = args[i];
+		if (i + 1 >= argc || arg.compare(0, 2, "--") != 0)
+		{
+			std::cout << "Missing value for " << arg << std::endl;
+			return 1;
+		}
+		if (!setStressOption(scenario, arg.substr(2), args[++i])) return 1;
+	}
+
+	SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, 1, 1, 32, SDL_PIXELFORMAT_RGB888);
+	// Started once, the other cores then help with combat every frame without threads being created for it
+	int helpers = std::thread::hardware_concurrency() - 1;
+	workStealingPool pool(std::max(1, helpers));
+	if (helpers > 0) pool.start();
+	world w;
+	w.surface_ = surface;
+	if (helpers > 0) w.pool_ = &pool;
+	w.verbose_ = false;
+	w.rng_.seed(scenario.seed_);
+	Uint64 setupStart = SDL_GetPerformanceCounter();
+	if (scenario.mapPath_.size() > 0)
+	{
+		if (!loadWorldMap(w, scenario.mapPath_))
+		{
+			SDL_FreeSurface(surface);
+			return 1;
+		}
+	}
+	else
+	{
+		mapGenParams params;
+		params.width_ = std::max(3, scenario.width_);
+		params.height_ = std::max(3, scenario.height_);
+		params.resourceClusters_ = params.width_ * params.height_ / 1024;
+		params.seed_ = scenario.seed_;
+		std::vector<Uint8> states;
+		generateMap(params, states);
+		allocateTiles(w.tiles_, states.data(), params.width_, params.height_);
+		terrainLoaded(w);
+	}
+	std::vector<tile*> starts;
+	if (!pickStartTiles(w, scenario.players_, starts))
+	{
+		std::cout << "No room for " << scenario.players_ << " players" << std::endl;
+		clearWorld(w);
+		SDL_FreeSurface(surface);
+		return 1;
+	}
+	for (auto start : starts)
+	{
+		player* playerPtr = addPlayer(w, false, start->y_, start->x_);
+		playerPtr->strat_ = scenario.strat_;
+		playerPtr->resources_ = scenario.resources_;
+	}
+	std::vector<int> seen(w.tiles_.size() * w.tiles_[0].size(), -1);
+	int unplaced = 0;
+	for (int i = 0; i < (int)w.players_.size(); i++) unplaced += populatePlayer(w, w.players_[i], scenario, seen, i);
+	publishTileChanges(w);
+	double frequency = double(SDL_GetPerformanceFrequency());
+	double setupSeconds = (SDL_GetPerformanceCounter() - setupStart) / frequency;
+	int startUnits = w.units_.size();
+	std::cout << w.tiles_[0].size() << "x" << w.tiles_.size() << " map, " << w.players_.size() << " players, " << startUnits << " units, "
+		<< w.factories_.size() << " factories, set up in " << setupSeconds << " s" << std::endl;
+	if (unplaced > 0) std::cout << unplaced << " units and factories did not fit near their commanders" << std::endl;
+
+	Uint64 phaseStart[simPhaseCount];
+	for (int phase = 0; phase < simPhaseCount; phase++) phaseStart[phase] = w.metrics_.phaseTicks_[phase];
+	simTimers timers(0);
+	Uint64 now = 0;
+	Uint64 peakUnits = startUnits;
+	int ticks = 0;
+	Uint64 runStart = SDL_GetPerformanceCounter();
+	for (; ticks < scenario.ticks_ && w.players_.size() > 1; ticks++)
+	{
+		now += headlessFrameMs;
+		stepWorld(w, timers.poll(now));
+		peakUnits = std::max(peakUnits, (Uint64)w.units_.size());
+	}
+	double seconds = std::max(1e-9, (SDL_GetPerformanceCounter() - runStart) / frequency);
+	Uint64 peakBytes = peakMemoryBytes();
+
+	std::cout << ticks << " ticks in " << seconds << " s, " << ticks / seconds << " ticks/s" << std::endl;
+	if (w.players_.size() < 2) std::cout << "Match ended after " << ticks << " ticks" << std::endl;
+	std::cout << "units: " << startUnits << " at start, " << peakUnits << " at peak, " << w.units_.size() << " at end" << std::endl;
+	double phaseMs[simPhaseCount];
+	double totalMs = 0;
+	for (int phase = 0; phase < simPhaseCount; phase++)
+	{
+		phaseMs[phase] = (w.metrics_.phaseTicks_[phase] - phaseStart[phase]) * 1000 / frequency / std::max(1, ticks);
+		totalMs += phaseMs[phase];
+	}
+	std::streamsize precision = std::cout.precision();
+	for (int phase = 0; phase < simPhaseCount; phase++)
+	{
+		std::cout << std::left << std::setw(8) << simPhaseNames[phase] << std::right << std::fixed << std::setprecision(3) << std::setw(10) << phaseMs[phase]
+			<< " ms/tick" << std::setprecision(1) << std::setw(7) << (totalMs > 0 ? phaseMs[phase] * 100 / totalMs : 0) << " %" << std::endl;
+	}
+	std::cout.unsetf(std::ios::floatfield);
+	std::cout.unsetf(std::ios::adjustfield);
+	std::cout.precision(precision);
+	std::cout << "peak memory: " << peakBytes / 1048576.0 << " MB" << std::endl;
+
+	bool written = true;
+	if (scenario.csvPath_.size() > 0) written = appendStressCsv(scenario.csvPath_, scenario, w, startUnits, ticks, seconds, peakUnits, phaseMs, peakBytes);
+	clearWorld(w);
+	SDL_FreeSurface(surface);
+	return written ? 0 : 1;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include "main.h"
+
+/* Large-scale stress runs
+--stress [scenario file] [--map file | --size WxH] [--players n --units n --factories n --resources n --ticks n
+--seed s --strategy name --csv file]
+Places players far apart on the map, each with a commander, the given number of fighters, builders and miners and the
+given number of factories of each type, then plays the match headless and reports ticks per second, the time spent in
+each phase of stepWorld and the peak memory of the process. A scenario file holds the same settings one per line, as
+the option name without the dashes and its value, e.g. "units 500"; options given on the command line win.
+--csv appends one row per run, so a series of runs with growing unit counts lands in one table.
+*/
+int runStress(int argc, char** args, int first);
@@ -2,12 +2,18 @@
 #include "tile.h"
 #include "player.h"
 #include "utils.h"
+#include "world.h"
+
+static int implicitWallCoordinate = -1;
+tile implicitWall(1, implicitWallCoordinate, implicitWallCoordinate);
 
 tile::tile(const int& state, int& x, int& y)
 {
 	state_ = state;
 	magicflag = 62;
 	openclosed = 2;
+	searchId_ = 0;
+	component_ = -1;
 	onpath = false;
 	claimedBy_ = NULL;
 	unitAt_ = NULL;
@@ -15,8 +21,9 @@ tile::tile(const int& state, int& x, int& y)
 	x_ = x;
 	y_ = y;
 }
-void tile::spawnUnit(const std::vector<std::vector<tile*>>& tiles, std::list<unit*>& units, SDL_Window* window, SDL_Surface* winSurface)
+void tile::spawnUnit(world& w)
 {
+	const std::vector<std::vector<tile*>>& tiles = w.tiles_;
 	if (claimedBy_->resources_ > 9)
 	{
 		bool validSpawnUp = true;
@@ -30,34 +37,30 @@ void tile::spawnUnit(const std::vector<std::vector<tile*>>& tiles, std::list<uni
 		tile* rightTile = tiles[y_][x_ + 1];
 		tile* belowTile = tiles[y_ + 1][x_];
 
-		if (aboveTile->unitAt_ != NULL || aboveTile->state_ == 1) validSpawnUp = false;
-		if (leftTile->unitAt_ != NULL || leftTile->state_ == 1) validSpawnLeft = false;
-		if (rightTile->unitAt_ != NULL || rightTile->state_ == 1) validSpawnRight = false;
-		if (belowTile->unitAt_ != NULL || belowTile->state_ == 1) validSpawnDown = false;
+		if (aboveTile->unitAt_ != NULL || !aboveTile->walkable()) validSpawnUp = false;
+		if (leftTile->unitAt_ != NULL || !leftTile->walkable()) validSpawnLeft = false;
+		if (rightTile->unitAt_ != NULL || !rightTile->walkable()) validSpawnRight = false;
+		if (belowTile->unitAt_ != NULL || !belowTile->walkable()) validSpawnDown = false;
 
 		if (validSpawnUp)
 		{
 			claimedBy_->resources_ -= 10;
-			units.push_back(new unit(claimedBy_, tiles, factoryType, y_ - 1, x_, window, winSurface));
-			claimedBy_->units_.push_back(units.back());
+			addUnit(w, claimedBy_, factoryType, y_ - 1, x_);
 		}
 		else if (validSpawnLeft)
 		{
 			claimedBy_->resources_ -= 10;
-			units.push_back(new unit(claimedBy_, tiles, factoryType, y_, x_ - 1, window, winSurface));
-			claimedBy_->units_.push_back(units.back());
+			addUnit(w, claimedBy_, factoryType, y_, x_ - 1);
 		}
 		else if (validSpawnRight)
 		{
 			claimedBy_->resources_ -= 10;
-			units.push_back(new unit(claimedBy_, tiles, factoryType, y_, x_ + 1, window, winSurface));
-			claimedBy_->units_.push_back(units.back());
+			addUnit(w, claimedBy_, factoryType, y_, x_ + 1);
 		}
 		else if (validSpawnDown)
 		{
 			claimedBy_->resources_ -= 10;
-			units.push_back(new unit(claimedBy_, tiles, factoryType, y_ + 1, x_, window, winSurface));
-			claimedBy_->units_.push_back(units.back());
+			addUnit(w, claimedBy_, factoryType, y_ + 1, x_);
 		}
 		else
 		{
@@ -75,6 +78,8 @@ void tile::spawnUnit(const std::vector<std::vector<tile*>>& tiles, std::list<uni
 1 = Wall
 2 = Resource
 3 = Factory
+4 = Slow ground
+5 = Road
 */
 
 
@@ -101,6 +106,17 @@ int tile::distTo(tile* dest)
 	return numLinearMoves * 10 + numDiagMoves * 14;
 }
 
+int tile::stepCost(const tile* neighbor) const
+{
+	int step = neighbor->x_ != x_ && neighbor->y_ != y_ ? 14 : 10;
+	return step * std::max(terrainWeight[state_], terrainWeight[neighbor->state_]) / 2;
+}
+
+bool tile::walkable() const
+{
+	return state_ != 1 && state_ != 3;
+}
+
 Uint32 tile::getColor(SDL_Surface& winSurface)
 {
 	// if (onpath) return SDL_MapRGB(winSurface.format, 0, 0, 255);
@@ -122,6 +138,14 @@ Uint32 tile::getColor(SDL_Surface& winSurface)
 			// Factory
 			return claimedBy_->color_;
 			break;
+		case(4):
+			// Slow ground
+			return SDL_MapRGB(winSurface.format, 90, 60, 30);
+			break;
+		case(5):
+			// Road
+			return SDL_MapRGB(winSurface.format, 120, 110, 90);
+			break;
 		default:
 			std::cout << "Unknown state. State is " << state_ << std::endl;
 			break;
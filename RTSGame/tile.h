@@ -2,23 +2,39 @@
 #include "main.h"
 struct player;
 struct unit;
+struct world;
+
+const int tileStateCount = 6;
+// Walking cost of each tile state, in halves of the plain 10 straight and 14 diagonal step. A step costs as much as the
+// dearer of its two tiles, so every step costs the same both ways: only road to road is cheap, anything touching slow
+// ground is dear. Walls and factories are never walked on.
+const int terrainWeight[tileStateCount] = { 2, 2, 2, 2, 4, 1 };
+
 struct tile
 {
 	tile(const int& state, int& x, int& y);
 	int magicflag;
 	int state_;
 	int factoryType; // corresponds to unit types, except 0 is not a factory
-	void spawnUnit(const std::vector<std::vector<tile*>>& tiles, std::list<unit*>& units, SDL_Window* window, SDL_Surface* winSurface);
+	void spawnUnit(world& w);
 	/*States
 	0 = Open
 	1 = Wall
 	2 = Resource
 	3 = Factory
+	4 = Slow ground
+	5 = Road
 	*/
 	Uint32 getColor(SDL_Surface& winSurface);
 	int distTo(tile* dest);
+	// Cost of the single step between this tile and a neighbor, distTo units scaled by terrainWeight
+	int stepCost(const tile* neighbor) const;
+	// Ground a unit can stand on: open, resource, slow ground and road
+	bool walkable() const;
 	tile* parent_;
 	int openclosed;
+	Uint64 searchId_; // the astar search parent_, openclosed, f_, g_ and h_ were last written by
+	int component_; // connected component label, see components.h
 	bool onpath;
 	int x_;
 	int y_;
@@ -27,4 +43,13 @@ struct tile
 	int h_;
 	player* claimedBy_;
 	unit* unitAt_;
-};
\ No newline at end of file
+};
+
+/* Implicit wall
+Every tile of a chunk (see chunks.h) that is wall throughout points at this one tile instead of a tile of its own,
+see allocateTiles. Walls never change during a match, so it is shared by every world and thread and never written
+after construction. Its x_ and y_ are -1: code that reaches a tile by position, rather than through a unit, path or
+factory, must not take the position from a tile that may be wall.
+*/
+extern tile implicitWall;
+inline bool isImplicitWall(const tile* tilePtr) { return tilePtr == &implicitWall; }
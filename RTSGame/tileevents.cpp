@@ -0,0 +1,75 @@
+#include "tileevents.h"
+#include "world.h"
+#include "tile.h"
+
+tileEvents::tileEvents()
+{
+	wanted_ = 0;
+	pendingKinds_ = 0;
+}
+
+static void recordChange(world& w, tile* tilePtr, tileChangeKind kind, int oldState, int newState)
+{
+	tileEvents& events = w.tileEvents_;
+	if ((events.wanted_ & kind) == 0) return;
+	tileChange change = { tilePtr, kind, oldState, newState };
+	events.pending_.push_back(change);
+	events.pendingKinds_ |= kind;
+}
+
+void subscribeTileChanges(world& w, int kinds, tileListener listener)
+{
+	tileSubscriber subscriber = { kinds, listener };
+	w.tileEvents_.subscribers_.push_back(subscriber);
+	w.tileEvents_.wanted_ |= kinds;
+}
+
+void setTileState(world& w, tile* tilePtr, int state)
+{
+	if (tilePtr->state_ == state) return;
+	recordChange(w, tilePtr, tileStateChanged, tilePtr->state_, state);
+	tilePtr->state_ = state;
+}
+
+void setTileOwner(world& w, tile* tilePtr, player* owner)
+{
+	if (tilePtr->claimedBy_ == owner) return;
+	recordChange(w, tilePtr, tileOwnerChanged, tilePtr->state_, tilePtr->state_);
+	tilePtr->claimedBy_ = owner;
+}
+
+void setTileUnit(world& w, tile* tilePtr, unit* unitPtr)
+{
+	if (tilePtr->unitAt_ == unitPtr) return;
+	recordChange(w, tilePtr, tileUnitChanged, tilePtr->state_, tilePtr->state_);
+	tilePtr->unitAt_ = unitPtr;
+}
+
+void publishTileChanges(world& w)
+{
+	tileEvents& events = w.tileEvents_;
+	if (events.pending_.size() == 0) return;
+	for (auto& subscriber : events.subscribers_)
+	{
+		if (subscriber.kinds_ & events.pendingKinds_) subscriber.listener_(w, events.pending_);
+	}
+	dropTileChanges(w);
+}
+
+void dropTileChanges(world& w)
+{
+	w.tileEvents_.pending_.clear();
+	w.tileEvents_.pendingKinds_ = 0;
+}
+
+void copyTileChanges(const world& src, world& dst)
+{
+	dropTileChanges(dst);
+	for (auto change : src.tileEvents_.pending_)
+	{
+		if ((dst.tileEvents_.wanted_ & change.kind_) == 0) continue;
+		change.tile_ = dst.tiles_[change.tile_->y_][change.tile_->x_];
+		dst.tileEvents_.pending_.push_back(change);
+		dst.tileEvents_.pendingKinds_ |= change.kind_;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "main.h"
+struct world;
+struct tile;
+struct player;
+struct unit;
+
+/* Tile change events
+During a match tile::state_, claimedBy_ and unitAt_ are only written through setTileState, setTileOwner and
+setTileUnit, which record what changed. The changes pile up over a frame and are handed to every subscriber in one
+batch at the end of stepWorld, in the order they happened, so whatever is derived from the tiles can catch up
+incrementally instead of being rebuilt. Whole-map loads write tiles directly and drop what was pending, since
+terrainLoaded recomputes everything anyway.
+*/
+enum tileChangeKind
+{
+	tileStateChanged = 1,
+	tileOwnerChanged = 2,
+	tileUnitChanged = 4
+};
+
+struct tileChange
+{
+	tile* tile_;
+	tileChangeKind kind_;
+	// state_ before and after a tileStateChanged, the tile may have changed again later in the same batch
+	int oldState_;
+	int newState_;
+};
+
+typedef void (*tileListener)(world& w, const std::vector<tileChange>& changes);
+
+struct tileSubscriber
+{
+	int kinds_; // tileChangeKind bits the listener cares about
+	tileListener listener_;
+};
+
+struct tileEvents
+{
+	tileEvents();
+	std::vector<tileChange> pending_;
+	std::vector<tileSubscriber> subscribers_;
+	int wanted_; // kinds any subscriber cares about, changes of other kinds are not even recorded
+	int pendingKinds_;
+};
+
+void subscribeTileChanges(world& w, int kinds, tileListener listener);
+void setTileState(world& w, tile* tilePtr, int state);
+void setTileOwner(world& w, tile* tilePtr, player* owner);
+void setTileUnit(world& w, tile* tilePtr, unit* unitPtr);
+// Hands the pending batch to every subscriber that cares about one of its kinds, then empties it
+void publishTileChanges(world& w);
+void dropTileChanges(world& w);
+// Pending changes of src, pointing at the matching tiles of dst, for a world copy taken between frames
+void copyTileChanges(const world& src, world& dst);
@@ -0,0 +1,214 @@
+#include "tournament.h"
+#include "world.h"
+#include "tile.h"
+#include "player.h"
+#include "simulation.h"
+#include "mapfile.h"
+#include <atomic>
+#include <thread>
+#include <iomanip>
+
+struct tournamentMatch
+{
+	Strategy first_;
+	Strategy second_;
+	int pairing_;
+	Uint32 seed_;
+	int winner_; // 0 first, 1 second, -1 draw
+	Uint64 frames_;
+	aiStats stats_[2]; // decision timing of the first and second player
+};
+
+static void playMatch(const std::vector<Uint8>& states, int width, int height, int maxFrames, SDL_Surface* surface, tournamentMatch& match)
+{
+	world w;
+	w.surface_ = surface;
+	w.verbose_ = false;
+	w.rng_.seed(match.seed_);
+	allocateTiles(w.tiles_, states.data(), width, height);
+	terrainLoaded(w);
+
+	// Both players start in the largest region so they can reach each other
+	match.winner_ = -1;
+	match.frames_ = 0;
+	std::vector<tile*> starts;
+	if (!pickStartTiles(w, 2, starts))
+	{
+		clearWorld(w);
+		return;
+	}
+	addPlayer(w, false, starts[0]->y_, starts[0]->x_)->strat_ = match.first_;
+	addPlayer(w, false, starts[1]->y_, starts[1]->x_)->strat_ = match.second_;
+
+	simTimers timers(0);
+	Uint64 now = 0;
+	while (match.frames_ < (Uint64)maxFrames)
+	{
+		now += headlessFrameMs;
+		player* winner = stepWorld(w, timers.poll(now));
+		match.frames_++;
+		// Dead players are deleted, keep their timing from the last frame they were alive
+		for (auto playerPtr : w.players_) match.stats_[playerPtr->team_] = playerPtr->stats_;
+		if (winner != NULL)
+		{
+			match.winner_ = winner->team_;
+			break;
+		}
+	}
+	clearWorld(w);
+}
+
+int runTournament(const std::string& mapPath, int argc, char** args, int first)
+{
+	int matchesPerPairing = 100;
+	int threadCount = std::max(1u, std::thread::hardware_concurrency());
+	Uint32 seed = 1;
+	int maxFrames = 24000; // ten simulated minutes
+	std::vector<Strategy> strategies = { Strategy::random, Strategy::turtle, Strategy::balanced, Strategy::aggro };
+	for (int i = first; i < argc; i++)
+	{
+		std::string arg = args[i];
+		if (i + 1 >= argc)
+		{
+			std::cout << "Missing value for " << arg << std::endl;
+			return 1;
+		}
+		std::string value = args[++i];
+		if (arg == "--matches") matchesPerPairing = std::max(1, std::stoi(value));
+		else if (arg == "--threads") threadCount = std::max(1, std::stoi(value));
+		else if (arg == "--seed") seed = std::stoul(value);
+		else if (arg == "--max-frames") maxFrames = std::max(1, std::stoi(value));
+		else if (arg == "--strategies")
+		{
+			// Comma separated, e.g. balanced,mcts
+			strategies.clear();
+			size_t begin = 0;
+			while (begin <= value.size())
+			{
+				size_t end = std::min(value.find(',', begin), value.size());
+				Strategy strat;
+				if (!parseStrategy(value.substr(begin, end - begin), strat))
+				{
+					std::cout << "Unknown strategy " << value.substr(begin, end - begin) << std::endl;
+					return 1;
+				}
+				strategies.push_back(strat);
+				begin = end + 1;
+			}
+		}
+		else
+		{
+			std::cout << "Unknown tournament option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	// Every match starts from the same terrain, read once
+	world base;
+	if (!loadWorldMap(base, mapPath)) return 1;
+	int height = base.tiles_.size();
+	int width = base.tiles_[0].size();
+	std::vector<Uint8> states(width * height);
+	for (int r = 0; r < height; r++)
+	{
+		for (int c = 0; c < width; c++) states[r * width + c] = base.tiles_[r][c]->state_;
+	}
+	clearWorld(base);
+
+	int strategyCount = strategies.size();
+	if (strategyCount < 2)
+	{
+		std::cout << "A tournament needs at least two strategies" << std::endl;
+		return 1;
+	}
+	std::vector<std::pair<int, int>> pairings; // indices into strategies
+	for (int a = 0; a < strategyCount; a++)
+	{
+		for (int b = a + 1; b < strategyCount; b++) pairings.push_back(std::make_pair(a, b));
+	}
+	// Sides alternate so neither strategy always gets to act first
+	std::vector<tournamentMatch> matches;
+	for (int p = 0; p < (int)pairings.size(); p++)
+	{
+		for (int i = 0; i < matchesPerPairing; i++)
+		{
+			tournamentMatch match;
+			match.first_ = strategies[i % 2 == 0 ? pairings[p].first : pairings[p].second];
+			match.second_ = strategies[i % 2 == 0 ? pairings[p].second : pairings[p].first];
+			match.pairing_ = p;
+			match.seed_ = seed + matches.size();
+			matches.push_back(match);
+		}
+	}
+
+	std::cout << "Running " << matches.size() << " matches on " << mapPath << " with " << threadCount << " threads" << std::endl;
+	std::atomic<size_t> nextMatch(0);
+	Uint64 start = SDL_GetPerformanceCounter();
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threadCount; t++)
+	{
+		threads.push_back(std::thread([&]()
+		{
+			// Player colors still need a pixel format, each thread gets its own tiny off-screen surface
+			SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, 1, 1, 32, SDL_PIXELFORMAT_RGB888);
+			for (size_t i = nextMatch++; i < matches.size(); i = nextMatch++) playMatch(states, width, height, maxFrames, surface, matches[i]);
+			SDL_FreeSurface(surface);
+		}));
+	}
+	for (auto& thread : threads) thread.join();
+	double elapsed = (SDL_GetPerformanceCounter() - start) / double(SDL_GetPerformanceFrequency());
+
+	// Tally per pairing and per strategy
+	Uint64 totalFrames = 0;
+	std::vector<int> strategyWins(strategyCount, 0);
+	std::vector<int> strategyGames(strategyCount, 0);
+	std::cout << std::left << std::setw(22) << "pairing" << std::setw(10) << "wins" << std::setw(10) << "losses" << std::setw(10) << "draws" << "mean frames" << std::endl;
+	for (int p = 0; p < (int)pairings.size(); p++)
+	{
+		int wins = 0;
+		int losses = 0;
+		int draws = 0;
+		Uint64 frames = 0;
+		for (auto& match : matches)
+		{
+			if (match.pairing_ != p) continue;
+			frames += match.frames_;
+			Strategy winner = match.winner_ == 0 ? match.first_ : match.second_;
+			if (match.winner_ < 0) draws++;
+			else if (winner == strategies[pairings[p].first]) wins++;
+			else losses++;
+		}
+		totalFrames += frames;
+		strategyWins[pairings[p].first] += wins;
+		strategyWins[pairings[p].second] += losses;
+		strategyGames[pairings[p].first] += matchesPerPairing;
+		strategyGames[pairings[p].second] += matchesPerPairing;
+		std::string name = std::string(strategyName(strategies[pairings[p].first])) + " vs " + strategyName(strategies[pairings[p].second]);
+		std::cout << std::setw(22) << name << std::setw(10) << wins << std::setw(10) << losses << std::setw(10) << draws << frames / matchesPerPairing << std::endl;
+	}
+	std::cout << std::endl;
+	for (int s = 0; s < strategyCount; s++)
+	{
+		std::cout << std::setw(12) << strategyName(strategies[s]) << " win rate " << std::fixed << std::setprecision(1) << 100.0 * strategyWins[s] / strategyGames[s] << "%" << std::endl;
+	}
+	std::cout << std::defaultfloat << std::setprecision(6);
+	std::cout << std::endl;
+	for (int s = 0; s < strategyCount; s++)
+	{
+		aiStats total;
+		for (auto& match : matches)
+		{
+			for (int side = 0; side < 2; side++)
+			{
+				if ((side == 0 ? match.first_ : match.second_) != strategies[s]) continue;
+				total.decisions_ += match.stats_[side].decisions_;
+				total.overruns_ += match.stats_[side].overruns_;
+				total.totalUs_ += match.stats_[side].totalUs_;
+				total.worstUs_ = std::max(total.worstUs_, match.stats_[side].worstUs_);
+			}
+		}
+		std::cout << std::setw(12) << strategyName(strategies[s]) << " decisions " << (total.decisions_ > 0 ? total.totalUs_ / total.decisions_ : 0) << " us mean, " << total.worstUs_ << " us worst, " << total.overruns_ << " of " << total.decisions_ << " over budget" << std::endl;
+	}
+	std::cout << totalFrames << " ticks in " << elapsed << " s (" << (elapsed > 0 ? totalFrames / elapsed : 0) << " ticks/s)" << std::endl;
+	return 0;
+}
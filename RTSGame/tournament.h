@@ -0,0 +1,10 @@
+#pragma once
+#include "main.h"
+
+/* Headless self-play between every pairing of AI strategies
+--tournament <map> [--matches n (per pairing)] [--threads n] [--seed s] [--max-frames n] [--strategies a,b,...]
+Matches are independent worlds run in parallel on all cores. Match i of a pairing is seeded with seed + its index,
+so a tournament with the same options always gives the same results regardless of thread count,
+except when a player runs into its time budget (always for mcts), which depends on machine load.
+*/
+int runTournament(const std::string& mapPath, int argc, char** args, int first);
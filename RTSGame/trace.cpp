@@ -0,0 +1,131 @@
+#include "trace.h"
+#include <mutex>
+#include <memory>
+#include <iomanip>
+
+std::atomic<bool> traceEnabled(false);
+
+struct traceEvent
+{
+	const char* name_;
+	Uint64 start_;
+	Uint64 duration_;
+};
+
+struct traceBuffer
+{
+	int thread_; // order in which threads first recorded, used as the trace's thread id
+	std::vector<traceEvent> events_;
+	size_t next_; // total events recorded, the slot written next is next_ % traceRingEvents
+};
+
+// Buffers outlive their threads, so a trace can be written after a tournament's workers are gone
+static std::mutex traceBuffersLock;
+static std::vector<std::unique_ptr<traceBuffer>> traceBuffers;
+static std::string traceExitPath;
+
+static traceBuffer* localTraceBuffer()
+{
+	thread_local traceBuffer* buffer = NULL;
+	if (buffer == NULL)
+	{
+		std::lock_guard<std::mutex> guard(traceBuffersLock);
+		traceBuffers.push_back(std::unique_ptr<traceBuffer>(new traceBuffer()));
+		buffer = traceBuffers.back().get();
+		buffer->thread_ = traceBuffers.size() - 1;
+		buffer->events_.resize(traceRingEvents);
+		buffer->next_ = 0;
+	}
+	return buffer;
+}
+
+traceScope::traceScope(const char* name)
+{
+	name_ = NULL;
+	start_ = 0;
+	if (traceEnabled.load(std::memory_order_relaxed))
+	{
+		name_ = name;
+		start_ = SDL_GetPerformanceCounter();
+	}
+}
+
+traceScope::~traceScope()
+{
+	close();
+}
+
+void traceScope::close()
+{
+	if (name_ == NULL) return;
+	Uint64 end = SDL_GetPerformanceCounter();
+	traceBuffer* buffer = localTraceBuffer();
+	traceEvent& event = buffer->events_[buffer->next_ % traceRingEvents];
+	event.name_ = name_;
+	event.start_ = start_;
+	event.duration_ = end - start_;
+	buffer->next_++;
+	name_ = NULL;
+}
+
+void setTracing(bool on)
+{
+	traceEnabled.store(on, std::memory_order_relaxed);
+}
+
+bool writeChromeTrace(const std::string& path)
+{
+	std::lock_guard<std::mutex> guard(traceBuffersLock);
+	std::ofstream out(path);
+	if (!out)
+	{
+		std::cout << "Could not open " << path << " for writing" << std::endl;
+		return false;
+	}
+	// Timestamps are in microseconds from the oldest event still in any buffer
+	double frequency = double(SDL_GetPerformanceFrequency());
+	Uint64 origin = 0;
+	size_t total = 0;
+	for (auto& buffer : traceBuffers)
+	{
+		size_t count = std::min(buffer->next_, (size_t)traceRingEvents);
+		for (size_t i = buffer->next_ - count; i < buffer->next_; i++)
+		{
+			Uint64 start = buffer->events_[i % traceRingEvents].start_;
+			if (total == 0 || start < origin) origin = start;
+			total++;
+		}
+	}
+	out << std::fixed << std::setprecision(3);
+	out << "{\"traceEvents\": [" << std::endl;
+	bool first = true;
+	for (auto& buffer : traceBuffers)
+	{
+		out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->thread_
+			<< ", \"args\": {\"name\": \"" << "thread " << buffer->thread_ << "\"}}";
+		first = false;
+		size_t count = std::min(buffer->next_, (size_t)traceRingEvents);
+		for (size_t i = buffer->next_ - count; i < buffer->next_; i++)
+		{
+			const traceEvent& event = buffer->events_[i % traceRingEvents];
+			out << ",\n{\"name\": \"" << event.name_ << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->thread_
+				<< ", \"ts\": " << (event.start_ - origin) * 1e6 / frequency << ", \"dur\": " << event.duration_ * 1e6 / frequency << "}";
+		}
+	}
+	out << std::endl << "]}" << std::endl;
+	std::cout << "Wrote " << total << " trace events from " << traceBuffers.size() << " threads to " << path << std::endl;
+	return out.good();
+}
+
+static void writeTraceAtExit()
+{
+	setTracing(false);
+	writeChromeTrace(traceExitPath);
+}
+
+void traceToFileAtExit(const std::string& path)
+{
+	if (traceExitPath.size() == 0) std::atexit(writeTraceAtExit);
+	traceExitPath = path;
+	setTracing(true);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "main.h"
+#include <atomic>
+
+/* Frame tracing
+A traceScope records how long the code between its construction and destruction (or close()) took, as one event
+in a ring buffer belonging to the thread it ran on, so recording never takes a lock. Each buffer keeps the newest
+traceRingEvents events. While tracing is off a scope only reads one flag.
+writeChromeTrace exports every buffer in the Chrome trace event format, for chrome://tracing or ui.perfetto.dev.
+Names have to be string literals or otherwise outlive the trace.
+*/
+const int traceRingEvents = 1 << 16;
+
+extern std::atomic<bool> traceEnabled;
+
+struct traceScope
+{
+	traceScope(const char* name);
+	~traceScope();
+	// Ends the scope early, for phases that don't have a block of their own
+	void close();
+	const char* name_; // NULL when tracing was off at the start, or already closed
+	Uint64 start_;
+};
+
+// Switches recording on or off, from any thread
+void setTracing(bool on);
+// Writes every thread's events as Chrome trace JSON. Other threads should not be recording while this runs.
+bool writeChromeTrace(const std::string& path);
+// --trace <file>: turns tracing on now and writes the trace to path when the program exits
+void traceToFileAtExit(const std::string& path);
@@ -3,39 +3,88 @@
 #include "tile.h"
 #include "player.h"
 #include "utils.h"
+#include "world.h"
+#include "commandlog.h"
+#include "components.h"
+#include "landmarks.h"
+#include "coopnav.h"
+#include "metrics.h"
 
 unit::unit(player* team, const std::vector<std::vector<tile*>>& tiles, const int type, const int row, const int column, SDL_Window* window, SDL_Surface* winSurface)
 {
 	tileAt_ = tiles[row][column];
+	fovAt_ = NULL;
+	id_ = -1;
 	type_ = type;
 	window_ = window;
 	surface_ = winSurface;
 	path_.clear();
+	// Room for a whole cooperative window up front, so a new unit's first move doesn't allocate
+	path_.reserve(windowPlanSteps);
 	team_ = team;
 	resourceMineFlag = true;
 	unitMoveFlag = true;
-	switch (type_)
+	moveCredit_ = 0;
+	health_ = unitArchetypes[type_].health_;
+}
+
+unitPool::unitPool()
+{
+}
+
+unitPool::~unitPool()
+{
+	for (auto slab : slabs_) ::operator delete(slab);
+}
+
+unit* unitPool::slot()
+{
+	if (free_.size() == 0)
 	{
-	case(0):
-		health_ = 10;
-		break;
-	case(1):
-		health_ = 50;
-		break;
-	case(2):
-		health_ = 10;
-		break;
-	case(3):
-		health_ = 100;
-		break;
+		unit* slab = (unit*)::operator new(sizeof(unit) * unitSlabSize);
+		slabs_.push_back(slab);
+		free_.reserve(slabs_.size() * unitSlabSize);
+		// Pushed backwards so the slab is handed out front to back
+		for (int i = unitSlabSize - 1; i >= 0; i--) free_.push_back(&slab[i]);
 	}
+	unit* memory = free_.back();
+	free_.pop_back();
+	return memory;
 }
 
-void unit::advance(std::vector<std::vector<tile*>>& tiles)
+unit* unitPool::create(player* team, const std::vector<std::vector<tile*>>& tiles, const int type, const int row, const int column, SDL_Window* window, SDL_Surface* winSurface)
 {
-	if (path_.size() != 0 && unitMoveFlag)
+	return new (slot()) unit(team, tiles, type, row, column, window, winSurface);
+}
+
+unit* unitPool::create(const unit& other)
+{
+	return new (slot()) unit(other);
+}
+
+void unitPool::destroy(unit* unitPtr)
+{
+	unitPtr->~unit();
+	free_.push_back(unitPtr);
+}
+
+void unit::advance(world& w)
+{
+	if (path_.size() == 0) moveCredit_ = 0;
+	// Steps are taken as soon as the credit covers them, which is also how coopnav times its plans
+	bool walking = path_.size() != 0 && unitMoveFlag;
+	while (walking && path_.size() != 0)
 	{
-		if (path_.front()->unitAt_ == NULL)
+		tile* next = path_.back();
+		int cost = next == tileAt_ ? moveTickCredit : next->stepCost(tileAt_);
+		if (moveCredit_ < cost) break;
+		if (next == tileAt_)
+		{
+			// A cooperative plan waiting a tick for someone to pass
+			path_.pop_back();
+			moveCredit_ -= cost;
+		}
+		else if (next->unitAt_ == NULL)
 		{
 			// tileAt_->state_ = 0;
 			// int oldx = tileAt_->x_;
@@ -46,46 +95,78 @@ void unit::advance(std::vector<std::vector<tile*>>& tiles)
 				std::cout << "Magic flag of unit " << this << " at tile " << tileAt_ << " was not 62 before moving." << std::endl;
 				std::system("pause");
 			}
-			tileAt_->unitAt_ = NULL;
-			tileAt_ = path_.front();
-			tileAt_->unitAt_ = this;
-			path_.pop_front();
+			tile* from = tileAt_;
+			if (tileAt_->unitAt_ == this) setTileUnit(w, tileAt_, NULL);
+			tileAt_ = path_.back();
+			setTileUnit(w, tileAt_, this);
+			path_.pop_back();
+			influenceUnitMoved(w, this, from);
+			chunkUnitMoved(w, from, tileAt_);
 			if (tileAt_->magicflag != 62)
 			{
 				std::cout << "Magic flag of unit " << this << " on tile " << tileAt_ << " was not 62 after moving." << std::endl;
 			}
 			// SDL_Delay(75);
-			unitMoveFlag = false;
+			moveCredit_ -= cost;
 			// tileAt_->state_ = 2;
 		}
+		else if (coopStateOf(w, id_) != NULL)
+		{
+			// Whoever is in the way moves this tick too or was not planned around, either way the rest of the plan is off
+			coopStateOf(w, id_)->replan_ = true;
+			moveCredit_ = 0;
+			countMetric(w.metrics_.blocked_);
+			break;
+		}
 		else
 		{
 			path_.clear();
-			std::cout << "Unit " << this << " was blocked at " << tileAt_->x_ << ", " << tileAt_->y_ << std::endl;
+			countMetric(w.metrics_.blocked_);
+			if (w.verbose_) std::cout << "Unit " << this << " was blocked at " << tileAt_->x_ << ", " << tileAt_->y_ << std::endl;
 		}
-
 	}
-	else if (tileAt_->state_ == 2 && resourceMineFlag && team_->resources_ < team_->maxResources_ && type_ == 3)
+	if (walking) unitMoveFlag = false;
+	else if (tileAt_->state_ == 2 && resourceMineFlag && team_->resources_ < team_->maxResources_ && unitArchetypes[type_].mines_)
 	{
 		team_->resources_++;
 		resourceMineFlag = false;
 	}
 }
 
-void unit::navigate(std::vector<std::vector<tile*>>& tiles, std::list<unit*>& units, tile* goal, SDL_Surface* winSurface, SDL_Window* window)
+void unit::navigate(world& w, tile* goal)
 {
-	std::vector<tile*> vectorpath;
-	vectorpath = astar(winSurface, window, tiles, units, tileAt_, goal);
-	path_.clear();
-	for (int i = 0; i < vectorpath.size(); i++)
+	if (w.log_ != NULL) w.log_->navigate(id_, goal);
+	if (team_->team_ >= 0 && team_->team_ < metricsMaxTeams) countMetric(w.metrics_.navigates_[team_->team_]);
+	// Unreachable goals fail immediately instead of after A* exhausts the whole region
+	if (!sameComponent(tileAt_, goal))
 	{
-		path_.push_back(vectorpath[i]);
+		coopForget(w, this);
+		path_.clear();
+		return;
 	}
+	planRoute(w, goal);
 }
 
-void unit::buildFactory(std::list<unit*>& units, std::vector<std::vector<tile*>>& tiles, std::list<tile*>& factories, SDL_Surface* winSurface, SDL_Window* window, int factoryTypeSelector)
+void unit::planRoute(world& w, tile* goal)
 {
-	if (units.size() > 0)
+	if (w.cooperative_)
+	{
+		coopNavigate(w, this, goal);
+		return;
+	}
+	// Holding a reference keeps these tables alive even if a refresh swaps in new ones mid-search
+	std::shared_ptr<const landmarkData> landmarks;
+	if (w.landmarks_ != NULL) landmarks = w.landmarks_->current();
+	astar(w.surface_, w.window_, w.tiles_, tileAt_, goal, path_, landmarks.get(), &w.astarOpen_, w.cheapestWeight_, &w.metrics_);
+	std::reverse(path_.begin(), path_.end());
+}
+
+void unit::buildFactory(world& w, int factoryTypeSelector)
+{
+	if (w.log_ != NULL) w.log_->buildFactory(id_, factoryTypeSelector);
+	std::vector<std::vector<tile*>>& tiles = w.tiles_;
+	std::list<tile*>& factories = w.factories_;
+	if (w.units_.size() > 0)
 	{
 
 		/*std::cout << "There are " << units.size() << " units." << std::endl;
@@ -96,9 +177,6 @@ void unit::buildFactory(std::list<unit*>& units, std::vector<std::vector<tile*>>
 			std::system("pause");
 		}
 		*/
-
-		// Create copy of units to avoid modifying a currently iterated list
-		std::list<unit*> unitsCopy = units;
 		bool aboveClear = true;
 		bool leftClear = true;
 		bool rightClear = true;
@@ -130,61 +208,28 @@ void unit::buildFactory(std::list<unit*>& units, std::vector<std::vector<tile*>>
 
 		if (aboveClear && leftClear && rightClear && belowClear)
 		{
-			// If main unit, this can only be a Builder Factory, also spawn Fighter, Builder, Miner
-			if (this->type_ == 0)
+			const unitArchetype& archetype = unitArchetypes[this->type_];
+			// A founding unit also needs open sides for the units it leaves behind
+			bool roomToFound = aboveNoWall && rightNoWall && belowNoWall;
+			if (archetype.builds_ && (!archetype.founds_ || roomToFound) && this->tileAt_->state_ == 0)
 			{
-				if (aboveNoWall && rightNoWall && belowNoWall)
+				// Set this tile to be a factory tile and add it to the list of factory tiles
+				setTileOwner(w, this->tileAt_, this->team_);
+				setTileState(w, this->tileAt_, 3);
+				this->tileAt_->factoryType = archetype.founds_ ? unitBuilder : factoryTypeSelector;
+				factories.push_back(this->tileAt_);
+				influenceFactoryChanged(w, this->tileAt_, this->team_, true);
+
+				if (archetype.founds_)
 				{
-					if ((this->type_ == 0 || this->type_ == 2) && this->tileAt_->state_ == 0)
-					{
-						// Set this tile to be a factory tile and add it to the list of factory tiles
-						this->tileAt_->claimedBy_ = this->team_;
-						this->tileAt_->state_ = 3;
-						this->tileAt_->factoryType = 2;
-						factories.push_back(this->tileAt_);
-
-						// Create fighter, builder, and miner and add to relevant lists
-						units.push_back(new unit(this->team_, tiles, 1, tileAt_->y_ - 1, tileAt_->x_, window, winSurface));
-						this->team_->units_.push_back(units.back());
-						units.push_back(new unit(this->team_, tiles, 2, tileAt_->y_, tileAt_->x_ + 1, window, winSurface));
-						this->team_->units_.push_back(units.back());
-						units.push_back(new unit(this->team_, tiles, 3, tileAt_->y_ + 1, tileAt_->x_, window, winSurface));
-						this->team_->units_.push_back(units.back());
-
-						// Erase from list of units held by this unit's team
-						std::list<unit*>& teamUnitList = this->team_->units_;
-						teamUnitList.erase(std::find(teamUnitList.begin(), teamUnitList.end(), this));
-
-						// Erase from global list of units
-						units.erase(std::find(units.begin(), units.end(), this));
-
-						this->tileAt_->unitAt_ = NULL; // "corpse" removed from tile
-
-						delete this;
-					}
+					// Create fighter, builder, and miner and add to relevant lists
+					addUnit(w, this->team_, unitFighter, tileAt_->y_ - 1, tileAt_->x_);
+					addUnit(w, this->team_, unitBuilder, tileAt_->y_, tileAt_->x_ + 1);
+					addUnit(w, this->team_, unitMiner, tileAt_->y_ + 1, tileAt_->x_);
 				}
-			}
-			else if (this->type_ == 2)
-			{
-				if ((this->type_ == 0 || this->type_ == 2) && this->tileAt_->state_ == 0)
-				{
-					// Set this tile to be a factory tile and add it to the list of factory tiles
-					this->tileAt_->claimedBy_ = this->team_;
-					this->tileAt_->state_ = 3;
-					this->tileAt_->factoryType = factoryTypeSelector;
-					factories.push_back(this->tileAt_);
-
-					// Erase from list of units held by this unit's team
-					std::list<unit*>& teamUnitList = this->team_->units_;
-					teamUnitList.erase(std::find(teamUnitList.begin(), teamUnitList.end(), this));
-
-					// Erase from global list of units
-					units.erase(std::find(units.begin(), units.end(), this));
 
-					this->tileAt_->unitAt_ = NULL; // "corpse" removed from tile
-
-					delete this;
-				}
+				// Erase from the global and team lists, "corpse" removed from tile
+				removeUnit(w, this);
 			}
 		}
 	}
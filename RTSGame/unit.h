@@ -1,16 +1,22 @@
 #pragma once
 #include "main.h"
 #include "astar.h"
+#include "fog.h"
 struct tile;
 struct player;
+struct world;
 struct unit 
 {
 	unit(player* team, const std::vector<std::vector<tile*>>& tiles, const int type, const int row, const int column, SDL_Window* window, SDL_Surface* winSurface);
-	void advance(std::vector<std::vector<tile*>>& tiles);
-	void navigate(std::vector<std::vector<tile*>>& tiles, std::list<unit*> &units, tile* goal, SDL_Surface* winSurface, SDL_Window* window);
-	void buildFactory(std::list<unit*>& units, std::vector<std::vector<tile*>>& tiles, std::list<tile*>& factories, SDL_Surface* winSurface, SDL_Window* window, int factoryTypeSelector);
+	void advance(world& w);
+	void navigate(world& w, tile* goal);
+	// The route part of navigate, without logging or counting it as an order. goal must be in the unit's component.
+	void planRoute(world& w, tile* goal);
+	void buildFactory(world& w, int factoryTypeSelector);
+	int id_; // assigned by addUnit, unique within a match
 	bool resourceMineFlag; // whether or not resourceMineRate amount of ms has passed since last resource mined
-	bool unitMoveFlag;
+	bool unitMoveFlag; // may walk this frame, cooperative units only walk on move ticks
+	int moveCredit_; // walking budget in tile::stepCost units, each step spends its cost, see moveTickCredit
 	int type_;
 	/* Unit Types
 	0 = Main Unit
@@ -22,6 +28,32 @@ struct unit
 	SDL_Window* window_;
 	SDL_Surface* surface_;
 	tile* tileAt_;
-	std::list<tile*> path_;
+	std::vector<tile*> path_; // steps still to walk, last to first, so the next one is path_.back() and taking it doesn't shift the rest
 	player* team_;
-};
\ No newline at end of file
+	Uint64 fov_[sightSpan]; // tiles this unit sees, one mask per row of its sight square, see fog.h
+	tile* fovAt_; // where fov_ was computed, NULL if never
+};
+
+// Walking budget a unit gets every move tick: one straight step on plain ground. A diagonal step, or one onto slow
+// ground, takes longer than a tick, while a tick on road covers two steps. Units standing still, idle or blocked,
+// keep none of it, so nothing saved up while waiting lets a unit jump ahead afterwards.
+const int moveTickCredit = 10;
+
+const int unitSlabSize = 64;
+
+// Storage for a world's units: slabs of unitSlabSize units, with freed slots reused before a new slab is allocated,
+// so units that spawn and die all match long keep landing in the same few blocks of memory.
+// create and destroy take the place of new and delete.
+struct unitPool
+{
+	unitPool();
+	unitPool(const unitPool&) = delete;
+	unitPool& operator=(const unitPool&) = delete;
+	~unitPool();
+	unit* create(player* team, const std::vector<std::vector<tile*>>& tiles, const int type, const int row, const int column, SDL_Window* window, SDL_Surface* winSurface);
+	unit* create(const unit& other);
+	void destroy(unit* unitPtr);
+	unit* slot(); // uninitialized memory for one unit
+	std::vector<unit*> slabs_;
+	std::vector<unit*> free_; // most recently freed last, so it is the first to be reused while still in cache
+};
@@ -0,0 +1,341 @@
+#include "world.h"
+#include "tile.h"
+#include "unit.h"
+#include "player.h"
+#include "mapfile.h"
+#include "commandlog.h"
+#include "components.h"
+#include "landmarks.h"
+#include <unordered_map>
+#include <climits>
+
+// Component labels and landmarks follow the terrain, a frame's changes at a time
+static void terrainChanged(world& w, const std::vector<tileChange>& changes)
+{
+	bool changed = false;
+	bool opened = false;
+	for (auto& change : changes)
+	{
+		if (change.kind_ != tileStateChanged) continue;
+		bool wasPassable = change.oldState_ != 1 && change.oldState_ != 3;
+		bool passable = change.newState_ != 1 && change.newState_ != 3;
+		if (wasPassable == passable) continue;
+		onTileChanged(w, change.tile_);
+		changed = true;
+		if (passable) opened = true;
+	}
+	if (changed && w.landmarks_ != NULL) w.landmarks_->terrainChanged(w.tiles_, opened);
+}
+
+world::world()
+{
+	currentunit_ = NULL;
+	nextUnitId_ = 0;
+	surface_ = NULL;
+	window_ = NULL;
+	verbose_ = true;
+	log_ = NULL;
+	replay_ = NULL;
+	landmarks_ = NULL;
+	cheapestWeight_ = terrainWeight[0];
+	cooperative_ = true;
+	moveTick_ = 0;
+	countsToTotals_ = true;
+	pool_ = NULL;
+	poolWorker_ = -1;
+	subscribeTileChanges(*this, tileStateChanged, terrainChanged);
+	subscribeTileChanges(*this, tileStateChanged, chunkTilesChanged);
+}
+
+// Units only ever stand on ground they can walk on, which also keeps them off the shared tile of an all-wall chunk
+static bool canHoldUnit(const world& w, int row, int column)
+{
+	if (row < 0 || column < 0 || row >= (int)w.tiles_.size() || column >= (int)w.tiles_[0].size()) return false;
+	return w.tiles_[row][column]->walkable();
+}
+
+unit* addUnit(world& w, player* team, int type, int row, int column)
+{
+	if (!canHoldUnit(w, row, column)) return NULL;
+	unit* unitPtr = w.unitPool_.create(team, w.tiles_, type, row, column, w.window_, w.surface_);
+	unitPtr->id_ = w.nextUnitId_++;
+	w.units_.push_back(unitPtr);
+	team->unitJoined(unitPtr);
+	// A tile holds one unit. Only a factory built next to units can put a new one on an occupied tile, that one stays
+	// unregistered until it first moves, as everything else only ever places units on free tiles.
+	if (unitPtr->tileAt_->unitAt_ == NULL) setTileUnit(w, unitPtr->tileAt_, unitPtr);
+	influenceUnitAdded(w, unitPtr);
+	chunkUnitMoved(w, NULL, unitPtr->tileAt_);
+	return unitPtr;
+}
+
+void removeUnit(world& w, unit* unitPtr)
+{
+	if (unitPtr == w.currentunit_) w.currentunit_ = NULL;
+	influenceUnitRemoved(w, unitPtr);
+	chunkUnitMoved(w, unitPtr->tileAt_, NULL);
+	coopForget(w, unitPtr);
+	unitPtr->team_->fog_.dirty_ = true;
+	// check if unit is in its team's unit list
+	if (!unitPtr->team_->unitLeft(unitPtr)) std::cout << "Removed unit not found in team's units list. Pointer is " << unitPtr << std::endl;
+	w.units_.erase(std::find(w.units_.begin(), w.units_.end(), unitPtr));
+	if (unitPtr->tileAt_->unitAt_ == unitPtr) setTileUnit(w, unitPtr->tileAt_, NULL); // "corpse" removed from tile
+	w.unitPool_.destroy(unitPtr);
+}
+
+player* addPlayer(world& w, bool human, int row, int column)
+{
+	if (!canHoldUnit(w, row, column)) return NULL;
+	if (w.log_ != NULL) w.log_->createPlayer(human, row, column);
+	w.players_.push_back(new player(w.players_.size(), *w.surface_, human));
+	addUnit(w, w.players_.back(), 0, row, column);
+	return w.players_.back();
+}
+
+bool loadWorldMap(world& w, const std::string& path)
+{
+	clearWorld(w);
+	mapMetadata metadata;
+	if (!loadMap(path, w.tiles_, &metadata)) return false;
+	terrainLoaded(w, &metadata);
+	return true;
+}
+
+// The state counts of a binary map, if they account for every tile
+static bool countsMatch(const world& w, const mapMetadata* metadata)
+{
+	if (metadata == NULL || metadata->stateCounts.size() == 0 || metadata->stateCounts.size() > (size_t)tileStateCount) return false;
+	size_t total = 0;
+	for (auto count : metadata->stateCounts) total += count;
+	return total == w.tiles_.size() * w.tiles_[0].size();
+}
+
+// The resource list of a binary map, if every entry is a resource tile and there are as many as the counts say
+static bool resourcesMatch(const world& w, const mapMetadata* metadata)
+{
+	if (!countsMatch(w, metadata) || metadata->stateCounts.size() <= 2 || metadata->resourceTiles.size() != metadata->stateCounts[2]) return false;
+	size_t width = w.tiles_[0].size();
+	for (auto index : metadata->resourceTiles)
+	{
+		if (index >= w.tiles_.size() * width || w.tiles_[index / width][index % width]->state_ != 2) return false;
+	}
+	return true;
+}
+
+void terrainLoaded(world& w, const mapMetadata* metadata)
+{
+	dropTileChanges(w);
+	// Roads and slow ground never change during a match, only open ground and factories do
+	w.cheapestWeight_ = terrainWeight[0];
+	if (countsMatch(w, metadata))
+	{
+		for (int state = 0; state < (int)metadata->stateCounts.size(); state++)
+		{
+			if (metadata->stateCounts[state] > 0) w.cheapestWeight_ = std::min(w.cheapestWeight_, terrainWeight[state]);
+		}
+	}
+	else
+	{
+		for (auto& row : w.tiles_)
+		{
+			for (auto tilePtr : row) w.cheapestWeight_ = std::min(w.cheapestWeight_, terrainWeight[tilePtr->state_]);
+		}
+	}
+	labelComponents(w);
+	rebuildInfluence(w, resourcesMatch(w, metadata) ? &metadata->resourceTiles : NULL);
+	rebuildChunks(w);
+	if (w.landmarks_ != NULL) w.landmarks_->build(w.tiles_);
+}
+
+void clearWorld(world& w)
+{
+	flushMetrics(w);
+	for (auto unitPtr : w.units_) w.unitPool_.destroy(unitPtr);
+	w.units_.clear();
+	for (auto playerPtr : w.players_) delete playerPtr;
+	w.players_.clear();
+	w.factories_.clear();
+	w.currentunit_ = NULL;
+	w.nextUnitId_ = 0;
+	coopReset(w);
+	dropTileChanges(w);
+	freeTiles(w.tiles_);
+}
+
+void cloneWorld(const world& src, world& dst)
+{
+	for (auto unitPtr : dst.units_) dst.unitPool_.destroy(unitPtr);
+	dst.units_.clear();
+	for (auto playerPtr : dst.players_) delete playerPtr;
+	dst.players_.clear();
+	dst.factories_.clear();
+	int height = src.tiles_.size();
+	int width = height > 0 ? src.tiles_[0].size() : 0;
+	// Walls never change, so tiles left from a clone of the same match already have the same implicit chunks
+	bool sameLayout = dst.tiles_.size() == (size_t)height && (height == 0 || dst.tiles_[0].size() == (size_t)width);
+	for (int r = 0; r < height && sameLayout; r += chunkSize)
+	{
+		for (int c = 0; c < width && sameLayout; c += chunkSize)
+		{
+			if (isImplicitWall(src.tiles_[r][c]) != isImplicitWall(dst.tiles_[r][c])) sameLayout = false;
+		}
+	}
+	if (!sameLayout)
+	{
+		freeTiles(dst.tiles_);
+		std::vector<Uint8> states(width * height, 0);
+		for (int r = 0; r < height; r++)
+		{
+			for (int c = 0; c < width; c++) states[r * width + c] = src.tiles_[r][c]->state_;
+		}
+		allocateTiles(dst.tiles_, states.data(), width, height);
+	}
+	dst.surface_ = src.surface_;
+	dst.window_ = src.window_;
+	dst.currentunit_ = NULL;
+	dst.nextUnitId_ = src.nextUnitId_;
+	dst.log_ = NULL;
+	dst.replay_ = NULL;
+	dst.landmarks_ = NULL;
+	dst.componentSizes_ = src.componentSizes_;
+	dst.influence_ = src.influence_;
+	dst.chunks_ = src.chunks_;
+	dst.cheapestWeight_ = src.cheapestWeight_;
+	dst.cooperative_ = src.cooperative_;
+	dst.moveTick_ = src.moveTick_;
+	dst.countsToTotals_ = false;
+	dst.pool_ = NULL;
+	dst.poolWorker_ = -1;
+	coopCopy(src.coop_, dst.coop_);
+
+	// Players and units keep their order, so pointers map across by position
+	std::unordered_map<const player*, player*> players;
+	for (auto playerPtr : src.players_)
+	{
+		player* copy = new player(*playerPtr);
+		copy->units_.clear();
+		copy->searchWorld_ = NULL;
+		for (auto& bucket : copy->ofType_) bucket.clear();
+		players[playerPtr] = copy;
+		dst.players_.push_back(copy);
+	}
+	std::unordered_map<const unit*, unit*> units;
+	units.reserve(src.units_.size());
+	for (auto unitPtr : src.units_)
+	{
+		unit* copy = dst.unitPool_.create(*unitPtr);
+		copy->team_ = players[unitPtr->team_];
+		copy->tileAt_ = dst.tiles_[unitPtr->tileAt_->y_][unitPtr->tileAt_->x_];
+		if (copy->fovAt_ != NULL) copy->fovAt_ = dst.tiles_[unitPtr->fovAt_->y_][unitPtr->fovAt_->x_];
+		for (auto& step : copy->path_) step = dst.tiles_[step->y_][step->x_];
+		copy->path_.reserve(reservationWindow + 1);
+		units[unitPtr] = copy;
+		dst.units_.push_back(copy);
+	}
+	for (auto playerPtr : src.players_)
+	{
+		player* copy = players[playerPtr];
+		for (auto unitPtr : playerPtr->units_) copy->unitJoined(units[unitPtr]);
+	}
+	for (int r = 0; r < height; r++)
+	{
+		for (int c = 0; c < width; c++)
+		{
+			const tile* from = src.tiles_[r][c];
+			if (isImplicitWall(from)) continue;
+			tile* to = dst.tiles_[r][c];
+			to->state_ = from->state_;
+			to->factoryType = from->factoryType;
+			to->component_ = from->component_;
+			to->claimedBy_ = from->claimedBy_ == NULL ? NULL : players[from->claimedBy_];
+			to->unitAt_ = from->unitAt_ == NULL ? NULL : units[from->unitAt_];
+		}
+	}
+	for (auto factoryPtr : src.factories_) dst.factories_.push_back(dst.tiles_[factoryPtr->y_][factoryPtr->x_]);
+	copyTileChanges(src, dst);
+}
+
+// A commander only ever builds where it stands
+static bool canStartAt(const std::vector<std::vector<tile*>>& tiles, int r, int c)
+{
+	if (r < 1 || c < 1 || r >= (int)tiles.size() - 1 || c >= (int)tiles[0].size() - 1) return false;
+	return tiles[r][c]->state_ == 0 && tiles[r - 1][c]->state_ == 0 && tiles[r + 1][c]->state_ == 0 && tiles[r][c - 1]->state_ == 0 && tiles[r][c + 1]->state_ == 0;
+}
+
+bool pickStartTiles(world& w, int count, std::vector<tile*>& starts)
+{
+	starts.clear();
+	if (w.componentSizes_.size() == 0) return false;
+	int region = std::max_element(w.componentSizes_.begin(), w.componentSizes_.end()) - w.componentSizes_.begin();
+	std::vector<tile*> candidates;
+	for (int r = 0; r < (int)w.tiles_.size(); r++)
+	{
+		for (int c = 0; c < (int)w.tiles_[0].size(); c++)
+		{
+			if (w.tiles_[r][c]->component_ == region && w.tiles_[r][c]->unitAt_ == NULL && canStartAt(w.tiles_, r, c)) candidates.push_back(w.tiles_[r][c]);
+		}
+	}
+	if ((int)candidates.size() < count) return false;
+	std::uniform_int_distribution<> distrib(0, candidates.size() - 1);
+	starts.push_back(candidates[distrib(w.rng_)]);
+	while ((int)starts.size() < count)
+	{
+		// Keep the sample farthest from its nearest start
+		tile* best = NULL;
+		int bestDistance = -1;
+		for (int i = 0; i < 8; i++)
+		{
+			tile* candidate = candidates[distrib(w.rng_)];
+			int nearest = INT_MAX;
+			for (auto start : starts) nearest = std::min(nearest, candidate->distTo(start));
+			if (nearest > bestDistance)
+			{
+				best = candidate;
+				bestDistance = nearest;
+			}
+		}
+		if (bestDistance <= 0) return false;
+		starts.push_back(best);
+	}
+	return true;
+}
+
+// FNV-1a
+static void hashValue(Uint64& hash, Sint64 value)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		hash ^= (value >> (i * 8)) & 0xFF;
+		hash *= 1099511628211ull;
+	}
+}
+
+Uint64 worldChecksum(const world& w)
+{
+	Uint64 hash = 14695981039346656037ull;
+	for (auto& row : w.tiles_)
+	{
+		for (auto tilePtr : row)
+		{
+			hashValue(hash, tilePtr->state_);
+			hashValue(hash, tilePtr->factoryType);
+			hashValue(hash, tilePtr->claimedBy_ == NULL ? -1 : tilePtr->claimedBy_->team_);
+		}
+	}
+	for (auto unitPtr : w.units_)
+	{
+		hashValue(hash, unitPtr->id_);
+		hashValue(hash, unitPtr->type_);
+		hashValue(hash, unitPtr->health_);
+		hashValue(hash, unitPtr->tileAt_->x_);
+		hashValue(hash, unitPtr->tileAt_->y_);
+		hashValue(hash, unitPtr->team_->team_);
+		hashValue(hash, unitPtr->moveCredit_);
+	}
+	for (auto playerPtr : w.players_)
+	{
+		hashValue(hash, playerPtr->team_);
+		hashValue(hash, playerPtr->resources_);
+	}
+	return hash;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "main.h"
+#include <random>
+#include "influence.h"
+#include "coopnav.h"
+#include "astar.h"
+#include "player.h"
+#include "minerassign.h"
+#include "unit.h"
+#include "simulation.h"
+#include "tileevents.h"
+#include "chunks.h"
+#include "metrics.h"
+struct tile;
+struct unit;
+struct player;
+struct commandLog;
+struct commandReplay;
+struct landmarkTable;
+struct workStealingPool;
+struct mapMetadata;
+
+// Everything that makes up a match, owned here instead of as separate locals in main()
+struct world
+{
+	world();
+	std::vector<std::vector<tile*>> tiles_;
+	std::list<unit*> units_;
+	unitPool unitPool_; // memory of every unit in units_, see addUnit and removeUnit
+	std::list<tile*> factories_; // list of factories, so that not every tile has to be searched for spawning loop
+	std::vector<player*> players_;
+	unit* currentunit_; // unit selected by the human player, NULL if none
+	int nextUnitId_; // ids are never reused, so commands can name units across a whole match
+	std::mt19937 rng_; // all AI randomness, so a seeded match plays out the same every time
+	SDL_Surface* surface_;
+	SDL_Window* window_;
+	bool verbose_; // routine per-unit messages, off for batch runs where they would drown the output
+	commandLog* log_; // records every issued command when not NULL
+	commandReplay* replay_; // when not NULL, AI orders come from a recorded log instead of player::act
+	std::vector<int> componentSizes_; // number of tiles carrying each component label
+	std::vector<tile*> componentStack_; // scratch for relabeling
+	influenceMaps influence_;
+	landmarkTable* landmarks_; // ALT heuristic tables for astar, NULL to search with the plain octile distance
+	int cheapestWeight_; // lowest terrainWeight on the map, what the octile distance is scaled by to stay a lower bound
+	bool cooperative_; // units plan around each other's reservations instead of taking a plain A* path
+	int moveTick_; // move ticks completed so far, the clock of the reservation table
+	coopPlanner coop_; // reservations and plans of units moving cooperatively
+	tileEvents tileEvents_; // tile changes of the current frame, published by stepWorld
+	chunkGrid chunks_;
+	metricsCounters metrics_;
+	metricsCounters metricsCounted_; // what metrics_ held when it was last added to the totals
+	bool countsToTotals_; // false for copies made by cloneWorld, whose counts stay out of the process-wide totals
+	workStealingPool* pool_; // helps resolve combat when not NULL, owned by whoever runs the match
+	int poolWorker_; // the pool worker stepping this world, -1 when it is stepped from outside the pool
+	// Scratch buffers, refilled every tick so a running match doesn't allocate. Never copied by cloneWorld.
+	astarQueue astarOpen_;
+	actScratch actScratch_;
+	minerScratch minerScratch_;
+	std::vector<unit*> deadUnits_;
+	std::vector<player*> deadPlayers_;
+	combatScratch combat_;
+};
+
+// Creation and removal of units go through here so the global list, the team list and the tile stay in sync.
+// A unit is only placed on walkable ground inside the map, NULL otherwise.
+unit* addUnit(world& w, player* team, int type, int row, int column);
+void removeUnit(world& w, unit* unitPtr);
+// New player with a main unit at row, column, as done by right clicking. NULL, and no player, where addUnit would refuse.
+player* addPlayer(world& w, bool human, int row, int column);
+
+// Loads a text or binary map into an empty world and computes everything derived from the terrain
+bool loadWorldMap(world& w, const std::string& path);
+// Recomputes everything derived from the terrain (components, landmarks, influence, chunks) after a whole map is loaded.
+// Factories built or destroyed later reach the component labels and landmarks as tile change events. The state counts
+// and resource list of a binary map, when given and consistent with the tiles, stand in for scanning the map for them.
+void terrainLoaded(world& w, const mapMetadata* metadata = NULL);
+// Deletes every unit, player and tile
+void clearWorld(world& w);
+// Makes dst an independent copy of the simulated state of src, reusing dst's tiles when the map size matches.
+// The copy never records, replays, uses landmarks or a pool, and has nothing selected.
+void cloneWorld(const world& src, world& dst);
+// Picks count start tiles in the largest region, where a commander has open ground on all four sides to build on,
+// each one as far from the previous ones as a few samples allow. Returns false if the map has no room for them.
+bool pickStartTiles(world& w, int count, std::vector<tile*>& starts);
+// Hash of the simulated state (tiles, units, players), for checking that a replay or rerun matches
+Uint64 worldChecksum(const world& w);